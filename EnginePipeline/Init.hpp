@@ -33,13 +33,18 @@ namespace initializers
 		return VK_FALSE;
 	}
 
-	inline std::vector<const char*> GetRequiredExtensions()
+	// headless skips glfw entirely, it is never initialized without a window
+	inline std::vector<const char*> GetRequiredExtensions(bool headless = false)
 	{
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		std::vector<const char*> extensions;
+		if (!headless)
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		if (ENABLE_VALIDATION_LAYERS)
 		{
@@ -247,6 +252,30 @@ namespace initializers
 		return vulkanInfoStore.bufferMemoryBarrier;
 	}
 
+	/** @brief Initialize an image memory barrier that transfers ownership, recorded as release on src and acquire on dst */
+	inline VkImageMemoryBarrier CreateImageMemoryBarrier(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex)
+	{
+		VkImageMemoryBarrier imageMemoryBarrier = CreateImageMemoryBarrier();
+		if (srcQueueFamilyIndex != dstQueueFamilyIndex)
+		{
+			imageMemoryBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+			imageMemoryBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+		}
+		return imageMemoryBarrier;
+	}
+
+	/** @brief Initialize a buffer memory barrier that transfers ownership, recorded as release on src and acquire on dst */
+	inline VkBufferMemoryBarrier CreateBufferMemoryBarrier(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex)
+	{
+		VkBufferMemoryBarrier bufferMemoryBarrier = CreateBufferMemoryBarrier();
+		if (srcQueueFamilyIndex != dstQueueFamilyIndex)
+		{
+			bufferMemoryBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+			bufferMemoryBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+		}
+		return bufferMemoryBarrier;
+	}
+
 	inline VkMemoryBarrier CreateMemoryBarrier()
 	{
 		vulkanInfoStore.memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
@@ -777,17 +806,17 @@ namespace initializers
 		vulkanInfoStore.appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		vulkanInfoStore.appInfo.pEngineName = "No Engine";
 		vulkanInfoStore.appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		vulkanInfoStore.appInfo.apiVersion = VK_API_VERSION_1_0;
+		vulkanInfoStore.appInfo.apiVersion = VK_API_VERSION_1_1;
 		return vulkanInfoStore.appInfo;
 	}
 
 	// TODO hacking instance fix
-	inline void CreateInstance(VkInstance* instance)
+	inline void CreateInstance(VkInstance* instance, bool headless = false)
 	{
 		vulkanInfoStore.createInstanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 		vulkanInfoStore.createInstanceInfo.pApplicationInfo = &vulkanInfoStore.appInfo;
 
-		vulkanInfoStore.extensions = GetRequiredExtensions();
+		vulkanInfoStore.extensions = GetRequiredExtensions(headless);
 		vulkanInfoStore.createInstanceInfo.enabledExtensionCount = static_cast<uint32_t>(vulkanInfoStore.extensions.
 			size());
 		vulkanInfoStore.createInstanceInfo.ppEnabledExtensionNames = vulkanInfoStore.extensions.data();
@@ -18,9 +18,19 @@ namespace VulkanTest
 	{
 		glfwInit();
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 		window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
+		glfwSetWindowUserPointer(window, this);
+		glfwSetFramebufferSizeCallback(window, FramebufferResizeCallback);
+	}
+
+	void MainWindow::FramebufferResizeCallback(GLFWwindow* glfwWindow, const int newWidth, const int newHeight)
+	{
+		auto* mainWindow = static_cast<MainWindow*>(glfwGetWindowUserPointer(glfwWindow));
+		mainWindow->framebufferResized = true;
+		mainWindow->width = newWidth;
+		mainWindow->height = newHeight;
 	}
 
 	void MainWindow::CreateWindowSurface(VkInstance instance, VkSurfaceKHR* surface) const
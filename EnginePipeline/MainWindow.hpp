@@ -23,13 +23,22 @@ namespace VulkanTest
 			return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
 		}
 
+		// set by the framebuffer size callback, the swap chain is recreated on the next frame
+		[[nodiscard]] bool WasWindowResized() const { return framebufferResized; }
+		void ResetWindowResizedFlag() { framebufferResized = false; }
+
 		void CreateWindowSurface(VkInstance instance, VkSurfaceKHR* surface) const;
 		void InitWindow();
 
-		const int width;
-		const int height;
+		// framebuffer size in pixels, 0 x 0 while minimized
+		int width;
+		int height;
+		bool framebufferResized = false;
 
 		std::string windowName;
 		GLFWwindow* window{};
+
+	private:
+		static void FramebufferResizeCallback(GLFWwindow* glfwWindow, int newWidth, int newHeight);
 	};
 }
@@ -0,0 +1,181 @@
+#include "app_command_cache.hpp"
+
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	AppCommandCache::AppCommandCache(AppDevice& device, AppJobPool& jobPool, const uint32_t framesInFlight,
+	                                 CommandEncoderStats* encoderStats)
+		: _device{device}, _jobPool{jobPool}, _framesInFlight{framesInFlight}, _encoderStats{encoderStats}
+	{
+	}
+
+	AppCommandCache::~AppCommandCache()
+	{
+		for (const auto& bucket : _buckets)
+			vkDestroyCommandPool(_device.Device(), bucket->pool, nullptr);
+	}
+
+	AppCommandCache::BucketId AppCommandCache::AddBucket(std::string name, const uint32_t drawCount,
+	                                                      RecordFunction record)
+	{
+		auto bucket = std::make_unique<Bucket>();
+		bucket->name = std::move(name);
+		bucket->drawCount = drawCount;
+		bucket->record = std::move(record);
+
+		// buffers are reset one at a time as they go stale, the pool is never reset as a whole
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = _device.QueueFamilies().graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		if (vkCreateCommandPool(_device.Device(), &poolInfo, nullptr, &bucket->pool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create bucket command pool!");
+
+		std::vector<VkCommandBuffer> commandBuffers(_framesInFlight);
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandPool = bucket->pool;
+		allocInfo.commandBufferCount = _framesInFlight;
+		if (vkAllocateCommandBuffers(_device.Device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+		{
+			vkDestroyCommandPool(_device.Device(), bucket->pool, nullptr);
+			throw std::runtime_error("failed to allocate bucket command buffers!");
+		}
+
+		bucket->copies.resize(_framesInFlight);
+		for (uint32_t i = 0; i < _framesInFlight; i++)
+			bucket->copies[i].commandBuffer = commandBuffers[i];
+
+		_buckets.push_back(std::move(bucket));
+		return static_cast<BucketId>(_buckets.size() - 1);
+	}
+
+	void AppCommandCache::SetContents(const BucketId bucket, const uint32_t drawCount, RecordFunction record)
+	{
+		Bucket& target = *_buckets.at(bucket);
+		target.drawCount = drawCount;
+		target.record = std::move(record);
+		target.generation++;
+		_dirtyContents++;
+	}
+
+	void AppCommandCache::SetPipeline(const BucketId bucket, std::shared_ptr<AppPipeline> pipeline)
+	{
+		Bucket& target = *_buckets.at(bucket);
+		if (target.pipeline == pipeline)
+			return;
+
+		target.pipeline = std::move(pipeline);
+		target.generation++;
+		_dirtyPipeline++;
+	}
+
+	void AppCommandCache::SetTarget(const VkRenderPass renderPass, const uint32_t subpass, const VkExtent2D extent)
+	{
+		if (renderPass == _renderPass && subpass == _subpass &&
+			extent.width == _extent.width && extent.height == _extent.height)
+			return;
+
+		_renderPass = renderPass;
+		_subpass = subpass;
+		_extent = extent;
+		for (const auto& bucket : _buckets)
+			bucket->generation++;
+		_dirtyTarget++;
+	}
+
+	void AppCommandCache::Execute(const VkCommandBuffer primary, const uint32_t frame)
+	{
+		if (_renderPass == VK_NULL_HANDLE)
+			throw std::runtime_error("command cache executed without a target!");
+
+		std::vector<Bucket*> stale;
+		std::vector<VkCommandBuffer> commandBuffers;
+		commandBuffers.reserve(_buckets.size());
+		for (const auto& bucket : _buckets)
+		{
+			// pipeline still compiling, nothing to draw with
+			if (!bucket->pipeline)
+				continue;
+
+			FrameCopy& copy = bucket->copies.at(frame);
+			if (copy.generation != bucket->generation)
+				stale.push_back(bucket.get());
+			else
+			{
+				bucket->reuses++;
+				_reusedDraws += bucket->drawCount;
+			}
+			commandBuffers.push_back(copy.commandBuffer);
+		}
+
+		// a bucket is only ever touched by the range that owns it, so its pool needs no lock
+		_jobPool.ParallelFor(stale.size(), 1, [&](const size_t first, const size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				RecordCopy(*stale[i], stale[i]->copies[frame]);
+		});
+
+		for (const Bucket* bucket : stale)
+			_recordedDraws += bucket->drawCount;
+
+		if (!commandBuffers.empty())
+			vkCmdExecuteCommands(primary, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+		_frames++;
+	}
+
+	void AppCommandCache::RecordCopy(Bucket& bucket, FrameCopy& copy) const
+	{
+		// no framebuffer, it changes with every swap chain image while the render pass stays compatible
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = _renderPass;
+		inheritanceInfo.subpass = _subpass;
+
+		// implicitly resets the buffer, the pool was created with RESET_COMMAND_BUFFER
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		if (vkBeginCommandBuffer(copy.commandBuffer, &beginInfo) != VK_SUCCESS)
+			throw std::runtime_error("failed to begin recording bucket " + bucket.name + "!");
+
+		VkViewport viewport{};
+		viewport.width = static_cast<float>(_extent.width);
+		viewport.height = static_cast<float>(_extent.height);
+		viewport.maxDepth = 1.0f;
+		const VkRect2D scissor{{0, 0}, _extent};
+		{
+			AppCommandEncoder encoder(copy.commandBuffer, _encoderStats);
+			encoder.SetViewport(viewport);
+			encoder.SetScissor(scissor);
+			encoder.BindPipeline(*bucket.pipeline);
+			bucket.record(encoder, *bucket.pipeline);
+		}
+
+		if (vkEndCommandBuffer(copy.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to record bucket " + bucket.name + "!");
+
+		copy.generation = bucket.generation;
+		copy.pipeline = bucket.pipeline;
+		bucket.records++;
+	}
+
+	void AppCommandCache::PrintStats(std::ostream& out) const
+	{
+		const uint64_t totalDraws = _recordedDraws + _reusedDraws;
+		out << "command_cache buckets=" << _buckets.size() << " frames=" << _frames
+			<< " draws_recorded=" << _recordedDraws << " draws_reused=" << _reusedDraws
+			<< " avoided_pct=" << (totalDraws > 0 ? 100.0 * _reusedDraws / totalDraws : 0.0)
+			<< " dirty_contents=" << _dirtyContents << " dirty_pipeline=" << _dirtyPipeline
+			<< " dirty_target=" << _dirtyTarget << std::endl;
+
+		for (const auto& bucket : _buckets)
+		{
+			out << "command_cache_bucket name=" << bucket->name << " draws=" << bucket->drawCount
+				<< " records=" << bucket->records << " reuses=" << bucket->reuses << std::endl;
+		}
+	}
+}
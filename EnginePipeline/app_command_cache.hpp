@@ -0,0 +1,96 @@
+#pragma once
+
+#include "app_command_encoder.hpp"
+#include "app_device.hpp"
+#include "app_job_pool.hpp"
+#include "app_pipline.hpp"
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Secondary command buffers for geometry that does not change between frames. Draws are grouped into
+	// buckets, each recorded once and executed again every frame until its contents, its pipeline or the
+	// render target change. Every frame in flight has its own copy of a bucket, so a stale copy is only
+	// re-recorded once its frame slot's fence was waited on and nothing still executes it.
+	class AppCommandCache
+	{
+	public:
+		// records the bucket's draws with its pipeline already bound and viewport and scissor set
+		using RecordFunction = std::function<void(AppCommandEncoder& encoder, const AppPipeline& pipeline)>;
+		using BucketId = uint32_t;
+
+		AppCommandCache(AppDevice& device, AppJobPool& jobPool, uint32_t framesInFlight,
+		                CommandEncoderStats* encoderStats = nullptr);
+		~AppCommandCache();
+
+		AppCommandCache(const AppCommandCache&) = delete;
+		AppCommandCache& operator=(const AppCommandCache&) = delete;
+
+		// drawCount only feeds the stats
+		BucketId AddBucket(std::string name, uint32_t drawCount, RecordFunction record);
+		// contents changed, the bucket is recorded again with the new function
+		void SetContents(BucketId bucket, uint32_t drawCount, RecordFunction record);
+		// re-records the bucket only if this is a different pipeline, null leaves the bucket out until set
+		void SetPipeline(BucketId bucket, std::shared_ptr<AppPipeline> pipeline);
+		// render pass or size changed, e.g. after the swap chain was recreated. re-records every bucket
+		void SetTarget(VkRenderPass renderPass, uint32_t subpass, VkExtent2D extent);
+
+		// between vkCmdBeginRenderPass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS and the matching
+		// end, the slot's fence must have been waited on. stale copies of this slot are recorded on the job pool
+		void Execute(VkCommandBuffer primary, uint32_t frame);
+
+		[[nodiscard]] size_t BucketCount() const { return _buckets.size(); }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		// one recorded copy per frame in flight
+		struct FrameCopy
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			// bucket generation it was recorded at, 0 never recorded
+			uint64_t generation = 0;
+			// what the copy binds, kept alive while it may still execute
+			std::shared_ptr<AppPipeline> pipeline;
+		};
+
+		struct Bucket
+		{
+			std::string name;
+			uint32_t drawCount = 0;
+			RecordFunction record;
+			std::shared_ptr<AppPipeline> pipeline;
+			// bumped on every change, a copy behind it is stale
+			uint64_t generation = 1;
+			// each bucket has its own pool so stale buckets can be recorded on different threads
+			VkCommandPool pool = VK_NULL_HANDLE;
+			std::vector<FrameCopy> copies;
+
+			uint64_t records = 0;
+			uint64_t reuses = 0;
+		};
+
+		void RecordCopy(Bucket& bucket, FrameCopy& copy) const;
+
+		AppDevice& _device;
+		AppJobPool& _jobPool;
+		const uint32_t _framesInFlight;
+		CommandEncoderStats* _encoderStats;
+		std::vector<std::unique_ptr<Bucket>> _buckets;
+
+		VkRenderPass _renderPass = VK_NULL_HANDLE;
+		uint32_t _subpass = 0;
+		VkExtent2D _extent{};
+
+		uint64_t _frames = 0;
+		uint64_t _recordedDraws = 0;
+		uint64_t _reusedDraws = 0;
+		uint64_t _dirtyContents = 0;
+		uint64_t _dirtyPipeline = 0;
+		uint64_t _dirtyTarget = 0;
+	};
+}
@@ -0,0 +1,240 @@
+#include "app_command_encoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		constexpr const char* COMMAND_NAMES[] = {
+			"bind_pipeline", "bind_descriptor_sets", "bind_vertex_buffers", "bind_index_buffer",
+			"set_viewport", "set_scissor", "push_constants"
+		};
+		static_assert(std::size(COMMAND_NAMES) == static_cast<size_t>(EncoderCommand::Count));
+	}
+
+	void CommandEncoderStats::Add(const EncoderCommand command, const uint64_t emitted, const uint64_t filtered)
+	{
+		_emitted[static_cast<size_t>(command)] += emitted;
+		_filtered[static_cast<size_t>(command)] += filtered;
+	}
+
+	void CommandEncoderStats::PrintStats(std::ostream& out) const
+	{
+		const uint64_t frames = std::max<uint64_t>(_frames, 1);
+		uint64_t emitted = 0;
+		uint64_t filtered = 0;
+		for (size_t i = 0; i < COMMAND_COUNT; i++)
+		{
+			emitted += _emitted[i];
+			filtered += _filtered[i];
+		}
+
+		out << "command_encoder frames=" << _frames
+			<< " emitted_per_frame=" << static_cast<double>(emitted) / frames
+			<< " filtered_per_frame=" << static_cast<double>(filtered) / frames << std::endl;
+
+		for (size_t i = 0; i < COMMAND_COUNT; i++)
+		{
+			out << "command_encoder_command name=" << COMMAND_NAMES[i]
+				<< " emitted_per_frame=" << static_cast<double>(_emitted[i]) / frames
+				<< " filtered_per_frame=" << static_cast<double>(_filtered[i]) / frames << std::endl;
+		}
+	}
+
+	AppCommandEncoder::AppCommandEncoder(const VkCommandBuffer commandBuffer, CommandEncoderStats* stats)
+		: _commandBuffer{commandBuffer}, _stats{stats}
+	{
+	}
+
+	AppCommandEncoder::~AppCommandEncoder()
+	{
+		if (_stats == nullptr)
+			return;
+
+		for (size_t i = 0; i < _emitted.size(); i++)
+			_stats->Add(static_cast<EncoderCommand>(i), _emitted[i], _filtered[i]);
+	}
+
+	void AppCommandEncoder::BindPipeline(const VkPipelineBindPoint bindPoint, const VkPipeline pipeline)
+	{
+		BindPointState& state = State(bindPoint);
+		const bool emit = state.pipeline != pipeline;
+		if (emit)
+		{
+			vkCmdBindPipeline(_commandBuffer, bindPoint, pipeline);
+			state.pipeline = pipeline;
+		}
+		Count(EncoderCommand::BindPipeline, emit);
+	}
+
+	void AppCommandEncoder::BindDescriptorSets(const VkPipelineBindPoint bindPoint, const VkPipelineLayout layout,
+	                                           const uint32_t firstSet, const uint32_t setCount,
+	                                           const VkDescriptorSet* sets, const uint32_t dynamicOffsetCount,
+	                                           const uint32_t* dynamicOffsets)
+	{
+		if (firstSet + setCount > MAX_DESCRIPTOR_SETS)
+			throw std::runtime_error("descriptor set index out of range!");
+
+		BindPointState& state = State(bindPoint);
+		bool emit = dynamicOffsetCount > 0;
+		for (uint32_t i = 0; i < setCount && !emit; i++)
+			emit = state.sets[firstSet + i] != sets[i] || state.setLayouts[firstSet + i] != layout;
+
+		if (emit)
+		{
+			vkCmdBindDescriptorSets(_commandBuffer, bindPoint, layout, firstSet, setCount, sets,
+			                        dynamicOffsetCount, dynamicOffsets);
+
+			// sets bound under a different layout may be disturbed, they are no longer known to be bound
+			for (uint32_t set = 0; set < MAX_DESCRIPTOR_SETS; set++)
+			{
+				if (state.setLayouts[set] != layout)
+				{
+					state.sets[set] = VK_NULL_HANDLE;
+					state.setLayouts[set] = VK_NULL_HANDLE;
+				}
+			}
+			for (uint32_t i = 0; i < setCount; i++)
+			{
+				// with dynamic offsets the set is never filtered, shadowing it would only mislead
+				state.sets[firstSet + i] = dynamicOffsetCount > 0 ? VK_NULL_HANDLE : sets[i];
+				state.setLayouts[firstSet + i] = layout;
+			}
+		}
+		Count(EncoderCommand::BindDescriptorSets, emit);
+	}
+
+	void AppCommandEncoder::BindVertexBuffers(const uint32_t firstBinding, const uint32_t bindingCount,
+	                                          const VkBuffer* buffers, const VkDeviceSize* offsets)
+	{
+		if (firstBinding + bindingCount > MAX_VERTEX_BINDINGS)
+			throw std::runtime_error("vertex binding out of range!");
+
+		bool emit = false;
+		for (uint32_t i = 0; i < bindingCount && !emit; i++)
+			emit = _vertexBuffers[firstBinding + i] != buffers[i] || _vertexOffsets[firstBinding + i] != offsets[i];
+
+		if (emit)
+		{
+			vkCmdBindVertexBuffers(_commandBuffer, firstBinding, bindingCount, buffers, offsets);
+			std::copy_n(buffers, bindingCount, _vertexBuffers.begin() + firstBinding);
+			std::copy_n(offsets, bindingCount, _vertexOffsets.begin() + firstBinding);
+		}
+		Count(EncoderCommand::BindVertexBuffers, emit);
+	}
+
+	void AppCommandEncoder::BindIndexBuffer(const VkBuffer buffer, const VkDeviceSize offset,
+	                                        const VkIndexType indexType)
+	{
+		const bool emit = _indexBuffer != buffer || _indexOffset != offset || _indexType != indexType;
+		if (emit)
+		{
+			vkCmdBindIndexBuffer(_commandBuffer, buffer, offset, indexType);
+			_indexBuffer = buffer;
+			_indexOffset = offset;
+			_indexType = indexType;
+		}
+		Count(EncoderCommand::BindIndexBuffer, emit);
+	}
+
+	void AppCommandEncoder::SetViewport(const VkViewport& viewport)
+	{
+		const bool emit = !_hasViewport ||
+			viewport.x != _viewport.x || viewport.y != _viewport.y ||
+			viewport.width != _viewport.width || viewport.height != _viewport.height ||
+			viewport.minDepth != _viewport.minDepth || viewport.maxDepth != _viewport.maxDepth;
+		if (emit)
+		{
+			vkCmdSetViewport(_commandBuffer, 0, 1, &viewport);
+			_viewport = viewport;
+			_hasViewport = true;
+		}
+		Count(EncoderCommand::SetViewport, emit);
+	}
+
+	void AppCommandEncoder::SetScissor(const VkRect2D& scissor)
+	{
+		const bool emit = !_hasScissor ||
+			scissor.offset.x != _scissor.offset.x || scissor.offset.y != _scissor.offset.y ||
+			scissor.extent.width != _scissor.extent.width || scissor.extent.height != _scissor.extent.height;
+		if (emit)
+		{
+			vkCmdSetScissor(_commandBuffer, 0, 1, &scissor);
+			_scissor = scissor;
+			_hasScissor = true;
+		}
+		Count(EncoderCommand::SetScissor, emit);
+	}
+
+	void AppCommandEncoder::PushConstants(const VkPipelineLayout layout, const VkShaderStageFlags stages,
+	                                      const uint32_t offset, const uint32_t size, const void* data)
+	{
+		if (offset + size > MAX_PUSH_CONSTANT_SIZE)
+			throw std::runtime_error("push constant range out of range!");
+
+		if (layout != _pushLayout || stages != _pushStages)
+		{
+			_pushLayout = layout;
+			_pushStages = stages;
+			_pushWritten.fill(false);
+		}
+
+		const bool emit = !std::all_of(_pushWritten.begin() + offset, _pushWritten.begin() + offset + size,
+		                               [](const bool written) { return written; }) ||
+			std::memcmp(_pushData.data() + offset, data, size) != 0;
+		if (emit)
+		{
+			vkCmdPushConstants(_commandBuffer, layout, stages, offset, size, data);
+			std::memcpy(_pushData.data() + offset, data, size);
+			std::fill_n(_pushWritten.begin() + offset, size, true);
+		}
+		Count(EncoderCommand::PushConstants, emit);
+	}
+
+	void AppCommandEncoder::Draw(const uint32_t vertexCount, const uint32_t instanceCount, const uint32_t firstVertex,
+	                             const uint32_t firstInstance) const
+	{
+		vkCmdDraw(_commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+	}
+
+	void AppCommandEncoder::DrawIndexed(const uint32_t indexCount, const uint32_t instanceCount,
+	                                    const uint32_t firstIndex, const int32_t vertexOffset,
+	                                    const uint32_t firstInstance) const
+	{
+		vkCmdDrawIndexed(_commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+	}
+
+	void AppCommandEncoder::Invalidate()
+	{
+		_graphics = {};
+		_compute = {};
+		_vertexBuffers.fill(VK_NULL_HANDLE);
+		_vertexOffsets.fill(0);
+		_indexBuffer = VK_NULL_HANDLE;
+		_hasViewport = false;
+		_hasScissor = false;
+		_pushLayout = VK_NULL_HANDLE;
+		_pushWritten.fill(false);
+	}
+
+	AppCommandEncoder::BindPointState& AppCommandEncoder::State(const VkPipelineBindPoint bindPoint)
+	{
+		if (bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS)
+			return _graphics;
+		if (bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE)
+			return _compute;
+		throw std::runtime_error("unsupported pipeline bind point!");
+	}
+
+	void AppCommandEncoder::Count(const EncoderCommand command, const bool emitted)
+	{
+		if (emitted)
+			_emitted[static_cast<size_t>(command)]++;
+		else
+			_filtered[static_cast<size_t>(command)]++;
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "app_pipline.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace VulkanTest
+{
+	enum class EncoderCommand : uint32_t
+	{
+		BindPipeline,
+		BindDescriptorSets,
+		BindVertexBuffers,
+		BindIndexBuffer,
+		SetViewport,
+		SetScissor,
+		PushConstants,
+		Count
+	};
+
+	// Emitted and filtered commands of every encoder reporting here, shared by all recording threads.
+	// EndFrame closes a frame, the printed numbers are per frame.
+	class CommandEncoderStats
+	{
+	public:
+		void Add(EncoderCommand command, uint64_t emitted, uint64_t filtered);
+		void EndFrame() { _frames++; }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		static constexpr size_t COMMAND_COUNT = static_cast<size_t>(EncoderCommand::Count);
+
+		std::array<std::atomic<uint64_t>, COMMAND_COUNT> _emitted{};
+		std::array<std::atomic<uint64_t>, COMMAND_COUNT> _filtered{};
+		std::atomic<uint64_t> _frames{0};
+	};
+
+	// Records into one command buffer and drops binds and dynamic state that are already set. Shadows only
+	// what was recorded through it, so it starts with nothing bound and has to be the only writer of its
+	// command buffer; one encoder per thread and command buffer. Every pipeline here declares viewport and
+	// scissor dynamic, so binding a pipeline never invalidates them.
+	class AppCommandEncoder
+	{
+	public:
+		static constexpr uint32_t MAX_DESCRIPTOR_SETS = 8;
+		static constexpr uint32_t MAX_VERTEX_BINDINGS = 16;
+		// the guaranteed minimum of maxPushConstantsSize
+		static constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 128;
+
+		explicit AppCommandEncoder(VkCommandBuffer commandBuffer, CommandEncoderStats* stats = nullptr);
+		// reports the counts to the stats
+		~AppCommandEncoder();
+
+		AppCommandEncoder(const AppCommandEncoder&) = delete;
+		AppCommandEncoder& operator=(const AppCommandEncoder&) = delete;
+
+		[[nodiscard]] VkCommandBuffer Handle() const { return _commandBuffer; }
+
+		void BindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+		void BindPipeline(const AppPipeline& pipeline) { BindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.Handle()); }
+		// filtered only without dynamic offsets, those change per draw by design
+		void BindDescriptorSets(
+			VkPipelineBindPoint bindPoint,
+			VkPipelineLayout layout,
+			uint32_t firstSet,
+			uint32_t setCount,
+			const VkDescriptorSet* sets,
+			uint32_t dynamicOffsetCount = 0,
+			const uint32_t* dynamicOffsets = nullptr);
+		void BindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers,
+		                       const VkDeviceSize* offsets);
+		void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+		void SetViewport(const VkViewport& viewport);
+		void SetScissor(const VkRect2D& scissor);
+		void PushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size,
+		                   const void* data);
+
+		void Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) const;
+		void DrawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
+		                 uint32_t firstInstance) const;
+
+		// after anything recorded into the command buffer behind the encoder's back, e.g. a new render pass
+		// with secondaries, so the next call of every kind goes through again
+		void Invalidate();
+
+	private:
+		struct BindPointState
+		{
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> sets{};
+			std::array<VkPipelineLayout, MAX_DESCRIPTOR_SETS> setLayouts{};
+		};
+
+		// graphics or compute, the only bind points this engine uses
+		BindPointState& State(VkPipelineBindPoint bindPoint);
+		void Count(EncoderCommand command, bool emitted);
+
+		VkCommandBuffer _commandBuffer;
+		CommandEncoderStats* _stats;
+
+		BindPointState _graphics;
+		BindPointState _compute;
+
+		std::array<VkBuffer, MAX_VERTEX_BINDINGS> _vertexBuffers{};
+		std::array<VkDeviceSize, MAX_VERTEX_BINDINGS> _vertexOffsets{};
+		VkBuffer _indexBuffer = VK_NULL_HANDLE;
+		VkDeviceSize _indexOffset = 0;
+		VkIndexType _indexType = VK_INDEX_TYPE_UINT16;
+
+		bool _hasViewport = false;
+		VkViewport _viewport{};
+		bool _hasScissor = false;
+		VkRect2D _scissor{};
+
+		// push constant bytes are only compared where they were written before, under the same layout and stages
+		VkPipelineLayout _pushLayout = VK_NULL_HANDLE;
+		VkShaderStageFlags _pushStages = 0;
+		std::array<uint8_t, MAX_PUSH_CONSTANT_SIZE> _pushData{};
+		std::array<bool, MAX_PUSH_CONSTANT_SIZE> _pushWritten{};
+
+		std::array<uint64_t, static_cast<size_t>(EncoderCommand::Count)> _emitted{};
+		std::array<uint64_t, static_cast<size_t>(EncoderCommand::Count)> _filtered{};
+	};
+}
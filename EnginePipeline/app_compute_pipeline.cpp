@@ -0,0 +1,172 @@
+#include "app_compute_pipeline.hpp"
+
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	AppComputePipeline::AppComputePipeline(AppDevice& device,
+	                                       AppPipelineLayoutCache& layoutCache,
+	                                       const std::vector<char>& code,
+	                                       const SpecializationConstants* constants)
+		: _device{device}, _layoutCache{layoutCache}
+	{
+		const ShaderReflection reflection = ShaderReflection::Reflect(code);
+		if (reflection.stage != VK_SHADER_STAGE_COMPUTE_BIT)
+			throw std::runtime_error("failed to create compute pipeline, not a compute shader!");
+
+		_interface = PipelineInterface::Merge({reflection});
+		_localSize = reflection.localSize;
+		_layout = _layoutCache.GetPipelineLayout(_interface);
+
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = code.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		VkShaderModule shaderModule;
+		if (vkCreateShaderModule(_device.Device(), &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+			throw std::runtime_error("failed to create compute shader module!");
+
+		VkSpecializationInfo specializationInfo{};
+		if (constants != nullptr && !constants->Empty())
+		{
+			specializationInfo.mapEntryCount = static_cast<uint32_t>(constants->entries.size());
+			specializationInfo.pMapEntries = constants->entries.data();
+			specializationInfo.dataSize = constants->data.size() * sizeof(uint32_t);
+			specializationInfo.pData = constants->data.data();
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = shaderModule;
+		pipelineInfo.stage.pName = reflection.entryPoint.c_str();
+		pipelineInfo.stage.pSpecializationInfo = specializationInfo.mapEntryCount > 0 ? &specializationInfo : nullptr;
+		pipelineInfo.layout = _layout;
+		pipelineInfo.basePipelineIndex = -1;
+
+		const VkResult result = vkCreateComputePipelines(
+			_device.Device(), _device.PipelineCache().Handle(), 1, &pipelineInfo, nullptr, &_pipeline);
+
+		vkDestroyShaderModule(_device.Device(), shaderModule, nullptr);
+
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("failed to create compute pipeline!");
+	}
+
+	AppComputePipeline::AppComputePipeline(AppDevice& device,
+	                                       AppPipelineLayoutCache& layoutCache,
+	                                       const std::string& filePath,
+	                                       const SpecializationConstants* constants)
+		: AppComputePipeline(device, layoutCache, AppPipeline::ReadFile(filePath), constants)
+	{
+	}
+
+	AppComputePipeline::~AppComputePipeline()
+	{
+		vkDestroyPipeline(_device.Device(), _pipeline, nullptr);
+	}
+
+	void AppComputePipeline::Bind(const VkCommandBuffer commandBuffer) const
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	}
+
+	void AppComputePipeline::BindDescriptorSets(const VkCommandBuffer commandBuffer,
+	                                            const uint32_t firstSet,
+	                                            const std::vector<VkDescriptorSet>& descriptorSets,
+	                                            const std::vector<uint32_t>& dynamicOffsets) const
+	{
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _layout, firstSet,
+		                        static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
+		                        static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+	}
+
+	void AppComputePipeline::PushConstants(const VkCommandBuffer commandBuffer, const void* data,
+	                                       const uint32_t size, const uint32_t offset) const
+	{
+		vkCmdPushConstants(commandBuffer, _layout, VK_SHADER_STAGE_COMPUTE_BIT, offset, size, data);
+	}
+
+	void AppComputePipeline::Dispatch(const VkCommandBuffer commandBuffer, const uint32_t groupsX,
+	                                  const uint32_t groupsY, const uint32_t groupsZ) const
+	{
+		vkCmdDispatch(commandBuffer, groupsX, groupsY, groupsZ);
+	}
+
+	void AppComputePipeline::DispatchThreads(const VkCommandBuffer commandBuffer, const uint32_t threadsX,
+	                                         const uint32_t threadsY, const uint32_t threadsZ) const
+	{
+		vkCmdDispatch(commandBuffer,
+		              (threadsX + _localSize[0] - 1) / _localSize[0],
+		              (threadsY + _localSize[1] - 1) / _localSize[1],
+		              (threadsZ + _localSize[2] - 1) / _localSize[2]);
+	}
+
+	void AppComputePipeline::DispatchIndirect(const VkCommandBuffer commandBuffer, const VkBuffer buffer,
+	                                          const VkDeviceSize offset) const
+	{
+		vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+	}
+
+	VkDescriptorSetLayout AppComputePipeline::SetLayout(const uint32_t set) const
+	{
+		if (set >= _interface.sets.size())
+			throw std::runtime_error("compute pipeline has no descriptor set " + std::to_string(set) + "!");
+
+		return _layoutCache.GetDescriptorSetLayout(_interface.sets[set]);
+	}
+
+	void RecordMemoryBarrier(const VkCommandBuffer commandBuffer,
+	                         const VkPipelineStageFlags srcStages, const VkAccessFlags srcAccess,
+	                         const VkPipelineStageFlags dstStages, const VkAccessFlags dstAccess)
+	{
+		// global barriers, buffer ranges would not buy anything on current drivers
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void RecordComputePasses(const VkCommandBuffer commandBuffer, const std::vector<ComputePass>& passes,
+	                         const ComputeStage stage)
+	{
+		VkPipelineStageFlags consumers = 0;
+		for (const auto& pass : passes)
+		{
+			if (pass.stage == stage)
+				consumers |= pass.consumerStages;
+		}
+
+		// nothing of this stage, not even a barrier
+		if (consumers == 0)
+			return;
+
+		if (stage == ComputeStage::BeforeRenderPass)
+		{
+			// last frame's reads finish before anything is overwritten, an execution dependency is enough
+			RecordMemoryBarrier(commandBuffer, consumers, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+		}
+		else
+		{
+			// attachments the render pass wrote. layout transitions of sampled or storage images are up to the pass
+			RecordMemoryBarrier(commandBuffer,
+			                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			                    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		}
+
+		for (const auto& pass : passes)
+		{
+			if (pass.stage != stage)
+				continue;
+
+			pass.record(commandBuffer);
+			RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			                    pass.consumerStages, pass.consumerAccess);
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "app_device.hpp"
+#include "app_pipeline_layout_cache.hpp"
+#include "app_pipline.hpp"
+#include "app_shader_reflection.hpp"
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace VulkanTest
+{
+	// A compute shader with the layout its SPIR-V declares. The set and pipeline layouts come from the shared
+	// layout cache, the same one graphics pipelines use.
+	class AppComputePipeline
+	{
+	public:
+		AppComputePipeline(
+			AppDevice& device,
+			AppPipelineLayoutCache& layoutCache,
+			const std::vector<char>& code,
+			const SpecializationConstants* constants = nullptr);
+		AppComputePipeline(
+			AppDevice& device,
+			AppPipelineLayoutCache& layoutCache,
+			const std::string& filePath,
+			const SpecializationConstants* constants = nullptr);
+		~AppComputePipeline();
+
+		AppComputePipeline(const AppComputePipeline&) = delete;
+		AppComputePipeline& operator=(const AppComputePipeline&) = delete;
+
+		void Bind(VkCommandBuffer commandBuffer) const;
+		void BindDescriptorSets(
+			VkCommandBuffer commandBuffer,
+			uint32_t firstSet,
+			const std::vector<VkDescriptorSet>& descriptorSets,
+			const std::vector<uint32_t>& dynamicOffsets = {}) const;
+		void PushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size, uint32_t offset = 0) const;
+
+		template <typename T>
+		void PushConstants(const VkCommandBuffer commandBuffer, const T& value, const uint32_t offset = 0) const
+		{
+			PushConstants(commandBuffer, &value, static_cast<uint32_t>(sizeof(T)), offset);
+		}
+
+		// in workgroups
+		void Dispatch(VkCommandBuffer commandBuffer, uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1) const;
+		// in invocations, rounded up to whole workgroups of the shader's local size
+		void DispatchThreads(VkCommandBuffer commandBuffer, uint32_t threadsX, uint32_t threadsY = 1,
+		                     uint32_t threadsZ = 1) const;
+		// group counts read from a VkDispatchIndirectCommand the gpu wrote, e.g. by a culling pass
+		void DispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0) const;
+
+		[[nodiscard]] VkPipeline Handle() const { return _pipeline; }
+		[[nodiscard]] VkPipelineLayout Layout() const { return _layout; }
+		// allocate descriptor sets for this pipeline against these
+		[[nodiscard]] VkDescriptorSetLayout SetLayout(uint32_t set) const;
+		[[nodiscard]] const std::array<uint32_t, 3>& LocalSize() const { return _localSize; }
+
+	private:
+		AppDevice& _device;
+		AppPipelineLayoutCache& _layoutCache;
+		PipelineInterface _interface;
+		std::array<uint32_t, 3> _localSize{1, 1, 1};
+		// owned by the layout cache
+		VkPipelineLayout _layout = VK_NULL_HANDLE;
+		VkPipeline _pipeline = VK_NULL_HANDLE;
+	};
+
+	// where a compute pass runs relative to the frame's render pass
+	enum class ComputeStage
+	{
+		// results feed this frame's draws: vertex data, indirect arguments, culling
+		BeforeRenderPass,
+		// reads what the render pass wrote: post-processing, readback
+		AfterRenderPass
+	};
+
+	// One compute step of the frame, recorded into the frame's command buffer outside the render pass.
+	// The barriers around it come from the stages named here, the pass itself only records dispatches.
+	struct ComputePass
+	{
+		std::string name;
+		ComputeStage stage = ComputeStage::BeforeRenderPass;
+		// who reads what the pass writes. for BeforeRenderPass the same stages also read last frame's
+		// results, so the pass waits for them before overwriting anything
+		VkPipelineStageFlags consumerStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+		VkAccessFlags consumerAccess = VK_ACCESS_SHADER_READ_BIT;
+		std::function<void(VkCommandBuffer)> record;
+	};
+
+	// one global memory barrier, for dependencies inside a pass
+	void RecordMemoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+	                         VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+
+	// records every pass of one stage in order, each followed by a barrier to its consumers
+	void RecordComputePasses(VkCommandBuffer commandBuffer, const std::vector<ComputePass>& passes, ComputeStage stage);
+}
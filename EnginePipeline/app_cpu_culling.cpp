@@ -0,0 +1,544 @@
+#include "app_cpu_culling.hpp"
+#include "app_cpu_features.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VULKANTEST_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// msvc emits any instruction set's intrinsics without flags, and only contracts under /fp:fast or /fp:contract
+#define VULKANTEST_TARGET(isa)
+#define VULKANTEST_NO_CONTRACT
+#else
+// lets one translation unit hold kernels above the compiler's baseline, they only run after a cpuid check
+#define VULKANTEST_TARGET(isa) __attribute__((target(isa)))
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#define VULKANTEST_NO_CONTRACT
+#else
+// gcc fuses a * b + c into one fma for c++ even in iso mode, and the fma rounds once where the others round twice
+#define VULKANTEST_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#endif
+#endif
+
+namespace VulkanTest
+{
+	namespace
+	{
+		using Volume = AppCpuCulling::Volume;
+		constexpr size_t BLOCK_SIZE = AppCpuCulling::BLOCK_SIZE;
+		// blocks per job pool range, small lists stay on the calling thread
+		constexpr size_t MIN_BLOCKS_PER_RANGE = 64;
+
+		// the frustum split into one array per component, ready to broadcast
+		struct CullPlanes
+		{
+			std::array<float, Frustum::PLANE_COUNT> x, y, z, w;
+			std::array<float, Frustum::PLANE_COUNT> absX, absY, absZ;
+		};
+
+		CullPlanes SplitPlanes(const Frustum& frustum)
+		{
+			CullPlanes planes{};
+			for (size_t i = 0; i < Frustum::PLANE_COUNT; i++)
+			{
+				planes.x[i] = frustum.planes[i][0];
+				planes.y[i] = frustum.planes[i][1];
+				planes.z[i] = frustum.planes[i][2];
+				planes.w[i] = frustum.planes[i][3];
+				planes.absX[i] = std::fabs(planes.x[i]);
+				planes.absY[i] = std::fabs(planes.y[i]);
+				planes.absZ[i] = std::fabs(planes.z[i]);
+			}
+			return planes;
+		}
+
+		using KernelFunction = void (*)(const CullingBounds& bounds, const CullPlanes& planes, Volume volume,
+		                                size_t firstBlock, size_t lastBlock, uint16_t* masks);
+
+		// every kernel adds in this order and none of them is allowed fused multiply adds, so all of them
+		// agree with the scalar one bit for bit:
+		// sphere  x*cx + y*cy + z*cz + w >= -r
+		// box     x*cx + y*cy + z*cz + w + |x|*ex + |y|*ey + |z|*ez >= 0
+		VULKANTEST_NO_CONTRACT
+		void CullScalar(const CullingBounds& bounds, const CullPlanes& planes, const Volume volume,
+		                const size_t firstBlock, const size_t lastBlock, uint16_t* masks)
+		{
+			for (size_t block = firstBlock; block < lastBlock; block++)
+			{
+				uint32_t mask = 0;
+				for (size_t lane = 0; lane < BLOCK_SIZE; lane++)
+				{
+					const size_t i = block * BLOCK_SIZE + lane;
+					bool inside = true;
+					for (size_t p = 0; p < Frustum::PLANE_COUNT && inside; p++)
+					{
+						if (volume == Volume::Sphere)
+						{
+							const float distance = planes.x[p] * bounds.sphereX[i] + planes.y[p] * bounds.sphereY[i] +
+								planes.z[p] * bounds.sphereZ[i] + planes.w[p];
+							inside = distance >= -bounds.sphereRadius[i];
+						}
+						else
+						{
+							const float distance = planes.x[p] * bounds.boxX[i] + planes.y[p] * bounds.boxY[i] +
+								planes.z[p] * bounds.boxZ[i] + planes.w[p] + planes.absX[p] * bounds.boxExtentX[i] +
+								planes.absY[p] * bounds.boxExtentY[i] + planes.absZ[p] * bounds.boxExtentZ[i];
+							inside = distance >= 0.0f;
+						}
+					}
+					mask |= static_cast<uint32_t>(inside) << lane;
+				}
+				masks[block] = static_cast<uint16_t>(mask);
+			}
+		}
+
+#if defined(VULKANTEST_X86)
+		VULKANTEST_TARGET("sse2")
+		VULKANTEST_NO_CONTRACT
+		void CullSse2(const CullingBounds& bounds, const CullPlanes& planes, const Volume volume,
+		              const size_t firstBlock, const size_t lastBlock, uint16_t* masks)
+		{
+			constexpr size_t WIDTH = 4;
+			for (size_t block = firstBlock; block < lastBlock; block++)
+			{
+				uint32_t mask = 0;
+				for (size_t lane = 0; lane < BLOCK_SIZE; lane += WIDTH)
+				{
+					const size_t i = block * BLOCK_SIZE + lane;
+					__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+					if (volume == Volume::Sphere)
+					{
+						const __m128 x = _mm_loadu_ps(&bounds.sphereX[i]);
+						const __m128 y = _mm_loadu_ps(&bounds.sphereY[i]);
+						const __m128 z = _mm_loadu_ps(&bounds.sphereZ[i]);
+						const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.sphereRadius[i]));
+						for (size_t p = 0; p < Frustum::PLANE_COUNT; p++)
+						{
+							__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.x[p]), x),
+							                             _mm_mul_ps(_mm_set1_ps(planes.y[p]), y));
+							distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.z[p]), z));
+							distance = _mm_add_ps(distance, _mm_set1_ps(planes.w[p]));
+							inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+						}
+					}
+					else
+					{
+						const __m128 x = _mm_loadu_ps(&bounds.boxX[i]);
+						const __m128 y = _mm_loadu_ps(&bounds.boxY[i]);
+						const __m128 z = _mm_loadu_ps(&bounds.boxZ[i]);
+						const __m128 extentX = _mm_loadu_ps(&bounds.boxExtentX[i]);
+						const __m128 extentY = _mm_loadu_ps(&bounds.boxExtentY[i]);
+						const __m128 extentZ = _mm_loadu_ps(&bounds.boxExtentZ[i]);
+						for (size_t p = 0; p < Frustum::PLANE_COUNT; p++)
+						{
+							__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.x[p]), x),
+							                             _mm_mul_ps(_mm_set1_ps(planes.y[p]), y));
+							distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.z[p]), z));
+							distance = _mm_add_ps(distance, _mm_set1_ps(planes.w[p]));
+							distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.absX[p]), extentX));
+							distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.absY[p]), extentY));
+							distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.absZ[p]), extentZ));
+							inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+						}
+					}
+					mask |= static_cast<uint32_t>(_mm_movemask_ps(inside)) << lane;
+				}
+				masks[block] = static_cast<uint16_t>(mask);
+			}
+		}
+
+		VULKANTEST_TARGET("avx2")
+		VULKANTEST_NO_CONTRACT
+		void CullAvx2(const CullingBounds& bounds, const CullPlanes& planes, const Volume volume,
+		              const size_t firstBlock, const size_t lastBlock, uint16_t* masks)
+		{
+			constexpr size_t WIDTH = 8;
+			for (size_t block = firstBlock; block < lastBlock; block++)
+			{
+				uint32_t mask = 0;
+				for (size_t lane = 0; lane < BLOCK_SIZE; lane += WIDTH)
+				{
+					const size_t i = block * BLOCK_SIZE + lane;
+					__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+					if (volume == Volume::Sphere)
+					{
+						const __m256 x = _mm256_loadu_ps(&bounds.sphereX[i]);
+						const __m256 y = _mm256_loadu_ps(&bounds.sphereY[i]);
+						const __m256 z = _mm256_loadu_ps(&bounds.sphereZ[i]);
+						const __m256 negativeRadius =
+							_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&bounds.sphereRadius[i]));
+						for (size_t p = 0; p < Frustum::PLANE_COUNT; p++)
+						{
+							__m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.x[p]), x),
+							                                _mm256_mul_ps(_mm256_set1_ps(planes.y[p]), y));
+							distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.z[p]), z));
+							distance = _mm256_add_ps(distance, _mm256_set1_ps(planes.w[p]));
+							inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+						}
+					}
+					else
+					{
+						const __m256 x = _mm256_loadu_ps(&bounds.boxX[i]);
+						const __m256 y = _mm256_loadu_ps(&bounds.boxY[i]);
+						const __m256 z = _mm256_loadu_ps(&bounds.boxZ[i]);
+						const __m256 extentX = _mm256_loadu_ps(&bounds.boxExtentX[i]);
+						const __m256 extentY = _mm256_loadu_ps(&bounds.boxExtentY[i]);
+						const __m256 extentZ = _mm256_loadu_ps(&bounds.boxExtentZ[i]);
+						for (size_t p = 0; p < Frustum::PLANE_COUNT; p++)
+						{
+							__m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.x[p]), x),
+							                                _mm256_mul_ps(_mm256_set1_ps(planes.y[p]), y));
+							distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.z[p]), z));
+							distance = _mm256_add_ps(distance, _mm256_set1_ps(planes.w[p]));
+							distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.absX[p]), extentX));
+							distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.absY[p]), extentY));
+							distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.absZ[p]), extentZ));
+							inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+						}
+					}
+					mask |= static_cast<uint32_t>(_mm256_movemask_ps(inside)) << lane;
+				}
+				masks[block] = static_cast<uint16_t>(mask);
+			}
+		}
+
+		VULKANTEST_TARGET("avx512f")
+		VULKANTEST_NO_CONTRACT
+		void CullAvx512(const CullingBounds& bounds, const CullPlanes& planes, const Volume volume,
+		                const size_t firstBlock, const size_t lastBlock, uint16_t* masks)
+		{
+			// a block is exactly one register, lanes that fail a plane are left out of the next compare
+			for (size_t block = firstBlock; block < lastBlock; block++)
+			{
+				const size_t i = block * BLOCK_SIZE;
+				__mmask16 inside = 0xffff;
+				if (volume == Volume::Sphere)
+				{
+					const __m512 x = _mm512_loadu_ps(&bounds.sphereX[i]);
+					const __m512 y = _mm512_loadu_ps(&bounds.sphereY[i]);
+					const __m512 z = _mm512_loadu_ps(&bounds.sphereZ[i]);
+					const __m512 negativeRadius =
+						_mm512_sub_ps(_mm512_setzero_ps(), _mm512_loadu_ps(&bounds.sphereRadius[i]));
+					for (size_t p = 0; p < Frustum::PLANE_COUNT; p++)
+					{
+						__m512 distance = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(planes.x[p]), x),
+						                                _mm512_mul_ps(_mm512_set1_ps(planes.y[p]), y));
+						distance = _mm512_add_ps(distance, _mm512_mul_ps(_mm512_set1_ps(planes.z[p]), z));
+						distance = _mm512_add_ps(distance, _mm512_set1_ps(planes.w[p]));
+						inside = _mm512_mask_cmp_ps_mask(inside, distance, negativeRadius, _CMP_GE_OQ);
+					}
+				}
+				else
+				{
+					const __m512 x = _mm512_loadu_ps(&bounds.boxX[i]);
+					const __m512 y = _mm512_loadu_ps(&bounds.boxY[i]);
+					const __m512 z = _mm512_loadu_ps(&bounds.boxZ[i]);
+					const __m512 extentX = _mm512_loadu_ps(&bounds.boxExtentX[i]);
+					const __m512 extentY = _mm512_loadu_ps(&bounds.boxExtentY[i]);
+					const __m512 extentZ = _mm512_loadu_ps(&bounds.boxExtentZ[i]);
+					for (size_t p = 0; p < Frustum::PLANE_COUNT; p++)
+					{
+						__m512 distance = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(planes.x[p]), x),
+						                                _mm512_mul_ps(_mm512_set1_ps(planes.y[p]), y));
+						distance = _mm512_add_ps(distance, _mm512_mul_ps(_mm512_set1_ps(planes.z[p]), z));
+						distance = _mm512_add_ps(distance, _mm512_set1_ps(planes.w[p]));
+						distance = _mm512_add_ps(distance, _mm512_mul_ps(_mm512_set1_ps(planes.absX[p]), extentX));
+						distance = _mm512_add_ps(distance, _mm512_mul_ps(_mm512_set1_ps(planes.absY[p]), extentY));
+						distance = _mm512_add_ps(distance, _mm512_mul_ps(_mm512_set1_ps(planes.absZ[p]), extentZ));
+						inside = _mm512_mask_cmp_ps_mask(inside, distance, _mm512_setzero_ps(), _CMP_GE_OQ);
+					}
+				}
+				masks[block] = static_cast<uint16_t>(inside);
+			}
+		}
+#endif
+
+		KernelFunction KernelFor(const AppCpuCulling::Kernel kernel)
+		{
+			switch (kernel)
+			{
+			case AppCpuCulling::Kernel::Scalar:
+				return CullScalar;
+#if defined(VULKANTEST_X86)
+			case AppCpuCulling::Kernel::Sse2:
+				return CullSse2;
+			case AppCpuCulling::Kernel::Avx2:
+				return CullAvx2;
+			case AppCpuCulling::Kernel::Avx512:
+				return CullAvx512;
+#endif
+			default:
+				return nullptr;
+			}
+		}
+
+		uint32_t LowestSetBit(const uint32_t mask)
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+		}
+
+		// column major perspective looking down -z with vulkan's [0, 1] depth
+		std::array<float, 16> BenchmarkViewProjection()
+		{
+			constexpr float fovY = 1.0471976f;
+			constexpr float aspect = 16.0f / 9.0f;
+			constexpr float nearPlane = 0.1f;
+			constexpr float farPlane = 100.0f;
+			const float focal = 1.0f / std::tan(fovY * 0.5f);
+
+			std::array<float, 16> matrix{};
+			matrix[0] = focal / aspect;
+			matrix[5] = focal;
+			matrix[10] = farPlane / (nearPlane - farPlane);
+			matrix[11] = -1.0f;
+			matrix[14] = nearPlane * farPlane / (nearPlane - farPlane);
+			return matrix;
+		}
+	}
+
+	bool AppCpuCulling::Supports(const Kernel kernel)
+	{
+		if (KernelFor(kernel) == nullptr)
+			return false;
+
+		const CpuFeatures& features = CpuFeatures::Get();
+		switch (kernel)
+		{
+		case Kernel::Scalar:
+			return true;
+		case Kernel::Sse2:
+			return features.sse2;
+		case Kernel::Avx2:
+			return features.avx2;
+		case Kernel::Avx512:
+			return features.avx512f;
+		default:
+			return false;
+		}
+	}
+
+	AppCpuCulling::Kernel AppCpuCulling::BestKernel()
+	{
+		for (const Kernel kernel : {Kernel::Avx512, Kernel::Avx2, Kernel::Sse2})
+		{
+			if (Supports(kernel))
+				return kernel;
+		}
+		return Kernel::Scalar;
+	}
+
+	const char* AppCpuCulling::KernelName(const Kernel kernel)
+	{
+		switch (kernel)
+		{
+		case Kernel::Scalar:
+			return "scalar";
+		case Kernel::Sse2:
+			return "sse2";
+		case Kernel::Avx2:
+			return "avx2";
+		case Kernel::Avx512:
+			return "avx512";
+		default:
+			return "unknown";
+		}
+	}
+
+	AppCpuCulling::AppCpuCulling(AppJobPool& jobPool, const Kernel kernel)
+		: _jobPool{jobPool}, _kernel{Kernel::Scalar}
+	{
+		SetKernel(kernel);
+	}
+
+	void AppCpuCulling::SetKernel(const Kernel kernel)
+	{
+		if (!Supports(kernel))
+			throw std::runtime_error(std::string("culling kernel ") + KernelName(kernel) + " is not supported!");
+		_kernel = kernel;
+	}
+
+	uint32_t AppCpuCulling::Append()
+	{
+		if (_count % BLOCK_SIZE == 0)
+		{
+			constexpr float padding = std::numeric_limits<float>::quiet_NaN();
+			for (auto* stream : {
+				     &_bounds.sphereX, &_bounds.sphereY, &_bounds.sphereZ, &_bounds.sphereRadius,
+				     &_bounds.boxX, &_bounds.boxY, &_bounds.boxZ,
+				     &_bounds.boxExtentX, &_bounds.boxExtentY, &_bounds.boxExtentZ
+			     })
+				stream->resize(_count + BLOCK_SIZE, padding);
+		}
+		return _count++;
+	}
+
+	uint32_t AppCpuCulling::AddBox(const std::array<float, 3>& min, const std::array<float, 3>& max)
+	{
+		const uint32_t index = Append();
+		const std::array<float, 3> center = {
+			(min[0] + max[0]) * 0.5f, (min[1] + max[1]) * 0.5f, (min[2] + max[2]) * 0.5f
+		};
+		const std::array<float, 3> extent = {
+			(max[0] - min[0]) * 0.5f, (max[1] - min[1]) * 0.5f, (max[2] - min[2]) * 0.5f
+		};
+
+		_bounds.sphereX[index] = center[0];
+		_bounds.sphereY[index] = center[1];
+		_bounds.sphereZ[index] = center[2];
+		_bounds.sphereRadius[index] =
+			std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]);
+		_bounds.boxX[index] = center[0];
+		_bounds.boxY[index] = center[1];
+		_bounds.boxZ[index] = center[2];
+		_bounds.boxExtentX[index] = extent[0];
+		_bounds.boxExtentY[index] = extent[1];
+		_bounds.boxExtentZ[index] = extent[2];
+		return index;
+	}
+
+	uint32_t AppCpuCulling::AddSphere(const std::array<float, 3>& center, const float radius)
+	{
+		const uint32_t index = Append();
+		_bounds.sphereX[index] = center[0];
+		_bounds.sphereY[index] = center[1];
+		_bounds.sphereZ[index] = center[2];
+		_bounds.sphereRadius[index] = radius;
+		_bounds.boxX[index] = center[0];
+		_bounds.boxY[index] = center[1];
+		_bounds.boxZ[index] = center[2];
+		_bounds.boxExtentX[index] = radius;
+		_bounds.boxExtentY[index] = radius;
+		_bounds.boxExtentZ[index] = radius;
+		return index;
+	}
+
+	void AppCpuCulling::Clear()
+	{
+		_bounds = {};
+		_count = 0;
+	}
+
+	void AppCpuCulling::Cull(const Frustum& frustum, const Volume volume, std::vector<uint32_t>& visible,
+	                         const bool parallel)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		const size_t blocks = (_count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		_masks.resize(blocks);
+
+		const CullPlanes planes = SplitPlanes(frustum);
+		const KernelFunction kernel = KernelFor(_kernel);
+		if (parallel)
+		{
+			// ranges own disjoint blocks of the masks, nothing is shared while they run
+			_jobPool.ParallelFor(blocks, MIN_BLOCKS_PER_RANGE, [&](const size_t first, const size_t last)
+			{
+				kernel(_bounds, planes, volume, first, last, _masks.data());
+			});
+		}
+		else
+			kernel(_bounds, planes, volume, 0, blocks, _masks.data());
+
+		// the padding is NaN and never visible, so only set lanes are real objects
+		visible.clear();
+		for (size_t block = 0; block < blocks; block++)
+		{
+			for (uint32_t mask = _masks[block]; mask != 0; mask &= mask - 1)
+				visible.push_back(static_cast<uint32_t>(block * BLOCK_SIZE) + LowestSetBit(mask));
+		}
+
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		_calls++;
+		_tested += _count;
+		_visible += visible.size();
+		_totalMs += elapsed.count();
+	}
+
+	void AppCpuCulling::PrintStats(std::ostream& out) const
+	{
+		const double calls = static_cast<double>(std::max<uint64_t>(_calls, 1));
+		out << "cpu_culling kernel=" << KernelName(_kernel) << " objects=" << _count << " calls=" << _calls
+			<< " visible_per_call=" << _visible / calls << " avg_ms=" << _totalMs / calls
+			<< " ns_per_object=" << (_tested > 0 ? _totalMs * 1e6 / _tested : 0.0) << std::endl;
+	}
+
+	void AppCpuCulling::RunBenchmark(AppJobPool& jobPool, const uint32_t objectCount, std::ostream& out)
+	{
+		// boxes scattered around and behind the camera, a fixed seed so runs compare
+		AppCpuCulling culling(jobPool, Kernel::Scalar);
+		uint32_t seed = 12345;
+		const auto random = [&seed](const float min, const float max)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return min + (max - min) * static_cast<float>(seed >> 8) / static_cast<float>(1u << 24);
+		};
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			const std::array<float, 3> center = {random(-60.0f, 60.0f), random(-60.0f, 60.0f), random(-110.0f, 10.0f)};
+			const std::array<float, 3> extent = {random(0.1f, 2.0f), random(0.1f, 2.0f), random(0.1f, 2.0f)};
+			culling.AddBox({center[0] - extent[0], center[1] - extent[1], center[2] - extent[2]},
+			               {center[0] + extent[0], center[1] + extent[1], center[2] + extent[2]});
+		}
+
+		const Frustum frustum = Frustum::FromViewProjection(BenchmarkViewProjection());
+		// enough repetitions for a stable average without taking long on big lists
+		const uint32_t iterations = std::max(5u, 20000000u / std::max(objectCount, 1u));
+
+		out << "cpu_cull_benchmark_setup objects=" << objectCount << " iterations=" << iterations
+			<< " threads=" << jobPool.ThreadCount() + 1 << " best=" << KernelName(BestKernel()) << std::endl;
+
+		for (const Volume volume : {Volume::Sphere, Volume::Aabb})
+		{
+			std::vector<uint32_t> reference;
+			culling.SetKernel(Kernel::Scalar);
+			culling.Cull(frustum, volume, reference, false);
+
+			double scalarNs = 0.0;
+			for (uint32_t k = 0; k < static_cast<uint32_t>(Kernel::Count); k++)
+			{
+				const auto kernel = static_cast<Kernel>(k);
+				if (!Supports(kernel))
+					continue;
+
+				culling.SetKernel(kernel);
+				for (const bool parallel : {false, true})
+				{
+					std::vector<uint32_t> visible;
+					culling.Cull(frustum, volume, visible, parallel);
+					const bool matches = visible == reference;
+
+					const auto start = std::chrono::steady_clock::now();
+					for (uint32_t i = 0; i < iterations; i++)
+						culling.Cull(frustum, volume, visible, parallel);
+					const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+					const double nsPerObject = elapsed.count() / (static_cast<double>(iterations) * std::max(objectCount, 1u));
+					if (kernel == Kernel::Scalar && !parallel)
+						scalarNs = nsPerObject;
+
+					out << "cpu_cull_benchmark kernel=" << KernelName(kernel)
+						<< " volume=" << (volume == Volume::Sphere ? "sphere" : "aabb")
+						<< " parallel=" << (parallel ? 1 : 0) << " visible=" << visible.size()
+						<< " ns_per_object=" << nsPerObject
+						<< " speedup=" << (nsPerObject > 0.0 ? scalarNs / nsPerObject : 0.0)
+						<< " matches_scalar=" << (matches ? 1 : 0) << std::endl;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "app_frustum.hpp"
+#include "app_job_pool.hpp"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Bounding volumes as structure of arrays, one stream per component, so a kernel loads the same
+	// component of several objects at once. Padded to whole blocks with NaN, which fails every plane test.
+	struct CullingBounds
+	{
+		std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+		// boxes as center and half extent, the extent projected on a plane normal is three multiply-adds
+		std::vector<float> boxX, boxY, boxZ, boxExtentX, boxExtentY, boxExtentZ;
+	};
+
+	// Frustum culling on the cpu, for what cannot go gpu driven: shadow cascades, per view visibility lists,
+	// draws submitted from the cpu. Objects are tested a block at a time by the widest kernel the cpu
+	// supports, SSE2, AVX2 or AVX-512, with a scalar reference that gives the same answers. Blocks are split
+	// across the job pool and the visible indices come out in ascending order.
+	class AppCpuCulling
+	{
+	public:
+		// objects per kernel step, one AVX-512 register
+		static constexpr size_t BLOCK_SIZE = 16;
+
+		enum class Kernel
+		{
+			Scalar,
+			Sse2,
+			Avx2,
+			Avx512,
+			Count
+		};
+
+		// what is tested against the planes
+		enum class Volume
+		{
+			Sphere,
+			Aabb
+		};
+
+		// built into this binary and supported by the cpu and the os
+		static bool Supports(Kernel kernel);
+		// the widest supported kernel
+		static Kernel BestKernel();
+		static const char* KernelName(Kernel kernel);
+
+		// compares every supported kernel against the scalar one, serial and on the pool
+		static void RunBenchmark(AppJobPool& jobPool, uint32_t objectCount, std::ostream& out);
+
+		explicit AppCpuCulling(AppJobPool& jobPool, Kernel kernel = BestKernel());
+
+		AppCpuCulling(const AppCpuCulling&) = delete;
+		AppCpuCulling& operator=(const AppCpuCulling&) = delete;
+
+		// the sphere is the box's bounding sphere
+		uint32_t AddBox(const std::array<float, 3>& min, const std::array<float, 3>& max);
+		// the box is the sphere's bounding box
+		uint32_t AddSphere(const std::array<float, 3>& center, float radius);
+		void Clear();
+		[[nodiscard]] uint32_t Size() const { return _count; }
+
+		// throws if the kernel is not supported here
+		void SetKernel(Kernel kernel);
+		[[nodiscard]] Kernel GetKernel() const { return _kernel; }
+
+		// replaces visible with the objects the frustum may see. conservative like Frustum::IntersectsSphere,
+		// volumes near a corner may pass although they are outside. serial skips the job pool
+		void Cull(const Frustum& frustum, Volume volume, std::vector<uint32_t>& visible, bool parallel = true);
+
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		// one index past the stored objects, padding the streams with a new block when needed
+		uint32_t Append();
+
+		AppJobPool& _jobPool;
+		Kernel _kernel;
+		CullingBounds _bounds;
+		uint32_t _count = 0;
+		// visible lanes per block, written by the kernels in parallel and compacted afterwards
+		std::vector<uint16_t> _masks;
+
+		uint64_t _calls = 0;
+		uint64_t _tested = 0;
+		uint64_t _visible = 0;
+		double _totalMs = 0.0;
+	};
+}
@@ -0,0 +1,92 @@
+#include "app_cpu_features.hpp"
+
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VULKANTEST_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace VulkanTest
+{
+	namespace
+	{
+#if defined(VULKANTEST_X86)
+		void Cpuid(const int leaf, const int subLeaf, uint32_t registers[4])
+		{
+#if defined(_MSC_VER)
+			int values[4];
+			__cpuidex(values, leaf, subLeaf);
+			for (int i = 0; i < 4; i++)
+				registers[i] = static_cast<uint32_t>(values[i]);
+#else
+			__cpuid_count(leaf, subLeaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+		}
+
+		// the register state the os saves on context switches, wide registers are useless without it
+		uint64_t EnabledStateComponents()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			uint32_t low = 0;
+			uint32_t high = 0;
+			__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+			return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+		}
+
+		CpuFeatures Detect()
+		{
+			CpuFeatures features;
+
+			uint32_t registers[4] = {};
+			Cpuid(0, 0, registers);
+			const uint32_t maxLeaf = registers[0];
+			if (maxLeaf < 1)
+				return features;
+
+			Cpuid(1, 0, registers);
+			const uint32_t ecx1 = registers[2];
+			const uint32_t edx1 = registers[3];
+			features.sse2 = (edx1 & (1u << 26)) != 0;
+			features.sse41 = (ecx1 & (1u << 19)) != 0;
+
+			const bool osSavesState = (ecx1 & (1u << 27)) != 0;
+			const uint64_t stateComponents = osSavesState ? EnabledStateComponents() : 0;
+			// xmm and ymm state
+			const bool osAvx = (stateComponents & 0x6) == 0x6;
+			// plus opmask and both halves of zmm
+			const bool osAvx512 = (stateComponents & 0xe6) == 0xe6;
+
+			features.avx = osAvx && (ecx1 & (1u << 28)) != 0;
+			features.fma = features.avx && (ecx1 & (1u << 12)) != 0;
+
+			if (maxLeaf >= 7)
+			{
+				Cpuid(7, 0, registers);
+				const uint32_t ebx7 = registers[1];
+				features.avx2 = features.avx && (ebx7 & (1u << 5)) != 0;
+				features.avx512f = osAvx512 && (ebx7 & (1u << 16)) != 0;
+			}
+			return features;
+		}
+#else
+		CpuFeatures Detect()
+		{
+			return {};
+		}
+#endif
+	}
+
+	const CpuFeatures& CpuFeatures::Get()
+	{
+		static const CpuFeatures features = Detect();
+		return features;
+	}
+}
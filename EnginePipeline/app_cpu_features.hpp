@@ -0,0 +1,18 @@
+#pragma once
+
+namespace VulkanTest
+{
+	// Instruction set extensions the cpu and the os both support, detected once with cpuid and xgetbv.
+	// Kernels built for a wider instruction set than the compiler's baseline are chosen from these at runtime.
+	struct CpuFeatures
+	{
+		bool sse2 = false;
+		bool sse41 = false;
+		bool avx = false;
+		bool avx2 = false;
+		bool fma = false;
+		bool avx512f = false;
+
+		static const CpuFeatures& Get();
+	};
+}
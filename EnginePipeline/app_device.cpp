@@ -1,6 +1,10 @@
 #include "app_device.hpp"
 #include "Init.hpp"
+#include "app_environment.hpp"
+#include "app_startup_profiler.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -26,18 +30,69 @@ namespace VulkanTest
 
 
 	// class member functions
-	AppDevice::AppDevice(MainWindow& window) : window{window}
+	AppDevice::AppDevice(MainWindow& window) : window{&window}
 	{
-		CreateInstance();
-		initializers::SetupDebugMessenger();
-		CreateSurface();
-		PickPhysicalDevice();
-		CreateLogicalDevice();
-		CreateCommandPool();
+		Initialize();
+	}
+
+	AppDevice::AppDevice() : window{nullptr}
+	{
+		Initialize();
+	}
+
+	void AppDevice::Initialize()
+	{
+		if (!IsHeadless())
+			deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+		{
+			AppStartupProfiler::Scope scope("instance");
+			CreateInstance();
+		}
+		{
+			AppStartupProfiler::Scope scope("debug_messenger");
+			initializers::SetupDebugMessenger();
+		}
+		{
+			AppStartupProfiler::Scope scope("surface");
+			CreateSurface();
+		}
+		{
+			AppStartupProfiler::Scope scope("physical_device");
+			PickPhysicalDevice();
+		}
+		{
+			AppStartupProfiler::Scope scope("logical_device");
+			CreateLogicalDevice();
+		}
+		{
+			AppStartupProfiler::Scope scope("pipeline_cache");
+			pipelineCache_ = std::make_unique<AppPipelineCache>(device_, properties);
+		}
+		{
+			AppStartupProfiler::Scope scope("allocator");
+			memoryBudget_ = std::make_unique<AppMemoryBudget>(
+				physicalDevice, IsExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+			allocator_ = std::make_unique<AppMemoryAllocator>(physicalDevice, device_, *memoryBudget_);
+		}
+		{
+			AppStartupProfiler::Scope scope("command_pool");
+			CreateCommandPool();
+			uploadQueue_ = std::make_unique<AppUploadQueue>(
+				*this, transferQueue_, queueFamilies_.transferFamily, graphicsQueue_, queueFamilies_.graphicsFamily);
+		}
 	}
 
 	AppDevice::~AppDevice()
 	{
+		uploadQueue_.reset();
+		pipelineCache_.reset();
+
+		allocator_->PrintStats(std::cout);
+		allocator_.reset();
+		memoryBudget_.reset();
+
+		vkDestroyCommandPool(device_, computeCommandPool_, nullptr);
 		vkDestroyCommandPool(device_, commandPool, nullptr);
 		vkDestroyDevice(device_, nullptr);
 
@@ -45,7 +100,8 @@ namespace VulkanTest
 			initializers::DestroyMessenger();
 
 
-		vkDestroySurfaceKHR(instance, surface_, nullptr);
+		if (surface_ != VK_NULL_HANDLE)
+			vkDestroySurfaceKHR(instance, surface_, nullptr);
 		vkDestroyInstance(instance, nullptr);
 	}
 
@@ -56,9 +112,10 @@ namespace VulkanTest
 			throw std::runtime_error("validation layers requested, but not available!");
 
 		initializers::CreateAppInfo();
-		initializers::CreateInstance(&instance);
+		initializers::CreateInstance(&instance, IsHeadless());
 
-		HasGflwRequiredInstanceExtensions();
+		if (!IsHeadless())
+			HasGflwRequiredInstanceExtensions();
 	}
 
 	void AppDevice::PickPhysicalDevice()
@@ -73,30 +130,214 @@ namespace VulkanTest
 		std::vector<VkPhysicalDevice> devices(deviceCount);
 		vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
-		for (const auto& device : devices)
+		std::vector<DeviceCandidate> candidates;
+		for (uint32_t i = 0; i < deviceCount; i++)
+			candidates.push_back(RateDevice(devices[i], i));
+
+		// key=value lines so deployment logs can be grepped and parsed
+		for (const auto& [device, index, name, suitable, score, reasons] : candidates)
 		{
-			if (IsDeviceSuitable(device))
+			std::cout << "device_candidate index=" << index << " name=\"" << name << "\" suitable=" << suitable
+				<< " score=" << score << " reasons=\"";
+			for (size_t r = 0; r < reasons.size(); r++)
+				std::cout << (r > 0 ? "," : "") << reasons[r];
+			std::cout << "\"" << std::endl;
+		}
+
+		const DeviceCandidate* chosen = nullptr;
+		std::string selection = "score";
+
+		if (const std::string request = ReadEnvironment(DEVICE_OVERRIDE_ENV); !request.empty())
+		{
+			const bool byIndex = request.find_first_not_of("0123456789") == std::string::npos;
+			// an index too large to parse names no device, it is reported as unmatched below
+			uint32_t requestedIndex = 0;
+			bool indexParsed = false;
+			if (byIndex)
 			{
-				physicalDevice = device;
+				const char* end = request.data() + request.size();
+				const auto [parsedEnd, error] = std::from_chars(request.data(), end, requestedIndex);
+				indexParsed = error == std::errc() && parsedEnd == end;
+			}
+
+			for (const auto& candidate : candidates)
+			{
+				const bool matches = byIndex
+					                     ? indexParsed && candidate.index == requestedIndex
+					                     : candidate.name.find(request) != std::string::npos;
+				if (!matches)
+					continue;
+
+				if (!candidate.suitable)
+				{
+					std::cout << "device_override_rejected request=\"" << request << "\" index=" << candidate.index
+						<< " reason=unsuitable" << std::endl;
+					continue;
+				}
+
+				chosen = &candidate;
+				selection = std::string(DEVICE_OVERRIDE_ENV);
 				break;
 			}
+
+			if (chosen == nullptr)
+				std::cout << "device_override_unmatched request=\"" << request << "\"" << std::endl;
+		}
+
+		if (chosen == nullptr)
+		{
+			for (const auto& candidate : candidates)
+			{
+				// ties keep enumeration order, which is what the loader sorted by
+				if (candidate.suitable && (chosen == nullptr || candidate.score > chosen->score))
+					chosen = &candidate;
+			}
 		}
 
-		if (physicalDevice == VK_NULL_HANDLE)
+		if (chosen == nullptr)
 			throw std::runtime_error("failed to find a suitable GPU!");
 
-		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-		std::cout << "physical device: " << properties.deviceName << std::endl;
+		physicalDevice = chosen->device;
+		properties = GetPhysicalDeviceInfo(physicalDevice).properties;
+		std::cout << "device_selected index=" << chosen->index << " name=\"" << chosen->name << "\" score="
+			<< chosen->score << " selection=" << selection << std::endl;
+	}
+
+	DeviceCandidate AppDevice::RateDevice(const VkPhysicalDevice device, const uint32_t index) const
+	{
+		const PhysicalDeviceInfo& info = GetPhysicalDeviceInfo(device);
+		const VkPhysicalDeviceProperties& deviceProperties = info.properties;
+
+		DeviceCandidate candidate;
+		candidate.device = device;
+		candidate.index = index;
+		candidate.name = deviceProperties.deviceName;
+		candidate.suitable = IsDeviceSuitable(device);
+
+		auto add = [&candidate](const std::string& reason, const int64_t points)
+		{
+			candidate.score += points;
+			candidate.reasons.push_back(reason + ":" + (points >= 0 ? "+" : "") + std::to_string(points));
+		};
+
+		switch (deviceProperties.deviceType)
+		{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+			add("type=discrete", 1000);
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+			add("type=integrated", 500);
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+			add("type=virtual", 300);
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:
+			add("type=cpu", 100);
+			break;
+		default:
+			add("type=other", 0);
+			break;
+		}
+
+		// 10 points per GiB of the largest device local heap, capped so memory never outweighs the device type
+		const VkPhysicalDeviceMemoryProperties& memoryProperties = info.memoryProperties;
+		VkDeviceSize localHeap = 0;
+		for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++)
+		{
+			if (memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				localHeap = std::max(localHeap, memoryProperties.memoryHeaps[heap].size);
+		}
+		const auto localGiB = static_cast<int64_t>(localHeap >> 30);
+		add("local_heap_gib=" + std::to_string(localGiB), std::min<int64_t>(localGiB * 10, 400));
+
+		add("api=" + std::to_string(VK_API_VERSION_MAJOR(deviceProperties.apiVersion)) + "." +
+		    std::to_string(VK_API_VERSION_MINOR(deviceProperties.apiVersion)),
+		    VK_API_VERSION_MINOR(deviceProperties.apiVersion) * 10);
+
+		if (info.features.multiDrawIndirect)
+			add("feature=multiDrawIndirect", 20);
+		if (info.features.drawIndirectFirstInstance)
+			add("feature=drawIndirectFirstInstance", 10);
+
+		for (const char* optional : optionalDeviceExtensions)
+		{
+			if (info.HasExtension(optional))
+				add(std::string("extension=") + optional, 20);
+		}
+
+		const QueueFamilyIndices& families = info.queueFamilies;
+		if (families.HasDedicatedTransfer())
+			add("queue=dedicated_transfer", 30);
+		if (families.HasDedicatedCompute())
+			add("queue=async_compute", 30);
+		if (families.graphicsFamilyHasValue && families.presentFamilyHasValue &&
+			families.graphicsFamily == families.presentFamily)
+			add("queue=graphics_presents", 10);
+
+		return candidate;
+	}
+
+	bool PhysicalDeviceInfo::HasExtension(const char* name) const
+	{
+		return std::any_of(extensions.begin(), extensions.end(),
+		                   [name](const VkExtensionProperties& extension)
+		                   {
+			                   return strcmp(extension.extensionName, name) == 0;
+		                   });
+	}
+
+	const PhysicalDeviceInfo& AppDevice::GetPhysicalDeviceInfo(const VkPhysicalDevice device) const
+	{
+		if (const auto found = physicalDeviceInfos_.find(device); found != physicalDeviceInfos_.end())
+			return found->second;
+
+		PhysicalDeviceInfo info;
+		vkGetPhysicalDeviceProperties(device, &info.properties);
+		vkGetPhysicalDeviceFeatures(device, &info.features);
+		vkGetPhysicalDeviceMemoryProperties(device, &info.memoryProperties);
+
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+		info.extensions.resize(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, info.extensions.data());
+
+		info.queueFamilies = FindQueueFamilies(device);
+
+		// the features2 queries are core in 1.1, older devices simply go without the library path
+		if (info.properties.apiVersion >= VK_API_VERSION_1_1 &&
+			info.HasExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+			info.HasExtension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME))
+		{
+			VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures{};
+			libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+			VkPhysicalDeviceFeatures2 features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features2.pNext = &libraryFeatures;
+			vkGetPhysicalDeviceFeatures2(device, &features2);
+
+			VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties{};
+			libraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+			VkPhysicalDeviceProperties2 properties2{};
+			properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties2.pNext = &libraryProperties;
+			vkGetPhysicalDeviceProperties2(device, &properties2);
+
+			info.graphicsPipelineLibrary = libraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+			info.graphicsPipelineLibraryFastLinking = libraryProperties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+		}
+
+		return physicalDeviceInfos_.emplace(device, std::move(info)).first->second;
 	}
 
 	void AppDevice::CreateLogicalDevice()
 	{
-		auto [graphicsFamily, presentFamily,
-				graphicsFamilyHasValue, presentFamilyHasValue] =
-			FindQueueFamilies(physicalDevice);
+		const PhysicalDeviceInfo& info = GetPhysicalDeviceInfo(physicalDevice);
+		queueFamilies_ = info.queueFamilies;
+		const auto& [graphicsFamily, presentFamily, transferFamily, computeFamily,
+				graphicsFamilyHasValue, presentFamilyHasValue] = queueFamilies_;
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = {graphicsFamily, presentFamily};
+		std::set<uint32_t> uniqueQueueFamilies = {graphicsFamily, presentFamily, transferFamily, computeFamily};
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -111,6 +352,10 @@ namespace VulkanTest
 
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		// gpu driven drawing, optional
+		deviceFeatures.multiDrawIndirect = info.features.multiDrawIndirect;
+		deviceFeatures.drawIndirectFirstInstance = info.features.drawIndirectFirstInstance;
+		enabledFeatures_ = deviceFeatures;
 
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -118,9 +363,29 @@ namespace VulkanTest
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+		std::vector<const char*> extensions = deviceExtensions;
+		for (const char* optional : optionalDeviceExtensions)
+		{
+			// the library extensions are useless without the feature bit
+			const bool libraryExtension = strcmp(optional, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0 ||
+				strcmp(optional, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) == 0;
+			if (libraryExtension && !info.graphicsPipelineLibrary)
+				continue;
+
+			if (info.HasExtension(optional))
+				extensions.push_back(optional);
+		}
+		enabledExtensions_ = {extensions.begin(), extensions.end()};
+
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures{};
+		libraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+		libraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+		if (info.graphicsPipelineLibrary)
+			createInfo.pNext = &libraryFeatures;
+
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
 
 		// might not really be necessary anymore because device specific validation layers
 		// have been deprecated
@@ -139,44 +404,60 @@ namespace VulkanTest
 
 		vkGetDeviceQueue(device_, graphicsFamily, 0, &graphicsQueue_);
 		vkGetDeviceQueue(device_, presentFamily, 0, &presentQueue_);
+		vkGetDeviceQueue(device_, transferFamily, 0, &transferQueue_);
+		vkGetDeviceQueue(device_, computeFamily, 0, &computeQueue_);
+
+		// the instance targets 1.1, so the count draws only come from the extension
+		if (IsExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+		{
+			cmdDrawIndexedIndirectCount_ = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+				vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+		}
+
+		std::cout << "queue families: graphics " << graphicsFamily << ", present " << presentFamily
+			<< ", transfer " << transferFamily << (queueFamilies_.HasDedicatedTransfer() ? " (dedicated)" : "")
+			<< ", compute " << computeFamily << (queueFamilies_.HasDedicatedCompute() ? " (async)" : "")
+			<< std::endl;
 	}
 
 	void AppDevice::CreateCommandPool()
 	{
-		const auto [graphicsFamily, presentFamily,
-				graphicsFamilyHasValue, presentFamilyHasValue] =
-			findPhysicalQueueFamilies();
-
 		VkCommandPoolCreateInfo poolInfo = {};
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.queueFamilyIndex = graphicsFamily;
+		poolInfo.queueFamilyIndex = queueFamilies_.graphicsFamily;
 		poolInfo.flags =
 			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 		if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
 			throw std::runtime_error("failed to create command pool!");
+
+		poolInfo.queueFamilyIndex = queueFamilies_.computeFamily;
+		if (vkCreateCommandPool(device_, &poolInfo, nullptr, &computeCommandPool_) != VK_SUCCESS)
+			throw std::runtime_error("failed to create compute command pool!");
 	}
 
-	void AppDevice::CreateSurface() { window.CreateWindowSurface(instance, &surface_); }
+	void AppDevice::CreateSurface()
+	{
+		surface_ = VK_NULL_HANDLE;
+		if (!IsHeadless())
+			window->CreateWindowSurface(instance, &surface_);
+	}
 
 	bool AppDevice::IsDeviceSuitable(VkPhysicalDevice device) const
 	{
-		QueueFamilyIndices indices = FindQueueFamilies(device);
+		const PhysicalDeviceInfo& info = GetPhysicalDeviceInfo(device);
 
 		bool extensionsSupported = CheckDeviceExtensionSupport(device);
 
-		bool swapChainAdequate = false;
-		if (extensionsSupported)
+		bool swapChainAdequate = IsHeadless();
+		if (extensionsSupported && !IsHeadless())
 		{
 			SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
 			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 		}
 
-		VkPhysicalDeviceFeatures supportedFeatures;
-		vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-
-		return indices.IsComplete() && extensionsSupported && swapChainAdequate &&
-			supportedFeatures.samplerAnisotropy;
+		return info.queueFamilies.IsComplete() && extensionsSupported && swapChainAdequate &&
+			info.features.samplerAnisotropy;
 	}
 
 	bool AppDevice::CheckValidationLayerSupport() const
@@ -229,46 +510,27 @@ namespace VulkanTest
 		std::vector<VkExtensionProperties> extensions(extensionCount);
 		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
 
-		std::cout << "available extensions:" << std::endl;
 		std::unordered_set<std::string> available;
-
 		for (const auto& [extensionName, specVersion] : extensions)
-		{
-			std::cout << "\t" << extensionName << std::endl;
 			available.insert(extensionName);
-		}
 
-		std::cout << "required extensions:" << std::endl;
-		const auto requiredExtensions = GetRequiredExtensions();
-
-		for (const auto& required : requiredExtensions)
+		// only what is missing is worth printing, the full list costs more than the check itself
+		for (const auto& required : GetRequiredExtensions())
 		{
-			std::cout << "\t" << required << std::endl;
 			if (available.find(required) == available.end())
+			{
+				std::cerr << "missing instance extension: " << required << std::endl;
 				throw std::runtime_error("Missing required glfw extension");
+			}
 		}
 	}
 
 	bool AppDevice::CheckDeviceExtensionSupport(const VkPhysicalDevice device) const
 	{
-		uint32_t extensionCount;
-		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-
-		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-		vkEnumerateDeviceExtensionProperties(
-			device,
-			nullptr,
-			&extensionCount,
-			availableExtensions.data());
-
-		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+		const PhysicalDeviceInfo& info = GetPhysicalDeviceInfo(device);
 
-		for (const auto& [extensionName, specVersion] : availableExtensions)
-		{
-			requiredExtensions.erase(extensionName);
-		}
-
-		return requiredExtensions.empty();
+		return std::all_of(deviceExtensions.begin(), deviceExtensions.end(),
+		                   [&info](const char* required) { return info.HasExtension(required); });
 	}
 
 	QueueFamilyIndices AppDevice::FindQueueFamilies(const VkPhysicalDevice device) const
@@ -285,27 +547,66 @@ namespace VulkanTest
 		for (const auto& [queueFlags, queueCount,
 			     timestampValidBits, minImageTransferGranularity] : queueFamilies)
 		{
-			if (queueCount > 0 && queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			if (queueCount > 0 && queueFlags & VK_QUEUE_GRAPHICS_BIT && !indices.graphicsFamilyHasValue)
 			{
 				indices.graphicsFamily = i;
 				indices.graphicsFamilyHasValue = true;
 			}
 
+			// headless never presents, graphics stands in so the rest of the code needs no special case
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+			if (surface_ != VK_NULL_HANDLE)
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+			else
+				presentSupport = queueFlags & VK_QUEUE_GRAPHICS_BIT ? VK_TRUE : VK_FALSE;
 
-			if (queueCount > 0 && presentSupport)
+			if (queueCount > 0 && presentSupport && !indices.presentFamilyHasValue)
 			{
 				indices.presentFamily = i;
 				indices.presentFamilyHasValue = true;
 			}
 
-			if (indices.IsComplete())
-				break;
-
 			i++;
 		}
 
+		if (!indices.graphicsFamilyHasValue)
+			return indices;
+
+		// transfer: a DMA-only family first, then any non graphics family, since every compute queue can copy
+		// compute: a family without graphics so dispatches can overlap the frame
+		indices.transferFamily = indices.graphicsFamily;
+		indices.computeFamily = indices.graphicsFamily;
+		bool transferOnly = false;
+
+		for (uint32_t family = 0; family < queueFamilyCount; family++)
+		{
+			const auto& [queueFlags, queueCount, timestampValidBits, minImageTransferGranularity] =
+				queueFamilies[family];
+
+			if (queueCount == 0 || queueFlags & VK_QUEUE_GRAPHICS_BIT)
+				continue;
+
+			// the upload queue only copies whole mips, so any minImageTransferGranularity is fine
+			const bool compute = queueFlags & VK_QUEUE_COMPUTE_BIT;
+			const bool transfer = compute || queueFlags & VK_QUEUE_TRANSFER_BIT;
+
+			if (compute && !indices.HasDedicatedCompute())
+				indices.computeFamily = family;
+
+			if (transfer && !transferOnly)
+			{
+				if (!compute)
+				{
+					indices.transferFamily = family;
+					transferOnly = true;
+				}
+				else if (!indices.HasDedicatedTransfer())
+				{
+					indices.transferFamily = family;
+				}
+			}
+		}
+
 		return indices;
 	}
 
@@ -356,23 +657,17 @@ namespace VulkanTest
 
 	uint32_t AppDevice::FindMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties) const
 	{
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-		{
-			if ((typeFilter & (1 << i)) &&
-				(memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-				return i;
-		}
+		const auto memoryTypes = memoryBudget_->FindMemoryTypes(typeFilter, properties);
+		if (memoryTypes.empty())
+			throw std::runtime_error("failed to find suitable memory type!");
 
-		throw std::runtime_error("failed to find suitable memory type!");
+		return memoryTypes.front();
 	}
 
 	void AppDevice::CreateBuffer(
 		const VkDeviceSize size, const VkBufferUsageFlags usage,
 		const VkMemoryPropertyFlags properties, VkBuffer& buffer,
-		VkDeviceMemory& bufferMemory) const
+		MemoryAllocation& bufferMemory) const
 	{
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -386,23 +681,70 @@ namespace VulkanTest
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+		bufferMemory = allocator_->Allocate(memRequirements, properties, false);
 
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
+		if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS)
+			throw std::runtime_error("failed to bind vertex buffer memory!");
+	}
 
-		vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+	void AppDevice::CreateBuffer(
+		const VkDeviceSize size, const VkBufferUsageFlags usage,
+		const MemoryUsage memoryUsage, VkBuffer& buffer,
+		MemoryAllocation& bufferMemory) const
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to create buffer!");
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
+
+		bufferMemory = allocator_->Allocate(memRequirements, memoryUsage, false);
+
+		if (vkBindBufferMemory(device_, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS)
+			throw std::runtime_error("failed to bind buffer memory!");
+	}
+
+	void AppDevice::DestroyBuffer(const VkBuffer buffer, MemoryAllocation& bufferMemory) const
+	{
+		// null while the upload queue itself is torn down
+		if (uploadQueue_)
+			uploadQueue_->ForgetBuffer(buffer);
+		vkDestroyBuffer(device_, buffer, nullptr);
+		allocator_->Free(bufferMemory);
 	}
 
 	VkCommandBuffer AppDevice::BeginSingleTimeCommands() const
+	{
+		return BeginOneTimeCommands(commandPool);
+	}
+
+	void AppDevice::EndSingleTimeCommands(const VkCommandBuffer commandBuffer) const
+	{
+		EndOneTimeCommands(commandBuffer, commandPool, graphicsQueue_);
+	}
+
+	VkCommandBuffer AppDevice::BeginComputeCommands() const
+	{
+		return BeginOneTimeCommands(computeCommandPool_);
+	}
+
+	void AppDevice::EndComputeCommands(const VkCommandBuffer commandBuffer) const
+	{
+		EndOneTimeCommands(commandBuffer, computeCommandPool_, computeQueue_);
+	}
+
+	VkCommandBuffer AppDevice::BeginOneTimeCommands(const VkCommandPool pool) const
 	{
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = commandPool;
+		allocInfo.commandPool = pool;
 		allocInfo.commandBufferCount = 1;
 
 		VkCommandBuffer commandBuffer;
@@ -416,7 +758,8 @@ namespace VulkanTest
 		return commandBuffer;
 	}
 
-	void AppDevice::EndSingleTimeCommands(const VkCommandBuffer commandBuffer) const
+	void AppDevice::EndOneTimeCommands(const VkCommandBuffer commandBuffer, const VkCommandPool pool,
+	                                   const VkQueue queue) const
 	{
 		vkEndCommandBuffer(commandBuffer);
 
@@ -425,53 +768,35 @@ namespace VulkanTest
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue_);
+		// wait on this submission only, not on everything else queued
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence fence;
+		if (vkCreateFence(device_, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+			throw std::runtime_error("failed to create single time command fence!");
+
+		vkQueueSubmit(queue, 1, &submitInfo, fence);
+		vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
 
-		vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+		vkDestroyFence(device_, fence, nullptr);
+		vkFreeCommandBuffers(device_, pool, 1, &commandBuffer);
 	}
 
-	void AppDevice::CopyBuffer(const VkBuffer srcBuffer, const VkBuffer dstBuffer, const VkDeviceSize size) const
+	UploadToken AppDevice::CopyBuffer(const VkBuffer srcBuffer, const VkBuffer dstBuffer,
+	                                  const VkDeviceSize size) const
 	{
-		const VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-		VkBufferCopy copyRegion{};
-		copyRegion.srcOffset = 0; // Optional
-		copyRegion.dstOffset = 0; // Optional
-		copyRegion.size = size;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-		EndSingleTimeCommands(commandBuffer);
+		return uploadQueue_->CopyBuffer(srcBuffer, dstBuffer, size);
 	}
 
-	void AppDevice::CopyBufferToImage(
+	UploadToken AppDevice::CopyBufferToImage(
 		const VkBuffer buffer, const VkImage image, const uint32_t width,
 		const uint32_t height, const uint32_t layerCount) const
 	{
-		const VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = layerCount;
-
-		region.imageOffset = {0, 0, 0};
-		region.imageExtent = {width, height, 1};
-
-		vkCmdCopyBufferToImage(commandBuffer, buffer, image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,1,
-			&region);
-
-		EndSingleTimeCommands(commandBuffer);
+		return uploadQueue_->CopyBufferToImage(buffer, image, width, height, layerCount);
 	}
 
 	void AppDevice::CreateImageWithInfo(const VkImageCreateInfo& imageInfo,
-		const VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) const
+		const VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory) const
 	{
 		if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS)
 			throw std::runtime_error("failed to create image!");
@@ -479,15 +804,20 @@ namespace VulkanTest
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+		// render targets are recreated with the window and are big, they get memory of their own
+		const bool dedicated = (imageInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
 
-		if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-			throw std::runtime_error("failed to allocate image memory!");
+		imageMemory = allocator_->Allocate(
+			memRequirements, properties, imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL, dedicated);
 
-		if (vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS)
+		if (vkBindImageMemory(device_, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS)
 			throw std::runtime_error("failed to bind image memory!");
 	}
-} 
+
+	void AppDevice::DestroyImage(const VkImage image, MemoryAllocation& imageMemory) const
+	{
+		vkDestroyImage(device_, image, nullptr);
+		allocator_->Free(imageMemory);
+	}
+}
\ No newline at end of file
@@ -1,7 +1,14 @@
 #pragma once
 
 #include "MainWindow.hpp"
-
+#include "app_memory_allocator.hpp"
+#include "app_pipeline_cache.hpp"
+#include "app_upload_queue.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -18,9 +25,40 @@ namespace VulkanTest
 	{
 		uint32_t graphicsFamily{};
 		uint32_t presentFamily{};
+		// fall back to graphicsFamily when the device has no separate family for the job
+		uint32_t transferFamily{};
+		uint32_t computeFamily{};
 		bool graphicsFamilyHasValue = false;
 		bool presentFamilyHasValue = false;
 		bool IsComplete() const { return graphicsFamilyHasValue && presentFamilyHasValue; }
+		bool HasDedicatedTransfer() const { return transferFamily != graphicsFamily; }
+		bool HasDedicatedCompute() const { return computeFamily != graphicsFamily; }
+	};
+
+	// Everything device selection looks at, enumerated once per physical device
+	struct PhysicalDeviceInfo
+	{
+		VkPhysicalDeviceProperties properties{};
+		VkPhysicalDeviceFeatures features{};
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		std::vector<VkExtensionProperties> extensions;
+		QueueFamilyIndices queueFamilies;
+		// VK_EXT_graphics_pipeline_library present and its feature bit set
+		bool graphicsPipelineLibrary = false;
+		bool graphicsPipelineLibraryFastLinking = false;
+
+		[[nodiscard]] bool HasExtension(const char* name) const;
+	};
+
+	// One physical device as seen by PickPhysicalDevice, reasons lists every score contribution
+	struct DeviceCandidate
+	{
+		VkPhysicalDevice device = VK_NULL_HANDLE;
+		uint32_t index = 0;
+		std::string name;
+		bool suitable = false;
+		int64_t score = 0;
+		std::vector<std::string> reasons;
 	};
 
 	class AppDevice
@@ -33,6 +71,8 @@ namespace VulkanTest
 #endif
 
 		explicit AppDevice(MainWindow& window);
+		// headless: no surface and no VK_KHR_swapchain, for offscreen rendering on machines without a display
+		AppDevice();
 		~AppDevice();
 
 
@@ -43,10 +83,17 @@ namespace VulkanTest
 		AppDevice& operator=(AppDevice&&) = delete;
 
 		[[nodiscard]] VkCommandPool GetCommandPool() const { return commandPool; }
+		// for command buffers submitted to ComputeQueue()
+		[[nodiscard]] VkCommandPool GetComputeCommandPool() const { return computeCommandPool_; }
 		[[nodiscard]] VkDevice Device() const { return device_; }
 		[[nodiscard]] VkSurfaceKHR Surface() const { return surface_; }
+		[[nodiscard]] bool IsHeadless() const { return window == nullptr; }
 		[[nodiscard]] VkQueue GraphicsQueue() const { return graphicsQueue_; }
 		[[nodiscard]] VkQueue PresentQueue() const { return presentQueue_; }
+		// same handle as GraphicsQueue() when the device has no dedicated family
+		[[nodiscard]] VkQueue TransferQueue() const { return transferQueue_; }
+		[[nodiscard]] VkQueue ComputeQueue() const { return computeQueue_; }
+		[[nodiscard]] const QueueFamilyIndices& QueueFamilies() const { return queueFamilies_; }
 
 		// ADDED
 		VkInstance GetInstance() { return instance; }
@@ -55,40 +102,97 @@ namespace VulkanTest
 
 		SwapChainSupportDetails getSwapChainSupport() { return QuerySwapChainSupport(physicalDevice); }
 		uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
-		QueueFamilyIndices findPhysicalQueueFamilies() { return FindQueueFamilies(physicalDevice); }
+		QueueFamilyIndices findPhysicalQueueFamilies() const { return queueFamilies_; }
 		VkFormat FindSupportedFormat(
 			const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) const;
 
 		// Buffer Helper Functions
+		// memory comes out of the shared allocator, so it must go back through DestroyBuffer
 		void CreateBuffer(
 			VkDeviceSize size,
 			VkBufferUsageFlags usage,
 			VkMemoryPropertyFlags properties,
 			VkBuffer& buffer,
-			VkDeviceMemory& bufferMemory) const;
+			MemoryAllocation& bufferMemory) const;
+		// placement by intent, lets UMA and ReBAR devices skip the staging copy for Upload buffers
+		void CreateBuffer(
+			VkDeviceSize size,
+			VkBufferUsageFlags usage,
+			MemoryUsage memoryUsage,
+			VkBuffer& buffer,
+			MemoryAllocation& bufferMemory) const;
+		void DestroyBuffer(VkBuffer buffer, MemoryAllocation& bufferMemory) const;
 		VkCommandBuffer BeginSingleTimeCommands() const;
 		void EndSingleTimeCommands(VkCommandBuffer commandBuffer) const;
-		void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) const;
-		void CopyBufferToImage(
+		// same on the compute queue, which runs alongside graphics when the device has a separate family.
+		// exclusive resources used by graphics afterwards then need a queue family ownership transfer
+		VkCommandBuffer BeginComputeCommands() const;
+		void EndComputeCommands(VkCommandBuffer commandBuffer) const;
+		// batched on the upload queue, wait on the token before reading dst on the cpu or on another queue
+		UploadToken CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) const;
+		UploadToken CopyBufferToImage(
 			VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) const;
 
 		void CreateImageWithInfo(
 			const VkImageCreateInfo& imageInfo,
 			VkMemoryPropertyFlags properties,
 			VkImage& image,
-			VkDeviceMemory& imageMemory) const;
+			MemoryAllocation& imageMemory) const;
+		void DestroyImage(VkImage image, MemoryAllocation& imageMemory) const;
+
+		[[nodiscard]] AppMemoryAllocator& Allocator() const { return *allocator_; }
+		[[nodiscard]] AppMemoryBudget& MemoryBudget() const { return *memoryBudget_; }
+		[[nodiscard]] AppUploadQueue& UploadQueue() const { return *uploadQueue_; }
+		// pass to every vkCreate*Pipelines call, saved to disk when the device goes away
+		[[nodiscard]] AppPipelineCache& PipelineCache() const { return *pipelineCache_; }
+
+		// pipelines can be split into separately compiled libraries and linked, see AppPipelineLibrary
+		[[nodiscard]] bool SupportsGraphicsPipelineLibrary() const
+		{
+			return IsExtensionEnabled(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		}
+
+		// linking libraries is cheap enough to do while recording a frame
+		[[nodiscard]] bool HasFastLinking() const
+		{
+			return SupportsGraphicsPipelineLibrary() &&
+				GetPhysicalDeviceInfo(physicalDevice).graphicsPipelineLibraryFastLinking;
+		}
+
+		// many draws from one indirect buffer in one call, without it every indirect draw is its own call
+		[[nodiscard]] bool SupportsMultiDrawIndirect() const { return enabledFeatures_.multiDrawIndirect == VK_TRUE; }
+		[[nodiscard]] bool SupportsDrawIndirectFirstInstance() const
+		{
+			return enabledFeatures_.drawIndirectFirstInstance == VK_TRUE;
+		}
+		// vkCmdDrawIndexedIndirectCountKHR, null without VK_KHR_draw_indirect_count
+		[[nodiscard]] PFN_vkCmdDrawIndexedIndirectCountKHR CmdDrawIndexedIndirectCount() const
+		{
+			return cmdDrawIndexedIndirectCount_;
+		}
+
+		// optional device extensions are only enabled when the physical device has them
+		[[nodiscard]] bool IsExtensionEnabled(const std::string& name) const
+		{
+			return enabledExtensions_.count(name) > 0;
+		}
 
 		VkPhysicalDeviceProperties properties;
 
 	private:
+		void Initialize();
 		void CreateInstance();
 		void CreateSurface();
 		void PickPhysicalDevice();
 		void CreateLogicalDevice();
 		void CreateCommandPool();
+		VkCommandBuffer BeginOneTimeCommands(VkCommandPool pool) const;
+		void EndOneTimeCommands(VkCommandBuffer commandBuffer, VkCommandPool pool, VkQueue queue) const;
 
 		// helper functions
 		bool IsDeviceSuitable(VkPhysicalDevice device) const;
+		DeviceCandidate RateDevice(VkPhysicalDevice device, uint32_t index) const;
+		const PhysicalDeviceInfo& GetPhysicalDeviceInfo(VkPhysicalDevice device) const;
 		std::vector<const char*> GetRequiredExtensions() const;
 		bool CheckValidationLayerSupport() const;
 		QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device) const;
@@ -99,15 +203,38 @@ namespace VulkanTest
 		VkInstance instance;
 		VkDebugUtilsMessengerEXT debugMessenger;
 		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-		MainWindow& window;
+		MainWindow* window;
 		VkCommandPool commandPool;
+		VkCommandPool computeCommandPool_ = VK_NULL_HANDLE;
 
 		VkDevice device_;
 		VkSurfaceKHR surface_;
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
+		VkQueue transferQueue_;
+		VkQueue computeQueue_;
+		QueueFamilyIndices queueFamilies_;
+
+		std::unique_ptr<AppMemoryBudget> memoryBudget_;
+		std::unique_ptr<AppMemoryAllocator> allocator_;
+		std::unique_ptr<AppUploadQueue> uploadQueue_;
+		std::unique_ptr<AppPipelineCache> pipelineCache_;
+
+		// name substring or enumeration index of the device to use instead of the best scored one
+		static constexpr const char* DEVICE_OVERRIDE_ENV = "VULKANTEST_DEVICE";
 
 		const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-		const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+		// VK_KHR_swapchain unless headless
+		std::vector<const char*> deviceExtensions;
+		const std::vector<const char*> optionalDeviceExtensions = {
+			VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+			VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+			VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME,
+			VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
+		};
+		std::unordered_set<std::string> enabledExtensions_;
+		VkPhysicalDeviceFeatures enabledFeatures_{};
+		PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount_ = nullptr;
+		mutable std::unordered_map<VkPhysicalDevice, PhysicalDeviceInfo> physicalDeviceInfos_;
 	};
 } 
\ No newline at end of file
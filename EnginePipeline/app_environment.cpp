@@ -0,0 +1,23 @@
+#include "app_environment.hpp"
+
+#include <cstdlib>
+
+namespace VulkanTest
+{
+	std::string ReadEnvironment(const char* name)
+	{
+#if defined(_MSC_VER)
+		char* value = nullptr;
+		size_t length = 0;
+		if (_dupenv_s(&value, &length, name) != 0 || value == nullptr)
+			return {};
+
+		std::string result = value;
+		free(value);
+		return result;
+#else
+		const char* value = std::getenv(name);
+		return value != nullptr ? value : std::string{};
+#endif
+	}
+}
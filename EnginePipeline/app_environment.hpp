@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+namespace VulkanTest
+{
+	// the variable's value, empty if it is unset. msvc's getenv is deprecated as unsafe, so this is the one
+	// place that reads the environment
+	std::string ReadEnvironment(const char* name);
+}
@@ -0,0 +1,190 @@
+#include "app_frame_recorder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	AppFrameRecorder::AppFrameRecorder(AppDevice& device, AppJobPool& jobPool, const uint32_t framesInFlight)
+		: _device{device}, _jobPool{jobPool}, _threadSlots{static_cast<size_t>(jobPool.ThreadCount()) + 1}
+	{
+		_frames.resize(framesInFlight);
+		for (auto& frame : _frames)
+		{
+			frame.primaryPool = CreatePool();
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = frame.primaryPool;
+			allocInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(_device.Device(), &allocInfo, &frame.primary) != VK_SUCCESS)
+				throw std::runtime_error("failed to allocate primary command buffer!");
+
+			frame.threads.resize(_threadSlots);
+			for (auto& thread : frame.threads)
+				thread.pool = CreatePool();
+		}
+	}
+
+	AppFrameRecorder::~AppFrameRecorder()
+	{
+		// destroying a pool frees everything allocated from it
+		for (const auto& frame : _frames)
+		{
+			for (const auto& thread : frame.threads)
+				vkDestroyCommandPool(_device.Device(), thread.pool, nullptr);
+			vkDestroyCommandPool(_device.Device(), frame.primaryPool, nullptr);
+		}
+	}
+
+	VkCommandBuffer AppFrameRecorder::BeginFrame(const uint32_t frame)
+	{
+		_current = &_frames.at(frame);
+
+		// one reset per pool instead of one per command buffer
+		vkResetCommandPool(_device.Device(), _current->primaryPool, 0);
+		for (auto& thread : _current->threads)
+		{
+			vkResetCommandPool(_device.Device(), thread.pool, 0);
+			thread.used = 0;
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(_current->primary, &beginInfo) != VK_SUCCESS)
+			throw std::runtime_error("failed to begin recording command buffer!");
+
+		_recordedFrames++;
+		return _current->primary;
+	}
+
+	void AppFrameRecorder::RecordDraws(const VkRenderPass renderPass, const uint32_t subpass,
+	                                   const VkFramebuffer framebuffer, const size_t drawCount,
+	                                   const RecordFunction& record)
+	{
+		if (_current == nullptr)
+			throw std::runtime_error("draws recorded outside of a frame!");
+
+		// an empty pass still needs one secondary, a render pass begun for secondaries may not record inline
+		const size_t ranges = std::clamp<size_t>((drawCount + MIN_DRAWS_PER_SECONDARY - 1) / MIN_DRAWS_PER_SECONDARY,
+		                                         1, _threadSlots);
+		std::vector<VkCommandBuffer> secondaries(ranges, VK_NULL_HANDLE);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = subpass;
+		inheritanceInfo.framebuffer = framebuffer;
+
+		FrameSlot& frame = *_current;
+		// range i always records with thread pool i, so no pool is touched by two threads at once
+		_jobPool.ParallelFor(ranges, 1, [&](const size_t first, const size_t last)
+		{
+			for (size_t range = first; range < last; range++)
+			{
+				const VkCommandBuffer secondary = NextSecondary(frame.threads[range]);
+				BeginSecondary(secondary, inheritanceInfo);
+
+				record(secondary, drawCount * range / ranges, drawCount * (range + 1) / ranges);
+
+				if (vkEndCommandBuffer(secondary) != VK_SUCCESS)
+					throw std::runtime_error("failed to record secondary command buffer!");
+				secondaries[range] = secondary;
+			}
+		});
+
+		vkCmdExecuteCommands(frame.primary, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+		_secondaries += ranges;
+		_draws += drawCount;
+	}
+
+	void AppFrameRecorder::RecordSecondary(const VkRenderPass renderPass, const uint32_t subpass,
+	                                       const VkFramebuffer framebuffer,
+	                                       const std::function<void(VkCommandBuffer commandBuffer)>& record)
+	{
+		if (_current == nullptr)
+			throw std::runtime_error("secondary recorded outside of a frame!");
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = subpass;
+		inheritanceInfo.framebuffer = framebuffer;
+
+		// the first thread pool is free here, no RecordDraws runs at the same time
+		const VkCommandBuffer secondary = NextSecondary(_current->threads[0]);
+		BeginSecondary(secondary, inheritanceInfo);
+		record(secondary);
+		if (vkEndCommandBuffer(secondary) != VK_SUCCESS)
+			throw std::runtime_error("failed to record secondary command buffer!");
+
+		vkCmdExecuteCommands(_current->primary, 1, &secondary);
+		_secondaries++;
+	}
+
+	VkCommandBuffer AppFrameRecorder::EndFrame()
+	{
+		if (_current == nullptr)
+			throw std::runtime_error("no frame is being recorded!");
+
+		const VkCommandBuffer primary = _current->primary;
+		_current = nullptr;
+		if (vkEndCommandBuffer(primary) != VK_SUCCESS)
+			throw std::runtime_error("failed to record command buffer!");
+		return primary;
+	}
+
+	void AppFrameRecorder::PrintStats(std::ostream& out) const
+	{
+		const uint64_t frames = _recordedFrames;
+		out << "frame_recorder thread_slots=" << _threadSlots << " frames=" << frames
+			<< " secondaries_per_frame=" << (frames > 0 ? static_cast<double>(_secondaries) / frames : 0.0)
+			<< " draws_per_frame=" << (frames > 0 ? static_cast<double>(_draws) / frames : 0.0) << std::endl;
+	}
+
+	VkCommandPool AppFrameRecorder::CreatePool() const
+	{
+		// transient and without RESET_COMMAND_BUFFER, buffers only ever go back through the pool reset
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = _device.QueueFamilies().graphicsFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		VkCommandPool pool;
+		if (vkCreateCommandPool(_device.Device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create frame command pool!");
+		return pool;
+	}
+
+	void AppFrameRecorder::BeginSecondary(const VkCommandBuffer secondary,
+	                                      const VkCommandBufferInheritanceInfo& inheritanceInfo)
+	{
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS)
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+	}
+
+	VkCommandBuffer AppFrameRecorder::NextSecondary(ThreadPool& threadPool) const
+	{
+		if (threadPool.used == threadPool.secondaries.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandPool = threadPool.pool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer secondary;
+			if (vkAllocateCommandBuffers(_device.Device(), &allocInfo, &secondary) != VK_SUCCESS)
+				throw std::runtime_error("failed to allocate secondary command buffer!");
+			threadPool.secondaries.push_back(secondary);
+		}
+
+		return threadPool.secondaries[threadPool.used++];
+	}
+}
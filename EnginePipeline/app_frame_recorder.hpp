@@ -0,0 +1,80 @@
+#pragma once
+
+#include "app_device.hpp"
+#include "app_job_pool.hpp"
+
+#include <atomic>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Records a frame's command buffers from several threads. Every frame in flight has its own primary
+	// pool and one pool per recording thread, all reset in bulk when the frame slot comes around again,
+	// so no command buffer is ever reset or freed on its own. Draws are split into ranges, each range is
+	// recorded into a secondary command buffer on the job pool and the primary executes them in order.
+	class AppFrameRecorder
+	{
+	public:
+		// records draws [begin, end) into a secondary that continues the current render pass. dynamic
+		// state is not inherited, the function sets viewport and scissor itself
+		using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, size_t begin, size_t end)>;
+
+		// ranges smaller than this are not worth a secondary and a trip through the job pool
+		static constexpr size_t MIN_DRAWS_PER_SECONDARY = 64;
+
+		AppFrameRecorder(AppDevice& device, AppJobPool& jobPool, uint32_t framesInFlight);
+		~AppFrameRecorder();
+
+		AppFrameRecorder(const AppFrameRecorder&) = delete;
+		AppFrameRecorder& operator=(const AppFrameRecorder&) = delete;
+
+		// resets the slot's pools and begins its primary, the slot's fence must have been waited on
+		VkCommandBuffer BeginFrame(uint32_t frame);
+		// between vkCmdBeginRenderPass with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS and the matching end.
+		// may be called once per subpass
+		void RecordDraws(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, size_t drawCount,
+		                 const RecordFunction& record);
+		// one secondary recorded on the calling thread, for work that is not a list of draws to split
+		void RecordSecondary(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer,
+		                     const std::function<void(VkCommandBuffer commandBuffer)>& record);
+		// ends the primary and returns it for submission
+		VkCommandBuffer EndFrame();
+
+		// one pool per recording thread, the job pool workers plus the calling thread
+		[[nodiscard]] size_t ThreadSlots() const { return _threadSlots; }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		struct ThreadPool
+		{
+			VkCommandPool pool = VK_NULL_HANDLE;
+			// allocated on demand, reused after every bulk reset
+			std::vector<VkCommandBuffer> secondaries;
+			size_t used = 0;
+		};
+
+		struct FrameSlot
+		{
+			VkCommandPool primaryPool = VK_NULL_HANDLE;
+			VkCommandBuffer primary = VK_NULL_HANDLE;
+			std::vector<ThreadPool> threads;
+		};
+
+		VkCommandPool CreatePool() const;
+		static void BeginSecondary(VkCommandBuffer secondary, const VkCommandBufferInheritanceInfo& inheritanceInfo);
+		// only ever called by the one range that owns this thread pool
+		VkCommandBuffer NextSecondary(ThreadPool& threadPool) const;
+
+		AppDevice& _device;
+		AppJobPool& _jobPool;
+		const size_t _threadSlots;
+		std::vector<FrameSlot> _frames;
+		FrameSlot* _current = nullptr;
+
+		std::atomic<uint64_t> _recordedFrames{0};
+		std::atomic<uint64_t> _secondaries{0};
+		std::atomic<uint64_t> _draws{0};
+	};
+}
@@ -0,0 +1,66 @@
+#include "app_frustum.hpp"
+
+#include <cmath>
+
+namespace VulkanTest
+{
+	Frustum Frustum::FromViewProjection(const std::array<float, 16>& viewProjection)
+	{
+		// rows of the matrix, gribb and hartmann
+		const auto row = [&viewProjection](const int r)
+		{
+			return std::array<float, 4>{
+				viewProjection[r], viewProjection[4 + r], viewProjection[8 + r], viewProjection[12 + r]
+			};
+		};
+		const std::array<float, 4> x = row(0);
+		const std::array<float, 4> y = row(1);
+		const std::array<float, 4> z = row(2);
+		const std::array<float, 4> w = row(3);
+
+		Frustum frustum;
+		for (int i = 0; i < 4; i++)
+		{
+			frustum.planes[PLANE_LEFT][i] = w[i] + x[i];
+			frustum.planes[PLANE_RIGHT][i] = w[i] - x[i];
+			frustum.planes[PLANE_BOTTOM][i] = w[i] + y[i];
+			frustum.planes[PLANE_TOP][i] = w[i] - y[i];
+			frustum.planes[PLANE_NEAR][i] = z[i];
+			frustum.planes[PLANE_FAR][i] = w[i] - z[i];
+		}
+
+		// unit normals, so the distance compares against a radius
+		for (auto& plane : frustum.planes)
+		{
+			const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			if (length > 0.0f)
+			{
+				for (float& component : plane)
+					component /= length;
+			}
+		}
+		return frustum;
+	}
+
+	Frustum Frustum::FromBox(const std::array<float, 3>& min, const std::array<float, 3>& max)
+	{
+		Frustum frustum;
+		frustum.planes[PLANE_LEFT] = {1.0f, 0.0f, 0.0f, -min[0]};
+		frustum.planes[PLANE_RIGHT] = {-1.0f, 0.0f, 0.0f, max[0]};
+		frustum.planes[PLANE_BOTTOM] = {0.0f, 1.0f, 0.0f, -min[1]};
+		frustum.planes[PLANE_TOP] = {0.0f, -1.0f, 0.0f, max[1]};
+		frustum.planes[PLANE_NEAR] = {0.0f, 0.0f, 1.0f, -min[2]};
+		frustum.planes[PLANE_FAR] = {0.0f, 0.0f, -1.0f, max[2]};
+		return frustum;
+	}
+
+	bool Frustum::IntersectsSphere(const std::array<float, 3>& center, const float radius) const
+	{
+		for (const auto& plane : planes)
+		{
+			if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius)
+				return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <array>
+
+namespace VulkanTest
+{
+	// Six planes, normals pointing inwards: a point p is inside when dot(n, p) + d >= 0 for all of them.
+	// Laid out as vec4 so the array goes into a push constant or uniform block as is.
+	struct Frustum
+	{
+		// prefixed, NEAR and FAR are macros in the windows headers
+		enum Plane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+		std::array<std::array<float, 4>, PLANE_COUNT> planes{};
+
+		// column major view projection with vulkan's [0, 1] depth range, planes are normalized
+		static Frustum FromViewProjection(const std::array<float, 16>& viewProjection);
+		// the axis aligned box [min, max], e.g. clip space when objects are already in it
+		static Frustum FromBox(const std::array<float, 3>& min, const std::array<float, 3>& max);
+
+		// conservative, spheres near a corner may pass although they are outside
+		[[nodiscard]] bool IntersectsSphere(const std::array<float, 3>& center, float radius) const;
+	};
+}
@@ -0,0 +1,251 @@
+#include "app_gpu_culling.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		// push constant block of cull.comp
+		struct CullConstants
+		{
+			std::array<std::array<float, 4>, Frustum::PLANE_COUNT> planes;
+			uint32_t objectCount;
+		};
+
+		constexpr VkDeviceSize DRAW_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+	}
+
+	const char* AppGpuCulling::DrawPathName(const DrawPath path)
+	{
+		switch (path)
+		{
+		case DrawPath::IndirectCount:
+			return "indirect_count";
+		case DrawPath::MultiDrawIndirect:
+			return "multi_draw_indirect";
+		case DrawPath::SingleDrawIndirect:
+			return "single_draw_indirect";
+		}
+		return "unknown";
+	}
+
+	AppGpuCulling::DrawPath AppGpuCulling::ChooseDrawPath(const AppDevice& device)
+	{
+		if (device.CmdDrawIndexedIndirectCount() != nullptr)
+			return DrawPath::IndirectCount;
+		if (device.SupportsMultiDrawIndirect())
+			return DrawPath::MultiDrawIndirect;
+		return DrawPath::SingleDrawIndirect;
+	}
+
+	void AppGpuCulling::RecordIndirectDraws(const AppDevice& device, const DrawPath path,
+	                                        const VkCommandBuffer commandBuffer, const VkBuffer drawBuffer,
+	                                        const VkBuffer countBuffer, const uint32_t maxDraws)
+	{
+		switch (path)
+		{
+		case DrawPath::IndirectCount:
+			device.CmdDrawIndexedIndirectCount()(commandBuffer, drawBuffer, 0, countBuffer, 0, maxDraws,
+			                                     static_cast<uint32_t>(DRAW_STRIDE));
+			break;
+
+		case DrawPath::MultiDrawIndirect:
+		{
+			const uint32_t limit = std::max(device.properties.limits.maxDrawIndirectCount, 1u);
+			for (uint32_t first = 0; first < maxDraws; first += limit)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, first * DRAW_STRIDE,
+				                         std::min(limit, maxDraws - first), static_cast<uint32_t>(DRAW_STRIDE));
+			}
+			break;
+		}
+
+		case DrawPath::SingleDrawIndirect:
+			// scales with the object count again, the gpu still does the culling
+			for (uint32_t i = 0; i < maxDraws; i++)
+				vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, i * DRAW_STRIDE, 1, 0);
+			break;
+		}
+	}
+
+	AppGpuCulling::AppGpuCulling(AppDevice& device, AppPipelineLayoutCache& layoutCache, const uint32_t maxObjects,
+	                             const uint32_t framesInFlight)
+		: _device{device}, _maxObjects{maxObjects}
+	{
+		if (maxObjects == 0)
+			throw std::runtime_error("gpu culling needs room for at least one object!");
+
+		_drawPath = ChooseDrawPath(_device);
+
+		// only the count draw can skip the tail, everything else needs every object in its own slot
+		SpecializationConstants constants;
+		constants.Set(0, _drawPath == DrawPath::IndirectCount ? VK_TRUE : VK_FALSE);
+		_pipeline = std::make_unique<AppComputePipeline>(_device, layoutCache, std::string(SHADER_PATH), &constants);
+
+		_device.CreateBuffer(maxObjects * sizeof(GpuObject),
+		                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                     MemoryUsage::GpuOnly, _objectBuffer, _objectMemory);
+		_device.CreateBuffer(maxObjects * DRAW_STRIDE,
+		                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		                     MemoryUsage::GpuOnly, _drawBuffer, _drawMemory);
+		_device.CreateBuffer(sizeof(uint32_t),
+		                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+		                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                     MemoryUsage::GpuOnly, _countBuffer, _countMemory);
+
+		_readbackBuffers.resize(framesInFlight);
+		_readbackMemory.resize(framesInFlight);
+		for (uint32_t i = 0; i < framesInFlight; i++)
+		{
+			_device.CreateBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::Readback,
+			                     _readbackBuffers[i], _readbackMemory[i]);
+			*static_cast<uint32_t*>(_readbackMemory[i].mappedData) = 0;
+		}
+
+		CreateDescriptorSet();
+	}
+
+	AppGpuCulling::~AppGpuCulling()
+	{
+		vkDestroyDescriptorPool(_device.Device(), _descriptorPool, nullptr);
+		for (size_t i = 0; i < _readbackBuffers.size(); i++)
+			_device.DestroyBuffer(_readbackBuffers[i], _readbackMemory[i]);
+		_device.DestroyBuffer(_countBuffer, _countMemory);
+		_device.DestroyBuffer(_drawBuffer, _drawMemory);
+		_device.DestroyBuffer(_objectBuffer, _objectMemory);
+	}
+
+	void AppGpuCulling::CreateDescriptorSet()
+	{
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSize.descriptorCount = 3;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		if (vkCreateDescriptorPool(_device.Device(), &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create culling descriptor pool!");
+
+		const VkDescriptorSetLayout setLayout = _pipeline->SetLayout(0);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = _descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &setLayout;
+		if (vkAllocateDescriptorSets(_device.Device(), &allocInfo, &_descriptorSet) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate culling descriptor set!");
+
+		// bindings as declared in cull.comp
+		const std::array<VkDescriptorBufferInfo, 3> bufferInfos = {{
+			{_objectBuffer, 0, VK_WHOLE_SIZE},
+			{_drawBuffer, 0, VK_WHOLE_SIZE},
+			{_countBuffer, 0, VK_WHOLE_SIZE}
+		}};
+		std::array<VkWriteDescriptorSet, 3> writes{};
+		for (uint32_t i = 0; i < writes.size(); i++)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = _descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(_device.Device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	void AppGpuCulling::SetObjects(const std::vector<GpuObject>& objects)
+	{
+		if (objects.size() > _maxObjects)
+			throw std::runtime_error("more objects than gpu culling was created for!");
+
+		// one copy so the buffer is released to the graphics queue once, the upload queue gives a list too large
+		// for its ring a staging buffer of its own
+		const VkDeviceSize size = objects.size() * sizeof(GpuObject);
+		if (size > 0)
+			_device.UploadQueue().Wait(_device.UploadQueue().UploadBuffer(_objectBuffer, 0, objects.data(), size));
+
+		_objectCount = static_cast<uint32_t>(objects.size());
+	}
+
+	ComputePass AppGpuCulling::CreateComputePass()
+	{
+		ComputePass pass;
+		pass.name = "gpu_culling";
+		pass.stage = ComputeStage::BeforeRenderPass;
+		pass.consumerStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+		pass.consumerAccess = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		pass.record = [this](const VkCommandBuffer commandBuffer) { RecordCull(commandBuffer); };
+		return pass;
+	}
+
+	void AppGpuCulling::RecordCull(const VkCommandBuffer commandBuffer) const
+	{
+		// last frame's count draw and readback are done with the count before it is reset
+		RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		                    VK_PIPELINE_STAGE_TRANSFER_BIT, 0);
+		vkCmdFillBuffer(commandBuffer, _countBuffer, 0, sizeof(uint32_t), 0);
+		RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		if (_objectCount == 0)
+			return;
+
+		CullConstants constants{};
+		constants.planes = _frustum.planes;
+		constants.objectCount = _objectCount;
+
+		_pipeline->Bind(commandBuffer);
+		_pipeline->BindDescriptorSets(commandBuffer, 0, {_descriptorSet});
+		_pipeline->PushConstants(commandBuffer, constants);
+		_pipeline->DispatchThreads(commandBuffer, _objectCount);
+	}
+
+	void AppGpuCulling::RecordDraws(AppCommandEncoder& encoder) const
+	{
+		if (_objectCount == 0)
+			return;
+
+		RecordIndirectDraws(_device, _drawPath, encoder.Handle(), _drawBuffer, _countBuffer, _objectCount);
+	}
+
+	void AppGpuCulling::RecordReadback(const VkCommandBuffer commandBuffer, const uint32_t frame) const
+	{
+		RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+		VkBufferCopy region{};
+		region.size = sizeof(uint32_t);
+		vkCmdCopyBuffer(commandBuffer, _countBuffer, _readbackBuffers.at(frame), 1, &region);
+
+		RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		                    VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	}
+
+	uint32_t AppGpuCulling::ReadVisibleCount(const uint32_t frame) const
+	{
+		const MemoryAllocation& memory = _readbackMemory.at(frame);
+
+		// readback memory may be cached without being coherent
+		const VkDeviceSize atomSize = std::max<VkDeviceSize>(_device.properties.limits.nonCoherentAtomSize, 1);
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = memory.memory;
+		range.offset = memory.offset / atomSize * atomSize;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(_device.Device(), 1, &range);
+
+		return *static_cast<const uint32_t*>(memory.mappedData);
+	}
+
+	void AppGpuCulling::PrintStats(std::ostream& out) const
+	{
+		out << "gpu_culling path=" << DrawPathName(_drawPath) << " objects=" << _objectCount
+			<< " max_objects=" << _maxObjects << std::endl;
+	}
+}
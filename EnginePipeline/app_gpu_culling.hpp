@@ -0,0 +1,104 @@
+#pragma once
+
+#include "app_command_encoder.hpp"
+#include "app_compute_pipeline.hpp"
+#include "app_device.hpp"
+#include "app_frustum.hpp"
+#include "app_pipeline_layout_cache.hpp"
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// one cullable draw as cull.comp reads it, std430
+	struct GpuObject
+	{
+		std::array<float, 3> center{};
+		float radius = 0.0f;
+		uint32_t indexCount = 0;
+		uint32_t firstIndex = 0;
+		int32_t vertexOffset = 0;
+		uint32_t firstInstance = 0;
+	};
+	static_assert(sizeof(GpuObject) == 32, "GpuObject has to match Object in cull.comp");
+
+	// GPU driven drawing: object bounds and draw parameters live in a storage buffer, a compute pass culls
+	// them against the frustum every frame and writes the indirect draws. With VK_KHR_draw_indirect_count
+	// the draws are compacted and the gpu-written count is drawn in one call, otherwise every object keeps
+	// its command and culled ones draw zero instances. Either way the cpu records the same few commands no
+	// matter how many objects there are, unless the device lacks multiDrawIndirect.
+	class AppGpuCulling
+	{
+	public:
+		static constexpr const char* SHADER_PATH = "Shaders/cull.comp.spv";
+
+		enum class DrawPath
+		{
+			// vkCmdDrawIndexedIndirectCountKHR over compacted draws
+			IndirectCount,
+			// one vkCmdDrawIndexedIndirect over every object
+			MultiDrawIndirect,
+			// one vkCmdDrawIndexedIndirect per object
+			SingleDrawIndirect
+		};
+
+		static const char* DrawPathName(DrawPath path);
+		// the best path the device supports
+		static DrawPath ChooseDrawPath(const AppDevice& device);
+		// draws a cull shader's output: up to maxDraws commands, compacted behind a count for IndirectCount
+		static void RecordIndirectDraws(const AppDevice& device, DrawPath path, VkCommandBuffer commandBuffer,
+		                                VkBuffer drawBuffer, VkBuffer countBuffer, uint32_t maxDraws);
+
+		AppGpuCulling(AppDevice& device, AppPipelineLayoutCache& layoutCache, uint32_t maxObjects,
+		              uint32_t framesInFlight);
+		~AppGpuCulling();
+
+		AppGpuCulling(const AppGpuCulling&) = delete;
+		AppGpuCulling& operator=(const AppGpuCulling&) = delete;
+
+		// uploads through the upload queue and waits, meant for load time. once, with a dedicated transfer
+		// queue the buffer belongs to the graphics queue afterwards
+		void SetObjects(const std::vector<GpuObject>& objects);
+		void SetFrustum(const Frustum& frustum) { _frustum = frustum; }
+
+		// resets the count and dispatches the cull, consumers read the draws at DRAW_INDIRECT
+		ComputePass CreateComputePass();
+		// inside the render pass with the pipeline and index buffer bound
+		void RecordDraws(AppCommandEncoder& encoder) const;
+		// after the render pass, copies the count where the cpu can read it once the frame's fence signalled
+		void RecordReadback(VkCommandBuffer commandBuffer, uint32_t frame) const;
+		// visible objects of the last frame recorded in this slot, the slot's fence must have been waited on
+		[[nodiscard]] uint32_t ReadVisibleCount(uint32_t frame) const;
+
+		[[nodiscard]] DrawPath GetDrawPath() const { return _drawPath; }
+		[[nodiscard]] uint32_t ObjectCount() const { return _objectCount; }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		void RecordCull(VkCommandBuffer commandBuffer) const;
+		void CreateDescriptorSet();
+
+		AppDevice& _device;
+		DrawPath _drawPath;
+		std::unique_ptr<AppComputePipeline> _pipeline;
+		const uint32_t _maxObjects;
+		uint32_t _objectCount = 0;
+		Frustum _frustum = Frustum::FromBox({-1.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 1.0f});
+
+		VkBuffer _objectBuffer = VK_NULL_HANDLE;
+		MemoryAllocation _objectMemory{};
+		VkBuffer _drawBuffer = VK_NULL_HANDLE;
+		MemoryAllocation _drawMemory{};
+		VkBuffer _countBuffer = VK_NULL_HANDLE;
+		MemoryAllocation _countMemory{};
+		// one per frame in flight, so a slot is read back while the others are still being written
+		std::vector<VkBuffer> _readbackBuffers;
+		std::vector<MemoryAllocation> _readbackMemory;
+
+		VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet _descriptorSet = VK_NULL_HANDLE;
+	};
+}
@@ -0,0 +1,306 @@
+#include "app_hiz_pyramid.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		// push constant block of hiz_reduce.comp
+		struct ReduceConstants
+		{
+			std::array<int32_t, 2> sourceSize;
+			std::array<int32_t, 2> destinationSize;
+		};
+
+		uint32_t PreviousPowerOfTwo(const uint32_t value)
+		{
+			uint32_t result = 1;
+			while (result * 2 <= value)
+				result *= 2;
+			return result;
+		}
+
+		VkExtent2D LevelExtent(const VkExtent2D extent, const uint32_t level)
+		{
+			return {std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u)};
+		}
+
+		VkImageAspectFlags DepthAspects(const VkFormat format)
+		{
+			// layout transitions of a combined format have to name both aspects
+			if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT)
+				return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		}
+	}
+
+	AppHiZPyramid::AppHiZPyramid(AppDevice& device, AppPipelineLayoutCache& layoutCache, const uint32_t framesInFlight)
+		: _device{device}, _framesInFlight{framesInFlight}
+	{
+		_pipeline = std::make_unique<AppComputePipeline>(_device, layoutCache, std::string(SHADER_PATH));
+
+		// texelFetch only, filtering never happens
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = static_cast<float>(MAX_LEVELS);
+		if (vkCreateSampler(_device.Device(), &samplerInfo, nullptr, &_sampler) != VK_SUCCESS)
+			throw std::runtime_error("failed to create hi-z sampler!");
+
+		const uint32_t setCount = framesInFlight * MAX_LEVELS;
+		const std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount},
+			{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount}
+		}};
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = setCount;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(_device.Device(), &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create hi-z descriptor pool!");
+
+		const std::vector<VkDescriptorSetLayout> setLayouts(setCount, _pipeline->SetLayout(0));
+		std::vector<VkDescriptorSet> sets(setCount);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = _descriptorPool;
+		allocInfo.descriptorSetCount = setCount;
+		allocInfo.pSetLayouts = setLayouts.data();
+		if (vkAllocateDescriptorSets(_device.Device(), &allocInfo, sets.data()) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate hi-z descriptor sets!");
+
+		_levelSets.resize(framesInFlight);
+		for (uint32_t frame = 0; frame < framesInFlight; frame++)
+		{
+			_levelSets[frame].resize(MAX_LEVELS);
+			for (uint32_t level = 0; level < MAX_LEVELS; level++)
+				_levelSets[frame][level].set = sets[frame * MAX_LEVELS + level];
+		}
+	}
+
+	AppHiZPyramid::~AppHiZPyramid()
+	{
+		for (Pyramid& pyramid : _retired)
+			DestroyPyramid(pyramid);
+		DestroyPyramid(_current);
+		vkDestroyDescriptorPool(_device.Device(), _descriptorPool, nullptr);
+		vkDestroySampler(_device.Device(), _sampler, nullptr);
+	}
+
+	AppHiZPyramid::Pyramid AppHiZPyramid::CreatePyramid(const VkExtent2D extent) const
+	{
+		Pyramid pyramid;
+		pyramid.extent = {PreviousPowerOfTwo(extent.width), PreviousPowerOfTwo(extent.height)};
+		// down to 1x1
+		const uint32_t largest = std::max(pyramid.extent.width, pyramid.extent.height);
+		pyramid.levelCount = 1;
+		while (pyramid.levelCount < MAX_LEVELS && (largest >> pyramid.levelCount) > 0)
+			pyramid.levelCount++;
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = pyramid.extent.width;
+		imageInfo.extent.height = pyramid.extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = pyramid.levelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		_device.CreateImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramid.image, pyramid.memory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramid.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = pyramid.levelCount;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(_device.Device(), &viewInfo, nullptr, &pyramid.view) != VK_SUCCESS)
+			throw std::runtime_error("failed to create hi-z image view!");
+
+		pyramid.levelViews.resize(pyramid.levelCount);
+		for (uint32_t level = 0; level < pyramid.levelCount; level++)
+		{
+			viewInfo.subresourceRange.baseMipLevel = level;
+			viewInfo.subresourceRange.levelCount = 1;
+			if (vkCreateImageView(_device.Device(), &viewInfo, nullptr, &pyramid.levelViews[level]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create hi-z level view!");
+		}
+
+		return pyramid;
+	}
+
+	void AppHiZPyramid::DestroyPyramid(Pyramid& pyramid) const
+	{
+		for (const VkImageView levelView : pyramid.levelViews)
+			vkDestroyImageView(_device.Device(), levelView, nullptr);
+		pyramid.levelViews.clear();
+
+		if (pyramid.view != VK_NULL_HANDLE)
+			vkDestroyImageView(_device.Device(), pyramid.view, nullptr);
+		if (pyramid.image != VK_NULL_HANDLE)
+			_device.DestroyImage(pyramid.image, pyramid.memory);
+		pyramid.view = VK_NULL_HANDLE;
+		pyramid.image = VK_NULL_HANDLE;
+	}
+
+	void AppHiZPyramid::Prepare(const VkCommandBuffer commandBuffer, const VkExtent2D depthExtent)
+	{
+		// frames up to _frameNumber - framesInFlight are done, the same rule the swap chain retires by
+		while (!_retired.empty() && _frameNumber + 1 >= _retired.front().retiredAtFrame + _framesInFlight)
+		{
+			DestroyPyramid(_retired.front());
+			_retired.pop_front();
+		}
+
+		const VkExtent2D extent{PreviousPowerOfTwo(depthExtent.width), PreviousPowerOfTwo(depthExtent.height)};
+		if (_current.image == VK_NULL_HANDLE ||
+			extent.width != _current.extent.width || extent.height != _current.extent.height)
+		{
+			if (_current.image != VK_NULL_HANDLE)
+			{
+				_current.retiredAtFrame = _frameNumber;
+				_retired.push_back(std::move(_current));
+				_resizes++;
+			}
+			_current = CreatePyramid(depthExtent);
+		}
+
+		if (!_current.initialized)
+		{
+			// readers may bind it before the first build, it has to be in the layout they declare
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = _current.image;
+			barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, _current.levelCount, 0, 1};
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			                     0, 0, nullptr, 0, nullptr, 1, &barrier);
+			_current.initialized = true;
+		}
+
+		_frameNumber++;
+	}
+
+	void AppHiZPyramid::UpdateLevelSet(LevelSet& levelSet, const VkImageView source, const VkImageLayout sourceLayout,
+	                                   const VkImageView destination) const
+	{
+		if (levelSet.source == source && levelSet.destination == destination)
+			return;
+
+		// the set belongs to one frame slot whose fence was waited on, nothing executes it anymore
+		const VkDescriptorImageInfo sourceInfo{_sampler, source, sourceLayout};
+		const VkDescriptorImageInfo destinationInfo{VK_NULL_HANDLE, destination, VK_IMAGE_LAYOUT_GENERAL};
+		std::array<VkWriteDescriptorSet, 2> writes{};
+		for (uint32_t i = 0; i < writes.size(); i++)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = levelSet.set;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+		}
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].pImageInfo = &sourceInfo;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].pImageInfo = &destinationInfo;
+		vkUpdateDescriptorSets(_device.Device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+		levelSet.source = source;
+		levelSet.destination = destination;
+	}
+
+	void AppHiZPyramid::Build(const VkCommandBuffer commandBuffer, const uint32_t frame, const AppRenderTarget& target,
+	                          const uint32_t imageIndex)
+	{
+		if (_current.image == VK_NULL_HANDLE)
+			throw std::runtime_error("hi-z pyramid built before it was prepared!");
+
+		std::vector<LevelSet>& levelSets = _levelSets.at(frame);
+		const VkImage depthImage = target.GetDepthImage(imageIndex);
+		const VkExtent2D depthExtent = target.GetExtent();
+		const VkImageSubresourceRange depthRange{DepthAspects(target.GetDepthFormat()), 0, 1, 0, 1};
+
+		UpdateLevelSet(levelSets[0], target.GetDepthImageView(imageIndex),
+		               VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, _current.levelViews[0]);
+		for (uint32_t level = 1; level < _current.levelCount; level++)
+		{
+			UpdateLevelSet(levelSets[level], _current.levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL,
+			               _current.levelViews[level]);
+		}
+
+		// depth writes done, and last frame's readers of the pyramid done before it is overwritten
+		VkImageMemoryBarrier depthBarrier{};
+		depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.image = depthImage;
+		depthBarrier.subresourceRange = depthRange;
+		vkCmdPipelineBarrier(commandBuffer,
+		                     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+		                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+		_pipeline->Bind(commandBuffer);
+		VkExtent2D sourceExtent = depthExtent;
+		for (uint32_t level = 0; level < _current.levelCount; level++)
+		{
+			const VkExtent2D levelExtent = LevelExtent(_current.extent, level);
+
+			ReduceConstants constants{};
+			constants.sourceSize = {static_cast<int32_t>(sourceExtent.width), static_cast<int32_t>(sourceExtent.height)};
+			constants.destinationSize = {static_cast<int32_t>(levelExtent.width),
+			                             static_cast<int32_t>(levelExtent.height)};
+
+			_pipeline->BindDescriptorSets(commandBuffer, 0, {levelSets[level].set});
+			_pipeline->PushConstants(commandBuffer, constants);
+			_pipeline->DispatchThreads(commandBuffer, levelExtent.width, levelExtent.height);
+
+			// the next level reads this one, and after the last one the occlusion tests read them all
+			RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+			sourceExtent = levelExtent;
+		}
+
+		// back to the layout the loading render pass expects
+		depthBarrier.srcAccessMask = 0;
+		depthBarrier.dstAccessMask =
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		                     0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+		_builds++;
+	}
+
+	void AppHiZPyramid::PrintStats(std::ostream& out) const
+	{
+		out << "hiz_pyramid width=" << _current.extent.width << " height=" << _current.extent.height
+			<< " levels=" << _current.levelCount << " builds=" << _builds << " resizes=" << _resizes << std::endl;
+	}
+}
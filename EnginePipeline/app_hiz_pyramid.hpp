@@ -0,0 +1,88 @@
+#pragma once
+
+#include "app_compute_pipeline.hpp"
+#include "app_device.hpp"
+#include "app_pipeline_layout_cache.hpp"
+#include "app_render_target.hpp"
+
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Hierarchical depth: a mip chain where every texel holds the farthest depth beneath it, reduced by a
+	// compute pass from a depth attachment the render pass stored. An occlusion test reads the one level
+	// where its bounds cover at most 2x2 texels. Level 0 is the depth extent rounded down to powers of two.
+	// The pyramid follows the target's size, a replaced one is kept until the frames reading it retired.
+	class AppHiZPyramid
+	{
+	public:
+		static constexpr const char* SHADER_PATH = "Shaders/hiz_reduce.comp.spv";
+		static constexpr uint32_t MAX_LEVELS = 16;
+
+		AppHiZPyramid(AppDevice& device, AppPipelineLayoutCache& layoutCache, uint32_t framesInFlight);
+		~AppHiZPyramid();
+
+		AppHiZPyramid(const AppHiZPyramid&) = delete;
+		AppHiZPyramid& operator=(const AppHiZPyramid&) = delete;
+
+		// once per frame before the pyramid is bound anywhere: fits it to the depth extent and moves a new
+		// one to GENERAL. the slot's fence must have been waited on
+		void Prepare(VkCommandBuffer commandBuffer, VkExtent2D depthExtent);
+		// reduces the image's depth, which the render pass left in DEPTH_STENCIL_ATTACHMENT_OPTIMAL and gets
+		// back in it. compute shaders read the result in GENERAL right after
+		void Build(VkCommandBuffer commandBuffer, uint32_t frame, const AppRenderTarget& target, uint32_t imageIndex);
+
+		// every level, for texelFetch with an explicit lod
+		[[nodiscard]] VkImageView View() const { return _current.view; }
+		[[nodiscard]] VkSampler Sampler() const { return _sampler; }
+		[[nodiscard]] VkExtent2D Extent() const { return _current.extent; }
+		[[nodiscard]] uint32_t LevelCount() const { return _current.levelCount; }
+
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		struct Pyramid
+		{
+			VkImage image = VK_NULL_HANDLE;
+			MemoryAllocation memory{};
+			VkImageView view = VK_NULL_HANDLE;
+			std::vector<VkImageView> levelViews;
+			VkExtent2D extent{};
+			uint32_t levelCount = 0;
+			// moved out of UNDEFINED yet
+			bool initialized = false;
+			uint64_t retiredAtFrame = 0;
+		};
+
+		// one reduce set per level and frame slot, rewritten only when the views it points at change
+		struct LevelSet
+		{
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			VkImageView source = VK_NULL_HANDLE;
+			VkImageView destination = VK_NULL_HANDLE;
+		};
+
+		[[nodiscard]] Pyramid CreatePyramid(VkExtent2D extent) const;
+		void DestroyPyramid(Pyramid& pyramid) const;
+		void UpdateLevelSet(LevelSet& levelSet, VkImageView source, VkImageLayout sourceLayout,
+		                    VkImageView destination) const;
+
+		AppDevice& _device;
+		const uint32_t _framesInFlight;
+		std::unique_ptr<AppComputePipeline> _pipeline;
+		VkSampler _sampler = VK_NULL_HANDLE;
+		VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+		// [frame][level]
+		std::vector<std::vector<LevelSet>> _levelSets;
+
+		Pyramid _current;
+		std::deque<Pyramid> _retired;
+		uint64_t _frameNumber = 0;
+
+		uint64_t _builds = 0;
+		uint64_t _resizes = 0;
+	};
+}
@@ -0,0 +1,127 @@
+#include "app_job_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace VulkanTest
+{
+	AppJobPool::AppJobPool(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+		{
+			// 0 means unknown, which must not wrap around below
+			const unsigned hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		_workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+			_workers.emplace_back([this] { WorkerLoop(); });
+	}
+
+	AppJobPool::~AppJobPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopping = true;
+		}
+		_wake.notify_all();
+
+		for (auto& worker : _workers)
+			worker.join();
+	}
+
+	void AppJobPool::Enqueue(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_jobs.push_back(std::move(job));
+		}
+		_wake.notify_one();
+	}
+
+	void AppJobPool::WorkerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+				if (_jobs.empty())
+					return;
+
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+
+			job();
+		}
+	}
+
+	void AppJobPool::ParallelFor(const size_t count, const size_t minRange,
+	                             const std::function<void(size_t, size_t)>& body)
+	{
+		if (count == 0)
+			return;
+
+		const size_t participants = _workers.size() + 1;
+		const size_t rangeSize = std::max<size_t>(std::max<size_t>(minRange, 1),
+		                                          (count + participants - 1) / participants);
+		const size_t rangeCount = (count + rangeSize - 1) / rangeSize;
+
+		if (rangeCount == 1)
+		{
+			body(0, count);
+			return;
+		}
+
+		// helpers can still be dequeued after we returned, so they only hold the shared state and
+		// touch body only for a range they claimed, which we wait on
+		struct State
+		{
+			std::atomic<size_t> nextRange{0};
+			std::atomic<size_t> finishedRanges{0};
+			std::exception_ptr error;
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+		auto state = std::make_shared<State>();
+
+		auto runRanges = [state, &body, count, rangeSize, rangeCount]
+		{
+			for (size_t range = state->nextRange++; range < rangeCount; range = state->nextRange++)
+			{
+				const size_t begin = range * rangeSize;
+				try
+				{
+					body(begin, std::min(count, begin + rangeSize));
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+					if (!state->error)
+						state->error = std::current_exception();
+				}
+
+				if (++state->finishedRanges == rangeCount)
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->done.notify_all();
+				}
+			}
+		};
+
+		for (size_t i = 1; i < std::min(rangeCount, participants); i++)
+			Enqueue(runRanges);
+
+		runRanges();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->done.wait(lock, [&state, rangeCount] { return state->finishedRanges == rangeCount; });
+
+		if (state->error)
+			std::rethrow_exception(state->error);
+	}
+}
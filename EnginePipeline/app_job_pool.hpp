@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Fixed set of worker threads pulling jobs from one shared queue.
+	// Used for work that scales with core count: shader loading, pipeline compilation, culling.
+	class AppJobPool
+	{
+	public:
+		// 0 picks one worker per hardware thread, minus the calling thread
+		explicit AppJobPool(uint32_t threadCount = 0);
+		// finishes the queued jobs before joining
+		~AppJobPool();
+
+		AppJobPool(const AppJobPool&) = delete;
+		AppJobPool& operator=(const AppJobPool&) = delete;
+
+		template <typename Job>
+		auto Submit(Job&& job) -> std::future<std::invoke_result_t<std::decay_t<Job>>>
+		{
+			using Result = std::invoke_result_t<std::decay_t<Job>>;
+
+			// std::function needs a copyable target, packaged_task is move only
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Job>(job));
+			std::future<Result> future = task->get_future();
+			Enqueue([task] { (*task)(); });
+			return future;
+		}
+
+		// Splits [0, count) into ranges of at least minRange and runs body(begin, end) on the workers and the
+		// calling thread. Returns when every range finished, rethrows the first exception a range threw.
+		// Safe to call from inside a job, the caller never just waits while ranges are left.
+		void ParallelFor(size_t count, size_t minRange, const std::function<void(size_t, size_t)>& body);
+
+		[[nodiscard]] uint32_t ThreadCount() const { return static_cast<uint32_t>(_workers.size()); }
+
+	private:
+		void Enqueue(std::function<void()> job);
+		void WorkerLoop();
+
+		std::vector<std::thread> _workers;
+		std::deque<std::function<void()>> _jobs;
+		std::mutex _mutex;
+		std::condition_variable _wake;
+		bool _stopping = false;
+	};
+}
@@ -0,0 +1,555 @@
+#include "app_memory_allocator.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace VulkanTest
+{
+	namespace
+	{
+		uint32_t MostSignificantBit(const uint64_t value)
+		{
+#if defined(_MSC_VER) && defined(_WIN64)
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return index;
+#elif defined(_MSC_VER)
+			unsigned long index;
+			if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32)))
+				return index + 32;
+			_BitScanReverse(&index, static_cast<unsigned long>(value));
+			return index;
+#else
+			return 63u - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+		}
+
+		uint32_t LeastSignificantBit(const uint64_t value)
+		{
+#if defined(_MSC_VER) && defined(_WIN64)
+			unsigned long index;
+			_BitScanForward64(&index, value);
+			return index;
+#elif defined(_MSC_VER)
+			unsigned long index;
+			if (_BitScanForward(&index, static_cast<unsigned long>(value)))
+				return index;
+			_BitScanForward(&index, static_cast<unsigned long>(value >> 32));
+			return index + 32;
+#else
+			return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+		}
+
+		VkDeviceSize AlignUp(const VkDeviceSize value, const VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	// TlsfMetadata
+
+	TlsfMetadata::TlsfMetadata(const VkDeviceSize size) : _size{size}, _freeBytes{0}
+	{
+		_firstPhysical = new Node{};
+		_firstPhysical->offset = 0;
+		_firstPhysical->size = size;
+		InsertFree(_firstPhysical);
+	}
+
+	TlsfMetadata::~TlsfMetadata()
+	{
+		Node* node = _firstPhysical;
+		while (node != nullptr)
+		{
+			Node* next = node->nextPhysical;
+			delete node;
+			node = next;
+		}
+	}
+
+	void TlsfMetadata::MapSize(const VkDeviceSize size, uint32_t& firstLevel, uint32_t& secondLevel)
+	{
+		if (size < SMALL_SIZE)
+		{
+			firstLevel = 0;
+			secondLevel = static_cast<uint32_t>(size / (SMALL_SIZE / SECOND_LEVEL_COUNT));
+			return;
+		}
+
+		const uint32_t msb = MostSignificantBit(size);
+		firstLevel = msb - SMALL_SIZE_LOG2 + 1;
+		secondLevel = static_cast<uint32_t>(size >> (msb - SECOND_LEVEL_LOG2)) & (SECOND_LEVEL_COUNT - 1);
+	}
+
+	TlsfMetadata::Node* TlsfMetadata::FindFreeNode(const VkDeviceSize size) const
+	{
+		// good fit: round up to the next list so any node found is guaranteed to be large enough
+		VkDeviceSize rounded = size;
+		if (size >= SMALL_SIZE)
+			rounded += (1ull << (MostSignificantBit(size) - SECOND_LEVEL_LOG2)) - 1;
+		else
+			rounded += SMALL_SIZE / SECOND_LEVEL_COUNT - 1;
+
+		uint32_t firstLevel, secondLevel;
+		MapSize(rounded, firstLevel, secondLevel);
+
+		if (firstLevel < FIRST_LEVEL_COUNT)
+		{
+			uint32_t secondMap = _secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+			if (secondMap == 0)
+			{
+				const uint64_t firstMap = firstLevel + 1 < 64 ? _firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+				if (firstMap != 0)
+				{
+					firstLevel = LeastSignificantBit(firstMap);
+					secondMap = _secondLevelBitmaps[firstLevel];
+				}
+			}
+
+			if (secondMap != 0)
+				return _freeLists[firstLevel][LeastSignificantBit(secondMap)];
+		}
+
+		// nothing in the larger lists, the list the size itself maps to may still hold a node that fits
+		MapSize(size, firstLevel, secondLevel);
+		for (Node* node = _freeLists[firstLevel][secondLevel]; node != nullptr; node = node->nextFree)
+		{
+			if (node->size >= size)
+				return node;
+		}
+
+		return nullptr;
+	}
+
+	void TlsfMetadata::InsertFree(Node* node)
+	{
+		uint32_t firstLevel, secondLevel;
+		MapSize(node->size, firstLevel, secondLevel);
+
+		node->isFree = true;
+		node->prevFree = nullptr;
+		node->nextFree = _freeLists[firstLevel][secondLevel];
+		if (node->nextFree != nullptr)
+			node->nextFree->prevFree = node;
+		_freeLists[firstLevel][secondLevel] = node;
+
+		_firstLevelBitmap |= 1ull << firstLevel;
+		_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+
+		_freeBytes += node->size;
+		_freeRangeCount++;
+	}
+
+	void TlsfMetadata::RemoveFree(Node* node)
+	{
+		uint32_t firstLevel, secondLevel;
+		MapSize(node->size, firstLevel, secondLevel);
+
+		if (node->prevFree != nullptr)
+			node->prevFree->nextFree = node->nextFree;
+		else
+			_freeLists[firstLevel][secondLevel] = node->nextFree;
+
+		if (node->nextFree != nullptr)
+			node->nextFree->prevFree = node->prevFree;
+
+		if (_freeLists[firstLevel][secondLevel] == nullptr)
+		{
+			_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (_secondLevelBitmaps[firstLevel] == 0)
+				_firstLevelBitmap &= ~(1ull << firstLevel);
+		}
+
+		node->prevFree = nullptr;
+		node->nextFree = nullptr;
+		_freeBytes -= node->size;
+		_freeRangeCount--;
+	}
+
+	TlsfMetadata::Node* TlsfMetadata::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		size = std::max<VkDeviceSize>(size, 1);
+		alignment = std::max<VkDeviceSize>(alignment, 1);
+
+		// worst case padding, so whatever node comes back can be aligned in place
+		Node* node = FindFreeNode(size + alignment - 1);
+		if (node == nullptr)
+			return nullptr;
+
+		RemoveFree(node);
+
+		const VkDeviceSize alignedOffset = AlignUp(node->offset, alignment);
+		const VkDeviceSize padding = alignedOffset - node->offset;
+		if (padding > 0)
+		{
+			auto* front = new Node{};
+			front->offset = node->offset;
+			front->size = padding;
+			front->prevPhysical = node->prevPhysical;
+			front->nextPhysical = node;
+
+			if (node->prevPhysical != nullptr)
+				node->prevPhysical->nextPhysical = front;
+			else
+				_firstPhysical = front;
+
+			node->prevPhysical = front;
+			node->offset = alignedOffset;
+			node->size -= padding;
+			InsertFree(front);
+		}
+
+		if (node->size - size >= MIN_SPLIT_SIZE)
+		{
+			auto* back = new Node{};
+			back->offset = node->offset + size;
+			back->size = node->size - size;
+			back->prevPhysical = node;
+			back->nextPhysical = node->nextPhysical;
+
+			if (node->nextPhysical != nullptr)
+				node->nextPhysical->prevPhysical = back;
+
+			node->nextPhysical = back;
+			node->size = size;
+			InsertFree(back);
+		}
+
+		node->isFree = false;
+		_allocationCount++;
+		return node;
+	}
+
+	void TlsfMetadata::Free(Node* node)
+	{
+		_allocationCount--;
+
+		// neighbours are never both free and adjacent, so merging once each way restores the invariant
+		if (Node* prev = node->prevPhysical; prev != nullptr && prev->isFree)
+		{
+			RemoveFree(prev);
+			prev->size += node->size;
+			prev->nextPhysical = node->nextPhysical;
+			if (node->nextPhysical != nullptr)
+				node->nextPhysical->prevPhysical = prev;
+			delete node;
+			node = prev;
+		}
+
+		if (Node* next = node->nextPhysical; next != nullptr && next->isFree)
+		{
+			RemoveFree(next);
+			node->size += next->size;
+			node->nextPhysical = next->nextPhysical;
+			if (next->nextPhysical != nullptr)
+				next->nextPhysical->prevPhysical = node;
+			delete next;
+		}
+
+		InsertFree(node);
+	}
+
+	VkDeviceSize TlsfMetadata::LargestFreeRange() const
+	{
+		if (_firstLevelBitmap == 0)
+			return 0;
+
+		const uint32_t firstLevel = MostSignificantBit(_firstLevelBitmap);
+		const uint32_t secondLevel = MostSignificantBit(_secondLevelBitmaps[firstLevel]);
+
+		VkDeviceSize largest = 0;
+		for (const Node* node = _freeLists[firstLevel][secondLevel]; node != nullptr; node = node->nextFree)
+			largest = std::max(largest, node->size);
+
+		return largest;
+	}
+
+	// AppMemoryBlock
+
+	AppMemoryBlock::AppMemoryBlock(VkDevice device, VkDeviceMemory memory, const VkDeviceSize size,
+	                               const uint32_t memoryTypeIndex, const uint32_t poolIndex, void* mappedData)
+		: _device{device}, _memory{memory}, _memoryTypeIndex{memoryTypeIndex}, _poolIndex{poolIndex},
+		  _mappedData{mappedData}, _metadata{size}
+	{
+	}
+
+	AppMemoryBlock::~AppMemoryBlock()
+	{
+		// freeing mapped memory implicitly unmaps it
+		vkFreeMemory(_device, _memory, nullptr);
+	}
+
+	bool AppMemoryBlock::TryAllocate(const VkDeviceSize size, const VkDeviceSize alignment,
+	                                 MemoryAllocation& allocation)
+	{
+		TlsfMetadata::Node* node = _metadata.Allocate(size, alignment);
+		if (node == nullptr)
+			return false;
+
+		allocation.memory = _memory;
+		allocation.offset = node->offset;
+		allocation.size = node->size;
+		allocation.memoryTypeIndex = _memoryTypeIndex;
+		allocation.mappedData = _mappedData != nullptr ? static_cast<char*>(_mappedData) + node->offset : nullptr;
+		allocation.block = this;
+		allocation.node = node;
+		return true;
+	}
+
+	void AppMemoryBlock::Free(const MemoryAllocation& allocation) { _metadata.Free(allocation.node); }
+
+	// AppMemoryAllocator
+
+	AppMemoryAllocator::AppMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, AppMemoryBudget& budget)
+		: _device{device}, _budget{budget}
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		_maxDeviceAllocations = properties.limits.maxMemoryAllocationCount;
+
+		_pools.resize(static_cast<size_t>(_budget.MemoryProperties().memoryTypeCount) * 2);
+	}
+
+	AppMemoryAllocator::~AppMemoryAllocator()
+	{
+		const auto stats = GetStats();
+		if (stats.allocationCount > 0)
+			std::cerr << "memory allocator destroyed with " << stats.allocationCount << " live allocations" << std::endl;
+
+		for (auto& [blocks] : _pools)
+		{
+			for (const auto& block : blocks)
+				_budget.OnFree(block->MemoryTypeIndex(), block->Metadata().Size());
+		}
+		_pools.clear();
+	}
+
+	VkDeviceSize AppMemoryAllocator::PreferredBlockSize(const uint32_t memoryTypeIndex) const
+	{
+		const auto& memoryProperties = _budget.MemoryProperties();
+		const uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		const VkDeviceSize heapSize = memoryProperties.memoryHeaps[heapIndex].size;
+
+		// small heaps (BAR windows, some integrated parts) would be swallowed by a few default blocks
+		return std::min(DEFAULT_BLOCK_SIZE, heapSize / 8);
+	}
+
+	bool AppMemoryAllocator::IsHostVisible(const uint32_t memoryTypeIndex) const
+	{
+		return (_budget.MemoryProperties().memoryTypes[memoryTypeIndex].propertyFlags &
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+	}
+
+	VkDeviceMemory AppMemoryAllocator::AllocateDeviceMemory(const VkDeviceSize size, const uint32_t memoryTypeIndex,
+	                                                        void** mappedData)
+	{
+		*mappedData = nullptr;
+
+		if (_deviceAllocationCount >= _maxDeviceAllocations)
+			return VK_NULL_HANDLE;
+
+		// the budget is only queried once per frame, before giving up on the heap make sure it is current,
+		// other processes may have freed memory since
+		if (!_budget.CanAllocate(memoryTypeIndex, size))
+		{
+			_budget.Update();
+			if (!_budget.CanAllocate(memoryTypeIndex, size))
+				return VK_NULL_HANDLE;
+		}
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkDeviceMemory memory;
+		if (vkAllocateMemory(_device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+			return VK_NULL_HANDLE;
+
+		if (IsHostVisible(memoryTypeIndex) &&
+			vkMapMemory(_device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) != VK_SUCCESS)
+		{
+			vkFreeMemory(_device, memory, nullptr);
+			return VK_NULL_HANDLE;
+		}
+
+		_deviceAllocationCount++;
+		_budget.OnAllocate(memoryTypeIndex, size);
+		return memory;
+	}
+
+	void AppMemoryAllocator::FreeDeviceMemory(VkDeviceMemory memory, const VkDeviceSize size,
+	                                          const uint32_t memoryTypeIndex)
+	{
+		vkFreeMemory(_device, memory, nullptr);
+		_deviceAllocationCount--;
+		_budget.OnFree(memoryTypeIndex, size);
+	}
+
+	MemoryAllocation AppMemoryAllocator::Allocate(
+		const VkMemoryRequirements& requirements,
+		const VkMemoryPropertyFlags properties,
+		const bool optimalTiling,
+		const bool dedicated)
+	{
+		return AllocateFromTypes(requirements, _budget.FindMemoryTypes(requirements.memoryTypeBits, properties),
+		                         optimalTiling, dedicated);
+	}
+
+	MemoryAllocation AppMemoryAllocator::Allocate(
+		const VkMemoryRequirements& requirements,
+		const MemoryUsage usage,
+		const bool optimalTiling,
+		const bool dedicated)
+	{
+		return AllocateFromTypes(requirements, _budget.FindMemoryTypes(requirements.memoryTypeBits, usage),
+		                         optimalTiling, dedicated);
+	}
+
+	MemoryAllocation AppMemoryAllocator::AllocateFromTypes(
+		const VkMemoryRequirements& requirements,
+		const std::vector<uint32_t>& memoryTypes,
+		const bool optimalTiling,
+		const bool dedicated)
+	{
+		if (memoryTypes.empty())
+			throw std::runtime_error("failed to find suitable memory type!");
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		for (const uint32_t memoryTypeIndex : memoryTypes)
+		{
+			const VkDeviceSize blockSize = PreferredBlockSize(memoryTypeIndex);
+
+			MemoryAllocation allocation;
+			if (dedicated || requirements.size > blockSize / 2)
+			{
+				allocation.memory = AllocateDeviceMemory(requirements.size, memoryTypeIndex, &allocation.mappedData);
+				if (!allocation.IsValid())
+					continue;
+
+				allocation.offset = 0;
+				allocation.size = requirements.size;
+				allocation.memoryTypeIndex = memoryTypeIndex;
+
+				_dedicatedCount++;
+				_dedicatedBytes += requirements.size;
+				return allocation;
+			}
+
+			const uint32_t poolIndex = memoryTypeIndex * 2 + (optimalTiling ? 1 : 0);
+			auto& [blocks] = _pools[poolIndex];
+
+			for (const auto& block : blocks)
+			{
+				if (block->TryAllocate(requirements.size, requirements.alignment, allocation))
+					return allocation;
+			}
+
+			void* mappedData;
+			VkDeviceMemory memory = AllocateDeviceMemory(blockSize, memoryTypeIndex, &mappedData);
+			if (memory == VK_NULL_HANDLE)
+				continue;
+
+			blocks.push_back(std::make_unique<AppMemoryBlock>(
+				_device, memory, blockSize, memoryTypeIndex, poolIndex, mappedData));
+
+			if (blocks.back()->TryAllocate(requirements.size, requirements.alignment, allocation))
+				return allocation;
+		}
+
+		throw std::runtime_error("failed to allocate device memory in any suitable memory type!");
+	}
+
+	void AppMemoryAllocator::Free(MemoryAllocation& allocation)
+	{
+		if (!allocation.IsValid())
+			return;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (allocation.IsDedicated())
+		{
+			FreeDeviceMemory(allocation.memory, allocation.size, allocation.memoryTypeIndex);
+			_dedicatedCount--;
+			_dedicatedBytes -= allocation.size;
+			allocation = {};
+			return;
+		}
+
+		AppMemoryBlock* block = allocation.block;
+		block->Free(allocation);
+
+		// keep one empty block per pool around so load/unload cycles do not thrash vkAllocateMemory
+		if (block->Metadata().IsEmpty())
+		{
+			auto& [blocks] = _pools[block->PoolIndex()];
+
+			const auto emptyBlocks = std::count_if(blocks.begin(), blocks.end(),
+			                                       [](const auto& b) { return b->Metadata().IsEmpty(); });
+			if (emptyBlocks > 1)
+			{
+				_deviceAllocationCount--;
+				_budget.OnFree(block->MemoryTypeIndex(), block->Metadata().Size());
+				blocks.erase(std::find_if(blocks.begin(), blocks.end(),
+				                          [block](const auto& b) { return b.get() == block; }));
+			}
+		}
+
+		allocation = {};
+	}
+
+	MemoryAllocatorStats AppMemoryAllocator::GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		MemoryAllocatorStats stats;
+		for (const auto& [blocks] : _pools)
+		{
+			for (const auto& block : blocks)
+			{
+				const auto& metadata = block->Metadata();
+				stats.blockCount++;
+				stats.reservedBytes += metadata.Size();
+				stats.freeBytes += metadata.FreeBytes();
+				stats.usedBytes += metadata.Size() - metadata.FreeBytes();
+				stats.allocationCount += metadata.AllocationCount();
+				stats.freeRangeCount += metadata.FreeRangeCount();
+				stats.largestFreeRange = std::max(stats.largestFreeRange, metadata.LargestFreeRange());
+			}
+		}
+
+		stats.dedicatedCount = _dedicatedCount;
+		stats.dedicatedBytes = _dedicatedBytes;
+		stats.reservedBytes += _dedicatedBytes;
+		stats.usedBytes += _dedicatedBytes;
+		stats.allocationCount += _dedicatedCount;
+		stats.deviceAllocationCount = _deviceAllocationCount;
+		return stats;
+	}
+
+	void AppMemoryAllocator::PrintStats(std::ostream& out) const
+	{
+		const auto stats = GetStats();
+		constexpr double mib = 1024.0 * 1024.0;
+
+		out << "memory allocator:" << std::endl;
+		out << "\treserved: " << stats.reservedBytes / mib << " MiB in " << stats.blockCount << " blocks + "
+			<< stats.dedicatedCount << " dedicated" << std::endl;
+		out << "\tused: " << stats.usedBytes / mib << " MiB across " << stats.allocationCount << " allocations"
+			<< std::endl;
+		out << "\tfree: " << stats.freeBytes / mib << " MiB in " << stats.freeRangeCount << " ranges, largest "
+			<< stats.largestFreeRange / mib << " MiB" << std::endl;
+		out << "\tfragmentation: " << stats.Fragmentation() * 100.0f << "%" << std::endl;
+		out << "\tvkAllocateMemory objects: " << stats.deviceAllocationCount << " / " << _maxDeviceAllocations
+			<< std::endl;
+
+		_budget.PrintBudget(out);
+	}
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include "app_memory_budget.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Two level segregated fit free list over a single range of offsets.
+	// Knows nothing about Vulkan memory, it only hands out aligned sub-ranges.
+	class TlsfMetadata
+	{
+	public:
+		struct Node
+		{
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			Node* prevPhysical = nullptr;
+			Node* nextPhysical = nullptr;
+			Node* prevFree = nullptr;
+			Node* nextFree = nullptr;
+			bool isFree = true;
+		};
+
+		explicit TlsfMetadata(VkDeviceSize size);
+		~TlsfMetadata();
+
+		TlsfMetadata(const TlsfMetadata&) = delete;
+		TlsfMetadata& operator=(const TlsfMetadata&) = delete;
+
+		// returns nullptr when no free range can hold size bytes at the given alignment
+		Node* Allocate(VkDeviceSize size, VkDeviceSize alignment);
+		void Free(Node* node);
+
+		[[nodiscard]] VkDeviceSize Size() const { return _size; }
+		[[nodiscard]] VkDeviceSize FreeBytes() const { return _freeBytes; }
+		[[nodiscard]] VkDeviceSize LargestFreeRange() const;
+		[[nodiscard]] uint32_t AllocationCount() const { return _allocationCount; }
+		[[nodiscard]] uint32_t FreeRangeCount() const { return _freeRangeCount; }
+		[[nodiscard]] bool IsEmpty() const { return _allocationCount == 0; }
+
+	private:
+		static constexpr uint32_t SECOND_LEVEL_LOG2 = 4;
+		static constexpr uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_LOG2;
+		static constexpr uint32_t SMALL_SIZE_LOG2 = 8;
+		static constexpr VkDeviceSize SMALL_SIZE = 1ull << SMALL_SIZE_LOG2;
+		static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - SMALL_SIZE_LOG2 + 1;
+		// leftovers smaller than this stay attached to the allocation instead of becoming free ranges
+		static constexpr VkDeviceSize MIN_SPLIT_SIZE = 64;
+
+		static void MapSize(VkDeviceSize size, uint32_t& firstLevel, uint32_t& secondLevel);
+		Node* FindFreeNode(VkDeviceSize size) const;
+		void InsertFree(Node* node);
+		void RemoveFree(Node* node);
+
+		VkDeviceSize _size;
+		VkDeviceSize _freeBytes;
+		uint32_t _allocationCount = 0;
+		uint32_t _freeRangeCount = 0;
+
+		uint64_t _firstLevelBitmap = 0;
+		std::array<uint32_t, FIRST_LEVEL_COUNT> _secondLevelBitmaps{};
+		std::array<std::array<Node*, SECOND_LEVEL_COUNT>, FIRST_LEVEL_COUNT> _freeLists{};
+
+		Node* _firstPhysical = nullptr;
+	};
+
+	class AppMemoryBlock;
+
+	struct MemoryAllocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+
+		// persistently mapped pointer to offset, only set for host visible memory
+		void* mappedData = nullptr;
+
+		// null for dedicated allocations, which own memory outright
+		AppMemoryBlock* block = nullptr;
+		TlsfMetadata::Node* node = nullptr;
+
+		[[nodiscard]] bool IsValid() const { return memory != VK_NULL_HANDLE; }
+		[[nodiscard]] bool IsDedicated() const { return block == nullptr; }
+	};
+
+	struct MemoryAllocatorStats
+	{
+		VkDeviceSize reservedBytes = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize freeBytes = 0;
+		VkDeviceSize largestFreeRange = 0;
+		VkDeviceSize dedicatedBytes = 0;
+		uint32_t blockCount = 0;
+		uint32_t dedicatedCount = 0;
+		uint32_t allocationCount = 0;
+		uint32_t freeRangeCount = 0;
+
+		// vkAllocateMemory calls alive right now, the number checked against maxMemoryAllocationCount
+		uint32_t deviceAllocationCount = 0;
+
+		// 0 when all free space is one range, approaching 1 as it splinters
+		[[nodiscard]] float Fragmentation() const
+		{
+			return freeBytes == 0 ? 0.0f : 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+		}
+	};
+
+	// One VkDeviceMemory reserved up front and carved up by a TlsfMetadata
+	class AppMemoryBlock
+	{
+	public:
+		AppMemoryBlock(VkDevice device, VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex,
+		               uint32_t poolIndex, void* mappedData);
+		~AppMemoryBlock();
+
+		AppMemoryBlock(const AppMemoryBlock&) = delete;
+		AppMemoryBlock& operator=(const AppMemoryBlock&) = delete;
+
+		bool TryAllocate(VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation);
+		void Free(const MemoryAllocation& allocation);
+
+		[[nodiscard]] const TlsfMetadata& Metadata() const { return _metadata; }
+		[[nodiscard]] VkDeviceMemory Memory() const { return _memory; }
+		[[nodiscard]] uint32_t MemoryTypeIndex() const { return _memoryTypeIndex; }
+		[[nodiscard]] uint32_t PoolIndex() const { return _poolIndex; }
+
+	private:
+		VkDevice _device;
+		VkDeviceMemory _memory;
+		uint32_t _memoryTypeIndex;
+		uint32_t _poolIndex;
+		void* _mappedData;
+		TlsfMetadata _metadata;
+	};
+
+	// Reserves large blocks per memory type and sub-allocates resources out of them.
+	// Buffers and optimally tiled images live in separate pools so bufferImageGranularity never matters.
+	// Memory types are tried in the budget's order of preference, a full or over budget heap falls
+	// through to the next suitable type.
+	class AppMemoryAllocator
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+		AppMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, AppMemoryBudget& budget);
+		~AppMemoryAllocator();
+
+		AppMemoryAllocator(const AppMemoryAllocator&) = delete;
+		AppMemoryAllocator& operator=(const AppMemoryAllocator&) = delete;
+
+		// dedicated forces a VkDeviceMemory of its own, large requests get one regardless
+		MemoryAllocation Allocate(
+			const VkMemoryRequirements& requirements,
+			VkMemoryPropertyFlags properties,
+			bool optimalTiling,
+			bool dedicated = false);
+		MemoryAllocation Allocate(
+			const VkMemoryRequirements& requirements,
+			MemoryUsage usage,
+			bool optimalTiling,
+			bool dedicated = false);
+		void Free(MemoryAllocation& allocation);
+
+		[[nodiscard]] MemoryAllocatorStats GetStats() const;
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		struct BlockPool
+		{
+			std::vector<std::unique_ptr<AppMemoryBlock>> blocks;
+		};
+
+		MemoryAllocation AllocateFromTypes(
+			const VkMemoryRequirements& requirements,
+			const std::vector<uint32_t>& memoryTypes,
+			bool optimalTiling,
+			bool dedicated);
+		[[nodiscard]] VkDeviceSize PreferredBlockSize(uint32_t memoryTypeIndex) const;
+		[[nodiscard]] bool IsHostVisible(uint32_t memoryTypeIndex) const;
+		// VK_NULL_HANDLE when the heap is over budget or the driver refuses, so the caller can fall back
+		VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData);
+		void FreeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex);
+
+		VkDevice _device;
+		AppMemoryBudget& _budget;
+		uint32_t _maxDeviceAllocations = 0;
+
+		// index = memoryTypeIndex * 2 + (optimalTiling ? 1 : 0)
+		std::vector<BlockPool> _pools;
+
+		uint32_t _deviceAllocationCount = 0;
+		uint32_t _dedicatedCount = 0;
+		VkDeviceSize _dedicatedBytes = 0;
+
+		mutable std::mutex _mutex;
+	};
+}
@@ -0,0 +1,239 @@
+#include "app_memory_budget.hpp"
+
+#include <algorithm>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		constexpr VkDeviceSize BAR_WINDOW_SIZE = 256ull * 1024 * 1024;
+	}
+
+	AppMemoryBudget::AppMemoryBudget(VkPhysicalDevice physicalDevice, const bool memoryBudgetExtension)
+		: _physicalDevice{physicalDevice}, _memoryBudgetExtension{memoryBudgetExtension}
+	{
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &_memoryProperties);
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+		// UMA: every device local heap can also be mapped by the cpu
+		bool everyLocalHeapMappable = true;
+		for (uint32_t heap = 0; heap < _memoryProperties.memoryHeapCount; heap++)
+		{
+			auto& [size, budget, usage, allocated, deviceLocal] = _heaps[heap];
+			size = _memoryProperties.memoryHeaps[heap].size;
+			deviceLocal = (_memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+
+			// without the extension, leave headroom for other processes and the driver itself
+			budget = size * 8 / 10;
+
+			if (!deviceLocal)
+				continue;
+
+			bool mappable = false;
+			for (uint32_t type = 0; type < _memoryProperties.memoryTypeCount; type++)
+			{
+				if (HeapIndex(type) == heap && (TypeFlags(type) & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+					mappable = true;
+			}
+			everyLocalHeapMappable = everyLocalHeapMappable && mappable;
+		}
+
+		_unifiedMemory = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ||
+			properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU || everyLocalHeapMappable;
+
+		// ReBAR: host visible vram bigger than the legacy 256 MiB window
+		for (uint32_t type = 0; type < _memoryProperties.memoryTypeCount; type++)
+		{
+			constexpr VkMemoryPropertyFlags barFlags =
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			if ((TypeFlags(type) & barFlags) == barFlags &&
+				_memoryProperties.memoryHeaps[HeapIndex(type)].size > BAR_WINDOW_SIZE)
+				_resizableBar = true;
+		}
+
+		Update();
+	}
+
+	int AppMemoryBudget::ScoreForUsage(const uint32_t memoryTypeIndex, const MemoryUsage usage) const
+	{
+		const VkMemoryPropertyFlags flags = TypeFlags(memoryTypeIndex);
+
+		// protected and lazily allocated types only make sense when asked for by flag
+		if (flags & (VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+			return -1;
+
+		const bool deviceLocal = flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		const bool hostVisible = flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		const bool hostCoherent = flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		const bool hostCached = flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+		int score = 0;
+		switch (usage)
+		{
+		case MemoryUsage::GpuOnly:
+			// system memory is still a valid last resort when vram is exhausted
+			score += deviceLocal ? 100 : 0;
+			// leave the mappable vram to resources that need it
+			score += hostVisible && !_unifiedMemory ? 0 : 20;
+			break;
+
+		case MemoryUsage::Upload:
+			if (!hostVisible || !hostCoherent)
+				return -1;
+			// staging should not eat into a small BAR window
+			score += !deviceLocal || _unifiedMemory ? 50 : 0;
+			score += hostCached ? 0 : 10;
+			break;
+
+		case MemoryUsage::Readback:
+			if (!hostVisible)
+				return -1;
+			score += hostCached ? 50 : 0;
+			score += hostCoherent ? 20 : 0;
+			score += deviceLocal && !_unifiedMemory ? 0 : 10;
+			break;
+
+		case MemoryUsage::HostVisibleDeviceLocal:
+			if (!hostVisible || !hostCoherent)
+				return -1;
+			score += deviceLocal ? 100 : 0;
+			score += hostCached ? 0 : 10;
+			break;
+		}
+
+		return score;
+	}
+
+	std::vector<uint32_t> AppMemoryBudget::FindMemoryTypes(const uint32_t typeFilter, const MemoryUsage usage) const
+	{
+		std::vector<std::pair<int, uint32_t>> scored;
+		for (uint32_t i = 0; i < _memoryProperties.memoryTypeCount; i++)
+		{
+			if (!(typeFilter & (1 << i)))
+				continue;
+
+			if (const int score = ScoreForUsage(i, usage); score >= 0)
+				scored.emplace_back(score, i);
+		}
+
+		std::stable_sort(scored.begin(), scored.end(),
+		                 [](const auto& a, const auto& b) { return a.first > b.first; });
+
+		std::vector<uint32_t> types;
+		types.reserve(scored.size());
+		for (const auto& [score, type] : scored)
+			types.push_back(type);
+
+		return types;
+	}
+
+	std::vector<uint32_t> AppMemoryBudget::FindMemoryTypes(
+		const uint32_t typeFilter, const VkMemoryPropertyFlags required) const
+	{
+		std::vector<std::pair<int, uint32_t>> scored;
+		for (uint32_t i = 0; i < _memoryProperties.memoryTypeCount; i++)
+		{
+			if (!(typeFilter & (1 << i)) || (TypeFlags(i) & required) != required)
+				continue;
+
+			// the fewer properties beyond the ones asked for, the less contended the type usually is
+			int extraFlags = 0;
+			for (VkMemoryPropertyFlags extra = TypeFlags(i) & ~required; extra != 0; extra &= extra - 1)
+				extraFlags++;
+
+			scored.emplace_back(-extraFlags, i);
+		}
+
+		std::stable_sort(scored.begin(), scored.end(),
+		                 [](const auto& a, const auto& b) { return a.first > b.first; });
+
+		std::vector<uint32_t> types;
+		types.reserve(scored.size());
+		for (const auto& [score, type] : scored)
+			types.push_back(type);
+
+		return types;
+	}
+
+	bool AppMemoryBudget::CanAllocate(const uint32_t memoryTypeIndex, const VkDeviceSize size) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		const uint32_t heap = HeapIndex(memoryTypeIndex);
+		const auto& heapBudget = _heaps[heap];
+
+		VkDeviceSize usage = heapBudget.usage;
+		if (_memoryBudgetExtension && heapBudget.allocated > _allocatedAtUpdate[heap])
+			usage += heapBudget.allocated - _allocatedAtUpdate[heap];
+
+		return usage + size <= heapBudget.budget;
+	}
+
+	void AppMemoryBudget::OnAllocate(const uint32_t memoryTypeIndex, const VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto& heapBudget = _heaps[HeapIndex(memoryTypeIndex)];
+		heapBudget.allocated += size;
+		if (!_memoryBudgetExtension)
+			heapBudget.usage = heapBudget.allocated;
+	}
+
+	void AppMemoryBudget::OnFree(const uint32_t memoryTypeIndex, const VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto& heapBudget = _heaps[HeapIndex(memoryTypeIndex)];
+		heapBudget.allocated -= std::min(size, heapBudget.allocated);
+		if (!_memoryBudgetExtension)
+			heapBudget.usage = heapBudget.allocated;
+	}
+
+	void AppMemoryBudget::Update()
+	{
+		if (!_memoryBudgetExtension)
+			return;
+
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+
+		vkGetPhysicalDeviceMemoryProperties2(_physicalDevice, &memoryProperties2);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (uint32_t heap = 0; heap < _memoryProperties.memoryHeapCount; heap++)
+		{
+			_heaps[heap].budget = budgetProperties.heapBudget[heap];
+			_heaps[heap].usage = budgetProperties.heapUsage[heap];
+			_allocatedAtUpdate[heap] = _heaps[heap].allocated;
+		}
+	}
+
+	HeapBudget AppMemoryBudget::GetHeapBudget(const uint32_t heapIndex) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _heaps[heapIndex];
+	}
+
+	void AppMemoryBudget::PrintBudget(std::ostream& out) const
+	{
+		constexpr double mib = 1024.0 * 1024.0;
+
+		out << "memory budget (" << (_memoryBudgetExtension ? "VK_EXT_memory_budget" : "estimated")
+			<< (_unifiedMemory ? ", unified memory" : "") << (_resizableBar ? ", resizable BAR" : "") << "):"
+			<< std::endl;
+
+		for (uint32_t heap = 0; heap < _memoryProperties.memoryHeapCount; heap++)
+		{
+			const auto [size, budget, usage, allocated, deviceLocal] = GetHeapBudget(heap);
+			out << "\theap " << heap << (deviceLocal ? " (device local)" : "") << ": " << allocated / mib
+				<< " MiB allocated, " << usage / mib << " / " << budget / mib << " MiB budget of "
+				<< size / mib << " MiB" << std::endl;
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// What a resource is for, placement picks the memory type from this instead of raw property flags
+	enum class MemoryUsage
+	{
+		GpuOnly, // device local, never touched by the cpu
+		Upload, // cpu writes once, gpu reads (staging)
+		Readback, // gpu writes, cpu reads
+		HostVisibleDeviceLocal // cpu writes every frame straight into vram, UMA or ReBAR
+	};
+
+	struct HeapBudget
+	{
+		VkDeviceSize size = 0;
+		VkDeviceSize budget = 0;
+		// process wide usage as reported by the driver, or our own total without VK_EXT_memory_budget
+		VkDeviceSize usage = 0;
+		// bytes this allocator holds in vkAllocateMemory objects on the heap
+		VkDeviceSize allocated = 0;
+		bool deviceLocal = false;
+	};
+
+	// Caches memory properties at device creation and tracks how full each heap is
+	class AppMemoryBudget
+	{
+	public:
+		AppMemoryBudget(VkPhysicalDevice physicalDevice, bool memoryBudgetExtension);
+
+		AppMemoryBudget(const AppMemoryBudget&) = delete;
+		AppMemoryBudget& operator=(const AppMemoryBudget&) = delete;
+
+		[[nodiscard]] const VkPhysicalDeviceMemoryProperties& MemoryProperties() const { return _memoryProperties; }
+		[[nodiscard]] bool IsUnifiedMemory() const { return _unifiedMemory; }
+		[[nodiscard]] bool HasResizableBar() const { return _resizableBar; }
+		[[nodiscard]] bool UsesMemoryBudgetExtension() const { return _memoryBudgetExtension; }
+
+		// Every memory type that can hold the resource, best placement first. Empty if nothing fits.
+		[[nodiscard]] std::vector<uint32_t> FindMemoryTypes(uint32_t typeFilter, MemoryUsage usage) const;
+		[[nodiscard]] std::vector<uint32_t> FindMemoryTypes(uint32_t typeFilter, VkMemoryPropertyFlags required) const;
+
+		// true if a new vkAllocateMemory of this size should still fit in the heap's budget, our own allocations
+		// since the last Update count on top of the usage it reported
+		[[nodiscard]] bool CanAllocate(uint32_t memoryTypeIndex, VkDeviceSize size) const;
+		void OnAllocate(uint32_t memoryTypeIndex, VkDeviceSize size);
+		void OnFree(uint32_t memoryTypeIndex, VkDeviceSize size);
+
+		// re-queries VK_EXT_memory_budget, a no-op without it. a driver call, meant for once per frame and when
+		// an allocation would not fit, never for every allocation
+		void Update();
+
+		[[nodiscard]] HeapBudget GetHeapBudget(uint32_t heapIndex) const;
+		void PrintBudget(std::ostream& out) const;
+
+	private:
+		[[nodiscard]] uint32_t HeapIndex(uint32_t memoryTypeIndex) const
+		{
+			return _memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+		}
+
+		[[nodiscard]] VkMemoryPropertyFlags TypeFlags(uint32_t memoryTypeIndex) const
+		{
+			return _memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+		}
+
+		[[nodiscard]] int ScoreForUsage(uint32_t memoryTypeIndex, MemoryUsage usage) const;
+
+		VkPhysicalDevice _physicalDevice;
+		VkPhysicalDeviceMemoryProperties _memoryProperties{};
+		bool _memoryBudgetExtension;
+		bool _unifiedMemory = false;
+		bool _resizableBar = false;
+
+		std::array<HeapBudget, VK_MAX_MEMORY_HEAPS> _heaps{};
+		// allocated bytes at the last driver query, so usage can be extrapolated between queries
+		std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> _allocatedAtUpdate{};
+
+		mutable std::mutex _mutex;
+	};
+}
@@ -0,0 +1,269 @@
+#include "app_mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		// streams and indices start at this alignment, enough for every vertex format and index type
+		constexpr VkDeviceSize STREAM_ALIGNMENT = 16;
+		constexpr float PI = 3.14159265358979f;
+
+		VkDeviceSize Align(const VkDeviceSize value, const VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		template <typename T, size_t N>
+		void Write(uint8_t* destination, const std::array<T, N>& values)
+		{
+			std::memcpy(destination, values.data(), sizeof(T) * N);
+		}
+	}
+
+	MeshData MeshData::Torus(const uint32_t rings, const uint32_t segments, const float majorRadius,
+	                         const float minorRadius)
+	{
+		// the seams get their own vertices so the uvs can reach 1
+		MeshData mesh;
+		for (uint32_t ring = 0; ring <= rings; ring++)
+		{
+			const float u = static_cast<float>(ring) / static_cast<float>(rings);
+			const float cosU = std::cos(2.0f * PI * u);
+			const float sinU = std::sin(2.0f * PI * u);
+			for (uint32_t segment = 0; segment <= segments; segment++)
+			{
+				const float v = static_cast<float>(segment) / static_cast<float>(segments);
+				const float cosV = std::cos(2.0f * PI * v);
+				const float sinV = std::sin(2.0f * PI * v);
+				const float distance = majorRadius + minorRadius * cosV;
+
+				mesh.positions.push_back({distance * cosU, distance * sinU, minorRadius * sinV});
+				mesh.normals.push_back({cosV * cosU, cosV * sinU, sinV});
+				mesh.tangents.push_back({-sinU, cosU, 0.0f, 1.0f});
+				mesh.texCoords.push_back({u, v});
+			}
+		}
+
+		for (uint32_t ring = 0; ring < rings; ring++)
+		{
+			for (uint32_t segment = 0; segment < segments; segment++)
+			{
+				const uint32_t a = ring * (segments + 1) + segment;
+				const uint32_t b = a + segments + 1;
+				mesh.indices.insert(mesh.indices.end(), {a, b, a + 1, a + 1, b, b + 1});
+			}
+		}
+		return mesh;
+	}
+
+	AppMesh::AppMesh(AppDevice& device, const MeshData& data, const MeshFormat& format)
+		: _device{device}, _format{format}, _layout{VertexLayout::Create(format)}
+	{
+		const size_t vertexCount = data.positions.size();
+		if (vertexCount == 0)
+			throw std::runtime_error("failed to create mesh, it has no vertices!");
+		if (data.normals.size() != vertexCount || data.tangents.size() != vertexCount ||
+			data.texCoords.size() != vertexCount)
+			throw std::runtime_error("failed to create mesh, attributes differ in vertex count!");
+		for (const uint32_t index : data.indices)
+		{
+			if (index >= vertexCount)
+				throw std::runtime_error("failed to create mesh, index out of range!");
+		}
+
+		for (const auto& attribute : _layout.attributes)
+		{
+			VkFormatProperties properties;
+			vkGetPhysicalDeviceFormatProperties(_device.GetPhysicalDevice(), attribute.format, &properties);
+			if ((properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) == 0)
+				throw std::runtime_error(std::string("failed to create mesh, ") + _format.Name() +
+				                         " vertices are not supported as vertex input!");
+		}
+
+		_vertexCount = static_cast<uint32_t>(vertexCount);
+		_indexCount = static_cast<uint32_t>(data.indices.size());
+		ComputeDequantization(data);
+
+		VkDeviceSize size = 0;
+		for (const auto& binding : _layout.bindings)
+		{
+			size = Align(size, STREAM_ALIGNMENT);
+			_binding.vertexOffsets[binding.binding] = size;
+			size += static_cast<VkDeviceSize>(binding.stride) * _vertexCount;
+			_vertexBytes += static_cast<VkDeviceSize>(binding.stride) * _vertexCount;
+		}
+		_binding.vertexStreamCount = static_cast<uint32_t>(_layout.bindings.size());
+
+		// every vertex reachable with 16 bits halves the index buffer
+		_binding.indexType = _vertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+		_binding.indexOffset = Align(size, STREAM_ALIGNMENT);
+		_indexBytes = static_cast<VkDeviceSize>(_indexCount) * (_binding.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4);
+		size = _binding.indexOffset + _indexBytes;
+
+		const std::vector<uint8_t> bytes = Encode(data);
+
+		_device.CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+		                     VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GpuOnly, _buffer, _memory);
+		for (uint32_t stream = 0; stream < _binding.vertexStreamCount; stream++)
+			_binding.vertexBuffers[stream] = _buffer;
+		if (_indexCount > 0)
+			_binding.indexBuffer = _buffer;
+
+		// one copy so the buffer is released to the graphics queue once, a mesh too large for the upload ring
+		// gets a staging buffer of its own
+		AppUploadQueue& uploads = _device.UploadQueue();
+		uploads.Wait(uploads.UploadBuffer(_buffer, 0, bytes.data(), size));
+	}
+
+	AppMesh::~AppMesh()
+	{
+		_device.DestroyBuffer(_buffer, _memory);
+	}
+
+	void AppMesh::ComputeDequantization(const MeshData& data)
+	{
+		std::array<float, 3> min = data.positions[0];
+		std::array<float, 3> max = data.positions[0];
+		for (const auto& position : data.positions)
+		{
+			for (size_t i = 0; i < 3; i++)
+			{
+				min[i] = std::min(min[i], position[i]);
+				max[i] = std::max(max[i], position[i]);
+			}
+		}
+
+		// snorm spends its whole range on the bounds, half only needs the center taken out to stay precise
+		if (_format.position != PositionEncoding::Float32)
+		{
+			for (size_t i = 0; i < 3; i++)
+			{
+				_positionOffset[i] = (min[i] + max[i]) * 0.5f;
+				const float extent = (max[i] - min[i]) * 0.5f;
+				if (_format.position == PositionEncoding::Snorm16 && extent > 0.0f)
+					_positionScale[i] = extent;
+			}
+		}
+
+		if (_format.texCoord == TexCoordEncoding::Unorm16)
+		{
+			std::array<float, 2> uvMin = data.texCoords[0];
+			std::array<float, 2> uvMax = data.texCoords[0];
+			for (const auto& texCoord : data.texCoords)
+			{
+				for (size_t i = 0; i < 2; i++)
+				{
+					uvMin[i] = std::min(uvMin[i], texCoord[i]);
+					uvMax[i] = std::max(uvMax[i], texCoord[i]);
+				}
+			}
+			for (size_t i = 0; i < 2; i++)
+			{
+				_texCoordTransform[i] = uvMax[i] > uvMin[i] ? uvMax[i] - uvMin[i] : 1.0f;
+				_texCoordTransform[2 + i] = uvMin[i];
+			}
+		}
+	}
+
+	std::vector<uint8_t> AppMesh::Encode(const MeshData& data) const
+	{
+		std::vector<uint8_t> bytes(static_cast<size_t>(_binding.indexOffset + _indexBytes));
+
+		const auto destination = [&](const MeshAttribute attribute, const size_t vertex)
+		{
+			const VkVertexInputAttributeDescription& description = _layout.Attribute(attribute);
+			return bytes.data() + _binding.vertexOffsets[description.binding] + vertex * _layout.Stride(attribute) +
+				description.offset;
+		};
+
+		for (size_t vertex = 0; vertex < _vertexCount; vertex++)
+		{
+			const std::array<float, 3>& position = data.positions[vertex];
+			const std::array<float, 4>& tangent = data.tangents[vertex];
+			const float sign = tangent[3] < 0.0f ? -1.0f : 1.0f;
+
+			uint8_t* positionBytes = destination(ATTRIBUTE_POSITION, vertex);
+			switch (_format.position)
+			{
+			case PositionEncoding::Float32:
+				Write(positionBytes, position);
+				break;
+			case PositionEncoding::Float16:
+				Write(positionBytes, std::array<uint16_t, 4>{
+					      FloatToHalf(position[0] - _positionOffset[0]), FloatToHalf(position[1] - _positionOffset[1]),
+					      FloatToHalf(position[2] - _positionOffset[2]), FloatToHalf(sign)
+				      });
+				break;
+			case PositionEncoding::Snorm16:
+				Write(positionBytes, std::array<int16_t, 4>{
+					      FloatToSnorm16((position[0] - _positionOffset[0]) / _positionScale[0]),
+					      FloatToSnorm16((position[1] - _positionOffset[1]) / _positionScale[1]),
+					      FloatToSnorm16((position[2] - _positionOffset[2]) / _positionScale[2]), FloatToSnorm16(sign)
+				      });
+				break;
+			}
+
+			if (_format.direction == DirectionEncoding::Oct16)
+			{
+				const std::array<float, 2> normal = OctEncode(data.normals[vertex]);
+				const std::array<float, 2> tangentDirection = OctEncode({tangent[0], tangent[1], tangent[2]});
+				Write(destination(ATTRIBUTE_NORMAL, vertex),
+				      std::array<int16_t, 2>{FloatToSnorm16(normal[0]), FloatToSnorm16(normal[1])});
+				Write(destination(ATTRIBUTE_TANGENT, vertex),
+				      std::array<int16_t, 2>{FloatToSnorm16(tangentDirection[0]), FloatToSnorm16(tangentDirection[1])});
+			}
+			else
+			{
+				Write(destination(ATTRIBUTE_NORMAL, vertex), data.normals[vertex]);
+				Write(destination(ATTRIBUTE_TANGENT, vertex), tangent);
+			}
+
+			const std::array<float, 2>& texCoord = data.texCoords[vertex];
+			if (_format.texCoord == TexCoordEncoding::Unorm16)
+			{
+				Write(destination(ATTRIBUTE_TEXCOORD, vertex), std::array<uint16_t, 2>{
+					      FloatToUnorm16((texCoord[0] - _texCoordTransform[2]) / _texCoordTransform[0]),
+					      FloatToUnorm16((texCoord[1] - _texCoordTransform[3]) / _texCoordTransform[1])
+				      });
+			}
+			else
+				Write(destination(ATTRIBUTE_TEXCOORD, vertex), texCoord);
+		}
+
+		uint8_t* indexBytes = bytes.data() + _binding.indexOffset;
+		for (size_t i = 0; i < _indexCount; i++)
+		{
+			if (_binding.indexType == VK_INDEX_TYPE_UINT16)
+				Write(indexBytes + i * 2, std::array<uint16_t, 1>{static_cast<uint16_t>(data.indices[i])});
+			else
+				Write(indexBytes + i * 4, std::array<uint32_t, 1>{data.indices[i]});
+		}
+		return bytes;
+	}
+
+	void AppMesh::FillConstants(MeshDrawConstants& constants) const
+	{
+		constants.positionScale = _positionScale;
+		constants.positionOffset = _positionOffset;
+		constants.texCoordTransform = _texCoordTransform;
+	}
+
+	void AppMesh::PrintStats(std::ostream& out) const
+	{
+		// against the same mesh in float32 with 32 bit indices
+		const VkDeviceSize floatBytes = static_cast<VkDeviceSize>(MeshFormat::Float32().VertexSize()) * _vertexCount +
+			static_cast<VkDeviceSize>(_indexCount) * 4;
+		const VkDeviceSize bytes = _vertexBytes + _indexBytes;
+		out << "mesh format=" << _format.Name() << " split_streams=" << (_format.splitStreams ? 1 : 0)
+			<< " vertices=" << _vertexCount << " indices=" << _indexCount
+			<< " index_bits=" << (_binding.indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32)
+			<< " vertex_stride=" << _format.VertexSize() << " vertex_bytes=" << _vertexBytes
+			<< " index_bytes=" << _indexBytes << " float32_bytes=" << floatBytes
+			<< " ratio=" << static_cast<double>(bytes) / static_cast<double>(floatBytes) << std::endl;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "app_device.hpp"
+#include "app_render_queue.hpp"
+#include "app_vertex_format.hpp"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Vertices as loaded, one float array per attribute, every attribute present for every vertex
+	struct MeshData
+	{
+		std::vector<std::array<float, 3>> positions;
+		std::vector<std::array<float, 3>> normals;
+		// w is the bitangent sign
+		std::vector<std::array<float, 4>> tangents;
+		std::vector<std::array<float, 2>> texCoords;
+		std::vector<uint32_t> indices;
+
+		// a torus around the z axis with uvs wrapping once each way, for testing without asset loading
+		static MeshData Torus(uint32_t rings, uint32_t segments, float majorRadius, float minorRadius);
+	};
+
+	// mesh.vert's push constant block. transform is the draw's, the rest is the mesh's dequantization
+	struct MeshDrawConstants
+	{
+		// column major, object to clip space
+		std::array<float, 16> transform{
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		};
+		// position = positionOffset + positionScale * stored
+		std::array<float, 4> positionScale{1.0f, 1.0f, 1.0f, 0.0f};
+		std::array<float, 4> positionOffset{};
+		// uv = stored * xy + zw
+		std::array<float, 4> texCoordTransform{1.0f, 1.0f, 0.0f, 0.0f};
+	};
+
+	// Vertex streams and indices of one mesh in a single device local buffer, encoded in the mesh's format.
+	// Indices are 16 bit when every vertex can be reached with them. The draw has to bind a pipeline made
+	// with Layout() and push the constants FillConstants filled.
+	class AppMesh
+	{
+	public:
+		// encodes and uploads through the upload queue and waits, meant for load time
+		AppMesh(AppDevice& device, const MeshData& data, const MeshFormat& format);
+		~AppMesh();
+
+		AppMesh(const AppMesh&) = delete;
+		AppMesh& operator=(const AppMesh&) = delete;
+
+		[[nodiscard]] const MeshBinding& Binding() const { return _binding; }
+		[[nodiscard]] const MeshFormat& Format() const { return _format; }
+		[[nodiscard]] const VertexLayout& Layout() const { return _layout; }
+		[[nodiscard]] uint32_t VertexCount() const { return _vertexCount; }
+		[[nodiscard]] uint32_t IndexCount() const { return _indexCount; }
+		[[nodiscard]] VkDeviceSize VertexBytes() const { return _vertexBytes; }
+		[[nodiscard]] VkDeviceSize IndexBytes() const { return _indexBytes; }
+
+		// sets everything but the transform
+		void FillConstants(MeshDrawConstants& constants) const;
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		// fills the scale and offset the encoded attributes are relative to
+		void ComputeDequantization(const MeshData& data);
+		// the bytes of every stream at the offsets in _binding, then the indices
+		[[nodiscard]] std::vector<uint8_t> Encode(const MeshData& data) const;
+
+		AppDevice& _device;
+		MeshFormat _format;
+		VertexLayout _layout;
+		MeshBinding _binding{};
+		uint32_t _vertexCount = 0;
+		uint32_t _indexCount = 0;
+		VkDeviceSize _vertexBytes = 0;
+		VkDeviceSize _indexBytes = 0;
+
+		std::array<float, 4> _positionScale{1.0f, 1.0f, 1.0f, 0.0f};
+		std::array<float, 4> _positionOffset{};
+		std::array<float, 4> _texCoordTransform{1.0f, 1.0f, 0.0f, 0.0f};
+
+		VkBuffer _buffer = VK_NULL_HANDLE;
+		MemoryAllocation _memory{};
+	};
+}
@@ -0,0 +1,324 @@
+#include "app_occlusion_culling.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		// push constant block of occlusion_cull.comp
+		struct OcclusionConstants
+		{
+			std::array<float, 16> viewProjection;
+			std::array<int32_t, 2> hizSize;
+			uint32_t hizLevels;
+			uint32_t objectCount;
+		};
+
+		// Counters in occlusion_cull.comp, padded to 16 bytes
+		struct Counters
+		{
+			uint32_t drawCount;
+			uint32_t frustumCulled;
+			uint32_t occluded;
+			uint32_t padding;
+		};
+
+		constexpr VkDeviceSize DRAW_STRIDE = sizeof(VkDrawIndexedIndirectCommand);
+		constexpr uint32_t STORAGE_BINDINGS = 4;
+	}
+
+	AppOcclusionCulling::AppOcclusionCulling(AppDevice& device, AppPipelineLayoutCache& layoutCache,
+	                                         const uint32_t maxObjects, const uint32_t framesInFlight)
+		: _device{device}, _drawPath{AppGpuCulling::ChooseDrawPath(device)}, _maxObjects{maxObjects}
+	{
+		if (maxObjects == 0)
+			throw std::runtime_error("occlusion culling needs room for at least one object!");
+
+		for (uint32_t phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			SpecializationConstants constants;
+			constants.Set(0, _drawPath == AppGpuCulling::DrawPath::IndirectCount ? VK_TRUE : VK_FALSE);
+			constants.Set(1, phase == PHASE_LATE ? VK_TRUE : VK_FALSE);
+			_pipelines[phase] = std::make_unique<AppComputePipeline>(
+				_device, layoutCache, std::string(SHADER_PATH), &constants);
+		}
+		_pyramid = std::make_unique<AppHiZPyramid>(_device, layoutCache, framesInFlight);
+
+		_device.CreateBuffer(maxObjects * sizeof(GpuObject),
+		                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                     MemoryUsage::GpuOnly, _objectBuffer, _objectMemory);
+		_device.CreateBuffer(maxObjects * sizeof(uint32_t),
+		                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                     MemoryUsage::GpuOnly, _visibilityBuffer, _visibilityMemory);
+		for (uint32_t phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			_device.CreateBuffer(maxObjects * DRAW_STRIDE,
+			                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			                     MemoryUsage::GpuOnly, _drawBuffers[phase], _drawMemory[phase]);
+			_device.CreateBuffer(sizeof(Counters),
+			                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+			                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			                     MemoryUsage::GpuOnly, _counterBuffers[phase], _counterMemory[phase]);
+		}
+
+		_readbackBuffers.resize(framesInFlight);
+		_readbackMemory.resize(framesInFlight);
+		_readbackPending.assign(framesInFlight, false);
+		for (uint32_t i = 0; i < framesInFlight; i++)
+		{
+			_device.CreateBuffer(PHASE_COUNT * sizeof(Counters), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			                     MemoryUsage::Readback, _readbackBuffers[i], _readbackMemory[i]);
+		}
+
+		CreateDescriptorSets();
+	}
+
+	AppOcclusionCulling::~AppOcclusionCulling()
+	{
+		vkDestroyDescriptorPool(_device.Device(), _descriptorPool, nullptr);
+		for (size_t i = 0; i < _readbackBuffers.size(); i++)
+			_device.DestroyBuffer(_readbackBuffers[i], _readbackMemory[i]);
+		for (uint32_t phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			_device.DestroyBuffer(_counterBuffers[phase], _counterMemory[phase]);
+			_device.DestroyBuffer(_drawBuffers[phase], _drawMemory[phase]);
+		}
+		_device.DestroyBuffer(_visibilityBuffer, _visibilityMemory);
+		_device.DestroyBuffer(_objectBuffer, _objectMemory);
+	}
+
+	void AppOcclusionCulling::CreateDescriptorSets()
+	{
+		const auto frames = static_cast<uint32_t>(_readbackBuffers.size());
+		const uint32_t setCount = frames * PHASE_COUNT;
+		const std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, setCount * STORAGE_BINDINGS},
+			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount}
+		}};
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = setCount;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(_device.Device(), &poolInfo, nullptr, &_descriptorPool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create occlusion descriptor pool!");
+
+		_descriptorSets.resize(frames);
+		_boundPyramids.assign(frames, VK_NULL_HANDLE);
+		for (uint32_t frame = 0; frame < frames; frame++)
+		{
+			for (uint32_t phase = 0; phase < PHASE_COUNT; phase++)
+			{
+				const VkDescriptorSetLayout setLayout = _pipelines[phase]->SetLayout(0);
+				VkDescriptorSetAllocateInfo allocInfo{};
+				allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+				allocInfo.descriptorPool = _descriptorPool;
+				allocInfo.descriptorSetCount = 1;
+				allocInfo.pSetLayouts = &setLayout;
+				if (vkAllocateDescriptorSets(_device.Device(), &allocInfo, &_descriptorSets[frame][phase]) != VK_SUCCESS)
+					throw std::runtime_error("failed to allocate occlusion descriptor set!");
+
+				// buffer bindings as declared in occlusion_cull.comp, the pyramid follows on the first frame
+				const std::array<VkDescriptorBufferInfo, STORAGE_BINDINGS> bufferInfos = {{
+					{_objectBuffer, 0, VK_WHOLE_SIZE},
+					{_visibilityBuffer, 0, VK_WHOLE_SIZE},
+					{_drawBuffers[phase], 0, VK_WHOLE_SIZE},
+					{_counterBuffers[phase], 0, VK_WHOLE_SIZE}
+				}};
+				std::array<VkWriteDescriptorSet, STORAGE_BINDINGS> writes{};
+				for (uint32_t i = 0; i < writes.size(); i++)
+				{
+					writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					writes[i].dstSet = _descriptorSets[frame][phase];
+					writes[i].dstBinding = i;
+					writes[i].descriptorCount = 1;
+					writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+					writes[i].pBufferInfo = &bufferInfos[i];
+				}
+				vkUpdateDescriptorSets(_device.Device(), static_cast<uint32_t>(writes.size()), writes.data(), 0,
+				                       nullptr);
+			}
+		}
+	}
+
+	void AppOcclusionCulling::UpdatePyramidBinding(const uint32_t frame)
+	{
+		if (_boundPyramids.at(frame) == _pyramid->View())
+			return;
+
+		// both phases declare it, the early one never reads it
+		const VkDescriptorImageInfo imageInfo{_pyramid->Sampler(), _pyramid->View(), VK_IMAGE_LAYOUT_GENERAL};
+		std::array<VkWriteDescriptorSet, PHASE_COUNT> writes{};
+		for (uint32_t phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			writes[phase].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[phase].dstSet = _descriptorSets[frame][phase];
+			writes[phase].dstBinding = STORAGE_BINDINGS;
+			writes[phase].descriptorCount = 1;
+			writes[phase].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writes[phase].pImageInfo = &imageInfo;
+		}
+		vkUpdateDescriptorSets(_device.Device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		_boundPyramids[frame] = _pyramid->View();
+	}
+
+	void AppOcclusionCulling::SetObjects(const std::vector<GpuObject>& objects)
+	{
+		if (objects.size() > _maxObjects)
+			throw std::runtime_error("more objects than occlusion culling was created for!");
+
+		// one copy per buffer so each is released to the graphics queue once, the upload queue gives a list too
+		// large for its ring a staging buffer of its own
+		const VkDeviceSize size = objects.size() * sizeof(GpuObject);
+		if (size > 0)
+		{
+			AppUploadQueue& uploads = _device.UploadQueue();
+			uploads.UploadBuffer(_objectBuffer, 0, objects.data(), size);
+
+			// nothing was visible last frame, the first late phase finds everything that is
+			const std::vector<uint32_t> visibility(objects.size(), 0);
+			uploads.Wait(uploads.UploadBuffer(_visibilityBuffer, 0, visibility.data(),
+			                                  visibility.size() * sizeof(uint32_t)));
+		}
+
+		_objectCount = static_cast<uint32_t>(objects.size());
+	}
+
+	void AppOcclusionCulling::Dispatch(const VkCommandBuffer commandBuffer, const uint32_t frame,
+	                                   const Phase phase) const
+	{
+		if (_objectCount == 0)
+			return;
+
+		OcclusionConstants constants{};
+		constants.viewProjection = _viewProjection;
+		constants.hizSize = {static_cast<int32_t>(_pyramid->Extent().width),
+		                     static_cast<int32_t>(_pyramid->Extent().height)};
+		constants.hizLevels = _pyramid->LevelCount();
+		constants.objectCount = _objectCount;
+
+		const AppComputePipeline& pipeline = *_pipelines[phase];
+		pipeline.Bind(commandBuffer);
+		pipeline.BindDescriptorSets(commandBuffer, 0, {_descriptorSets.at(frame)[phase]});
+		pipeline.PushConstants(commandBuffer, constants);
+		pipeline.DispatchThreads(commandBuffer, _objectCount);
+	}
+
+	void AppOcclusionCulling::RecordEarlyCull(const VkCommandBuffer commandBuffer, const uint32_t frame,
+	                                          const VkExtent2D depthExtent)
+	{
+		_pyramid->Prepare(commandBuffer, depthExtent);
+		UpdatePyramidBinding(frame);
+
+		// last frame's draws, readback and visibility writes are done before anything is reset or read
+		RecordMemoryBarrier(commandBuffer,
+		                    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+		                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		                    VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		for (const VkBuffer counterBuffer : _counterBuffers)
+			vkCmdFillBuffer(commandBuffer, counterBuffer, 0, sizeof(Counters), 0);
+		RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+		Dispatch(commandBuffer, frame, PHASE_EARLY);
+
+		// the late phase rewrites visibility only after the early one read it
+		RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		                    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	void AppOcclusionCulling::RecordEarlyDraws(AppCommandEncoder& encoder) const
+	{
+		if (_objectCount == 0)
+			return;
+
+		AppGpuCulling::RecordIndirectDraws(_device, _drawPath, encoder.Handle(), _drawBuffers[PHASE_EARLY],
+		                                   _counterBuffers[PHASE_EARLY], _objectCount);
+	}
+
+	void AppOcclusionCulling::RecordLateCull(const VkCommandBuffer commandBuffer, const uint32_t frame,
+	                                         const AppRenderTarget& target, const uint32_t imageIndex)
+	{
+		// ends with the pyramid visible to compute reads
+		_pyramid->Build(commandBuffer, frame, target, imageIndex);
+
+		Dispatch(commandBuffer, frame, PHASE_LATE);
+
+		RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		                    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+	}
+
+	void AppOcclusionCulling::RecordLateDraws(AppCommandEncoder& encoder) const
+	{
+		if (_objectCount == 0)
+			return;
+
+		AppGpuCulling::RecordIndirectDraws(_device, _drawPath, encoder.Handle(), _drawBuffers[PHASE_LATE],
+		                                   _counterBuffers[PHASE_LATE], _objectCount);
+	}
+
+	void AppOcclusionCulling::RecordReadback(const VkCommandBuffer commandBuffer, const uint32_t frame)
+	{
+		for (uint32_t phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			VkBufferCopy region{};
+			region.dstOffset = phase * sizeof(Counters);
+			region.size = sizeof(Counters);
+			vkCmdCopyBuffer(commandBuffer, _counterBuffers[phase], _readbackBuffers.at(frame), 1, &region);
+		}
+
+		RecordMemoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		                    VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+		_readbackPending[frame] = true;
+	}
+
+	void AppOcclusionCulling::CollectStats(const uint32_t frame)
+	{
+		if (!_readbackPending.at(frame))
+			return;
+
+		const MemoryAllocation& memory = _readbackMemory[frame];
+
+		// readback memory may be cached without being coherent
+		const VkDeviceSize atomSize = std::max<VkDeviceSize>(_device.properties.limits.nonCoherentAtomSize, 1);
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = memory.memory;
+		range.offset = memory.offset / atomSize * atomSize;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(_device.Device(), 1, &range);
+
+		const auto* counters = static_cast<const Counters*>(memory.mappedData);
+		_last.earlyDraws = counters[PHASE_EARLY].drawCount;
+		_last.lateDraws = counters[PHASE_LATE].drawCount;
+		_last.frustumCulled = counters[PHASE_LATE].frustumCulled;
+		_last.occluded = counters[PHASE_LATE].occluded;
+
+		_frames++;
+		_earlyDraws += _last.earlyDraws;
+		_lateDraws += _last.lateDraws;
+		_frustumCulled += _last.frustumCulled;
+		_occluded += _last.occluded;
+		_readbackPending[frame] = false;
+	}
+
+	void AppOcclusionCulling::PrintStats(std::ostream& out) const
+	{
+		const double frames = static_cast<double>(std::max<uint64_t>(_frames, 1));
+		const double tested = static_cast<double>(std::max<uint64_t>(_frames * _objectCount, 1));
+		out << "occlusion_culling path=" << AppGpuCulling::DrawPathName(_drawPath) << " objects=" << _objectCount
+			<< " frames=" << _frames << " early_draws_per_frame=" << _earlyDraws / frames
+			<< " late_draws_per_frame=" << _lateDraws / frames
+			<< " frustum_culled_per_frame=" << _frustumCulled / frames
+			<< " occluded_per_frame=" << _occluded / frames
+			<< " culled_pct=" << 100.0 * (_frustumCulled + _occluded) / tested << std::endl;
+		out << "occlusion_culling_last early_draws=" << _last.earlyDraws << " late_draws=" << _last.lateDraws
+			<< " frustum_culled=" << _last.frustumCulled << " occluded=" << _last.occluded << std::endl;
+		_pyramid->PrintStats(out);
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "app_command_encoder.hpp"
+#include "app_compute_pipeline.hpp"
+#include "app_device.hpp"
+#include "app_gpu_culling.hpp"
+#include "app_hiz_pyramid.hpp"
+#include "app_pipeline_layout_cache.hpp"
+#include "app_render_target.hpp"
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// culled counts of one frame as the gpu wrote them
+	struct OcclusionFrameStats
+	{
+		// visible last frame and still in the frustum, drawn before the pyramid is built
+		uint32_t earlyDraws = 0;
+		// hidden last frame, found visible against this frame's pyramid
+		uint32_t lateDraws = 0;
+		uint32_t frustumCulled = 0;
+		// in the frustum but behind what the early draws put in the depth buffer
+		uint32_t occluded = 0;
+	};
+
+	// Two phase occlusion culling for GPU driven draws. The early phase draws what was visible last frame,
+	// the depth it leaves behind is reduced into a hi-z pyramid, and the late phase tests every object
+	// against the pyramid, draws the ones that just became visible in a second render pass that loads the
+	// first one's attachments, and remembers the visible set for the next frame. Hidden objects cost one
+	// compute invocation instead of a draw. The draws go through the same paths as AppGpuCulling.
+	class AppOcclusionCulling
+	{
+	public:
+		static constexpr const char* SHADER_PATH = "Shaders/occlusion_cull.comp.spv";
+
+		AppOcclusionCulling(AppDevice& device, AppPipelineLayoutCache& layoutCache, uint32_t maxObjects,
+		                    uint32_t framesInFlight);
+		~AppOcclusionCulling();
+
+		AppOcclusionCulling(const AppOcclusionCulling&) = delete;
+		AppOcclusionCulling& operator=(const AppOcclusionCulling&) = delete;
+
+		// uploads through the upload queue and waits, meant for load time. everything starts out hidden.
+		// once, with a dedicated transfer queue the buffers belong to the graphics queue afterwards
+		void SetObjects(const std::vector<GpuObject>& objects);
+		// column major with vulkan's [0, 1] depth range, identity when objects are already in clip space
+		void SetViewProjection(const std::array<float, 16>& viewProjection) { _viewProjection = viewProjection; }
+
+		// before the first render pass, the slot's fence must have been waited on. consumers read the early
+		// draws at DRAW_INDIRECT
+		void RecordEarlyCull(VkCommandBuffer commandBuffer, uint32_t frame, VkExtent2D depthExtent);
+		// inside the first render pass with the pipeline and index buffer bound
+		void RecordEarlyDraws(AppCommandEncoder& encoder) const;
+		// between the two render passes: builds the pyramid from the image's depth and culls against it
+		void RecordLateCull(VkCommandBuffer commandBuffer, uint32_t frame, const AppRenderTarget& target,
+		                    uint32_t imageIndex);
+		// inside the loading render pass with the pipeline and index buffer bound
+		void RecordLateDraws(AppCommandEncoder& encoder) const;
+		// after the late cull, copies the counters where the cpu can read them once the frame's fence signalled
+		void RecordReadback(VkCommandBuffer commandBuffer, uint32_t frame);
+
+		// adds the slot's last read back frame to the totals, the slot's fence must have been waited on
+		void CollectStats(uint32_t frame);
+		[[nodiscard]] const OcclusionFrameStats& LastFrameStats() const { return _last; }
+		[[nodiscard]] uint32_t ObjectCount() const { return _objectCount; }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		enum Phase
+		{
+			PHASE_EARLY,
+			PHASE_LATE,
+			PHASE_COUNT
+		};
+
+		void CreateDescriptorSets();
+		// points the slot's sets at the current pyramid, which is replaced when the target is resized
+		void UpdatePyramidBinding(uint32_t frame);
+		void Dispatch(VkCommandBuffer commandBuffer, uint32_t frame, Phase phase) const;
+
+		AppDevice& _device;
+		AppGpuCulling::DrawPath _drawPath;
+		std::array<std::unique_ptr<AppComputePipeline>, PHASE_COUNT> _pipelines;
+		std::unique_ptr<AppHiZPyramid> _pyramid;
+		const uint32_t _maxObjects;
+		uint32_t _objectCount = 0;
+		std::array<float, 16> _viewProjection{
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		};
+
+		VkBuffer _objectBuffer = VK_NULL_HANDLE;
+		MemoryAllocation _objectMemory{};
+		VkBuffer _visibilityBuffer = VK_NULL_HANDLE;
+		MemoryAllocation _visibilityMemory{};
+		// draws and counters per phase, both phases are drawn in the same frame
+		std::array<VkBuffer, PHASE_COUNT> _drawBuffers{};
+		std::array<MemoryAllocation, PHASE_COUNT> _drawMemory{};
+		std::array<VkBuffer, PHASE_COUNT> _counterBuffers{};
+		std::array<MemoryAllocation, PHASE_COUNT> _counterMemory{};
+		// one per frame in flight, so a slot is read back while the others are still being written
+		std::vector<VkBuffer> _readbackBuffers;
+		std::vector<MemoryAllocation> _readbackMemory;
+		std::vector<bool> _readbackPending;
+
+		VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+		// [frame][phase], per slot because the pyramid binding changes with the target size
+		std::vector<std::array<VkDescriptorSet, PHASE_COUNT>> _descriptorSets;
+		std::vector<VkImageView> _boundPyramids;
+
+		OcclusionFrameStats _last;
+		uint64_t _frames = 0;
+		uint64_t _earlyDraws = 0;
+		uint64_t _lateDraws = 0;
+		uint64_t _frustumCulled = 0;
+		uint64_t _occluded = 0;
+	};
+}
@@ -0,0 +1,377 @@
+#include "app_offscreen_target.hpp"
+
+#include <array>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	AppOffscreenTarget::AppOffscreenTarget(AppDevice& deviceRef, const VkExtent2D extent)
+		: _device{deviceRef}, _extent{extent}
+	{
+		CreateColorResources();
+		_renderPass = CreateRenderPass(false);
+		_loadRenderPass = CreateRenderPass(true);
+		CreateDepthResources();
+		CreateFramebuffers();
+		CreateSyncObjects();
+	}
+
+	AppOffscreenTarget::~AppOffscreenTarget()
+	{
+		for (size_t i = 0; i < _colorImages.size(); i++)
+		{
+			vkDestroyFramebuffer(_device.Device(), _framebuffers[i], nullptr);
+			vkDestroyImageView(_device.Device(), _colorImageViews[i], nullptr);
+			_device.DestroyImage(_colorImages[i], _colorImageMemorys[i]);
+			vkDestroyImageView(_device.Device(), _depthImageViews[i], nullptr);
+			_device.DestroyImage(_depthImages[i], _depthImageMemorys[i]);
+		}
+
+		vkDestroyRenderPass(_device.Device(), _renderPass, nullptr);
+		vkDestroyRenderPass(_device.Device(), _loadRenderPass, nullptr);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+			vkDestroyFence(_device.Device(), _inFlightFences[i], nullptr);
+	}
+
+	VkResult AppOffscreenTarget::AcquireNextImage(uint32_t* imageIndex)
+	{
+		vkWaitForFences(
+			_device.Device(),
+			1,
+			&_inFlightFences[_currentFrame],
+			VK_TRUE,
+			std::numeric_limits<uint64_t>::max());
+
+		// no presentation engine to hand images back, they are simply used round robin
+		*imageIndex = _nextImage;
+		_nextImage = (_nextImage + 1) % static_cast<uint32_t>(_colorImages.size());
+
+		return VK_SUCCESS;
+	}
+
+	VkResult AppOffscreenTarget::SubmitCommandBuffers(const VkCommandBuffer* buffers, const uint32_t* imageIndex)
+	{
+		if (_imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
+			vkWaitForFences(_device.Device(), 1, &_imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+
+		_imagesInFlight[*imageIndex] = _inFlightFences[_currentFrame];
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = buffers;
+
+		vkResetFences(_device.Device(), 1, &_inFlightFences[_currentFrame]);
+		if (vkQueueSubmit(_device.GraphicsQueue(), 1, &submitInfo, _inFlightFences[_currentFrame]) !=
+			VK_SUCCESS)
+			throw std::runtime_error("failed to submit draw command buffer!");
+
+		_currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+		return VK_SUCCESS;
+	}
+
+	void AppOffscreenTarget::WriteImage(const uint32_t imageIndex, const std::string& path)
+	{
+		if (_imagesInFlight[imageIndex] == VK_NULL_HANDLE)
+			throw std::runtime_error("failed to write offscreen image, it was never rendered!");
+
+		vkWaitForFences(_device.Device(), 1, &_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+
+		const VkDeviceSize size = static_cast<VkDeviceSize>(_extent.width) * _extent.height * 4;
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer readback;
+		if (vkCreateBuffer(_device.Device(), &bufferInfo, nullptr, &readback) != VK_SUCCESS)
+			throw std::runtime_error("failed to create readback buffer!");
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(_device.Device(), readback, &memRequirements);
+
+		// dedicated, so invalidating the whole VkDeviceMemory cannot touch anyone else's range
+		MemoryAllocation readbackMemory = _device.Allocator().Allocate(
+			memRequirements, MemoryUsage::Readback, false, true);
+		vkBindBufferMemory(_device.Device(), readback, readbackMemory.memory, readbackMemory.offset);
+
+		const VkCommandBuffer commandBuffer = _device.BeginSingleTimeCommands();
+
+		VkBufferImageCopy region{};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = {_extent.width, _extent.height, 1};
+
+		vkCmdCopyImageToBuffer(commandBuffer, _colorImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		                       readback, 1, &region);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+		                     1, &barrier, 0, nullptr, 0, nullptr);
+
+		_device.EndSingleTimeCommands(commandBuffer);
+
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = readbackMemory.memory;
+		range.offset = 0;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(_device.Device(), 1, &range);
+
+		std::ofstream file{path, std::ios::binary};
+		if (!file.is_open())
+		{
+			_device.DestroyBuffer(readback, readbackMemory);
+			throw std::runtime_error("failed to open file: " + path);
+		}
+
+		file << "P6\n" << _extent.width << " " << _extent.height << "\n255\n";
+
+		// BGRA in memory, PPM wants RGB
+		const auto* pixels = static_cast<const unsigned char*>(readbackMemory.mappedData);
+		std::vector<char> row(static_cast<size_t>(_extent.width) * 3);
+		for (uint32_t y = 0; y < _extent.height; y++)
+		{
+			const unsigned char* src = pixels + static_cast<size_t>(y) * _extent.width * 4;
+			for (uint32_t x = 0; x < _extent.width; x++)
+			{
+				row[x * 3 + 0] = static_cast<char>(src[x * 4 + 2]);
+				row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+				row[x * 3 + 2] = static_cast<char>(src[x * 4 + 0]);
+			}
+			file.write(row.data(), static_cast<std::streamsize>(row.size()));
+		}
+
+		_device.DestroyBuffer(readback, readbackMemory);
+	}
+
+	void AppOffscreenTarget::CreateColorResources()
+	{
+		_colorImages.resize(IMAGE_COUNT);
+		_colorImageMemorys.resize(IMAGE_COUNT);
+		_colorImageViews.resize(IMAGE_COUNT);
+
+		for (size_t i = 0; i < _colorImages.size(); i++)
+		{
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent.width = _extent.width;
+			imageInfo.extent.height = _extent.height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = _colorFormat;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.flags = 0;
+
+			_device.CreateImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			                            _colorImages[i], _colorImageMemorys[i]);
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = _colorImages[i];
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = _colorFormat;
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(_device.Device(), &viewInfo, nullptr, &_colorImageViews[i]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create offscreen image view!");
+		}
+	}
+
+	void AppOffscreenTarget::CreateDepthResources()
+	{
+		const VkFormat depthFormat = FindDepthFormat();
+
+		_depthImages.resize(ImageCount());
+		_depthImageMemorys.resize(ImageCount());
+		_depthImageViews.resize(ImageCount());
+
+		for (size_t i = 0; i < _depthImages.size(); i++)
+		{
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent.width = _extent.width;
+			imageInfo.extent.height = _extent.height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = depthFormat;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.flags = 0;
+
+			_device.CreateImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			                            _depthImages[i], _depthImageMemorys[i]);
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = _depthImages[i];
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = depthFormat;
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(_device.Device(), &viewInfo, nullptr, &_depthImageViews[i]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create texture image view!");
+		}
+	}
+
+	VkRenderPass AppOffscreenTarget::CreateRenderPass(const bool loadContents) const
+	{
+		// depth is stored so compute passes can sample it, e.g. to build an occlusion pyramid
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = FindDepthFormat();
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = loadContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout =
+			loadContents ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depthAttachmentRef{};
+		depthAttachmentRef.attachment = 1;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		// ends ready to be copied out instead of presented
+		VkAttachmentDescription colorAttachment = {};
+		colorAttachment.format = _colorFormat;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = loadContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.initialLayout =
+			loadContents ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		VkAttachmentReference colorAttachmentRef = {};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		std::array<VkSubpassDependency, 2> dependencies{};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].srcStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].dstStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask =
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// the loading pass reads what the earlier pass of the frame wrote
+		if (loadContents)
+		{
+			dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependencies[0].srcAccessMask =
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dstStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependencies[0].dstAccessMask |=
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		}
+
+		// lets a later submission on the queue copy the image out
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		const std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		if (vkCreateRenderPass(_device.Device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+			throw std::runtime_error("failed to create render pass!");
+		return renderPass;
+	}
+
+	void AppOffscreenTarget::CreateFramebuffers()
+	{
+		_framebuffers.resize(ImageCount());
+		for (size_t i = 0; i < ImageCount(); i++)
+		{
+			std::array<VkImageView, 2> attachments = {_colorImageViews[i], _depthImageViews[i]};
+
+			VkFramebufferCreateInfo framebufferInfo = {};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = _renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebufferInfo.pAttachments = attachments.data();
+			framebufferInfo.width = _extent.width;
+			framebufferInfo.height = _extent.height;
+			framebufferInfo.layers = 1;
+
+			if (vkCreateFramebuffer(_device.Device(), &framebufferInfo, nullptr, &_framebuffers[i]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create frame-buffer!");
+		}
+	}
+
+	void AppOffscreenTarget::CreateSyncObjects()
+	{
+		_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+		_imagesInFlight.resize(ImageCount(), VK_NULL_HANDLE);
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			if (vkCreateFence(_device.Device(), &fenceInfo, nullptr, &_inFlightFences[i]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create synchronization objects for a frame!");
+		}
+	}
+
+	VkFormat AppOffscreenTarget::FindDepthFormat() const
+	{
+		return _device.FindSupportedFormat(
+			{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "app_device.hpp"
+#include "app_render_target.hpp"
+
+#include <string>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Render target for headless runs: plain color images instead of a swap chain, nothing is presented.
+	// Frames still rotate through MAX_FRAMES_IN_FLIGHT fences so pacing matches the windowed path.
+	class AppOffscreenTarget : public AppRenderTarget
+	{
+	public:
+		// one more than the frames in flight, the same as the swap chain asks for
+		static constexpr uint32_t IMAGE_COUNT = MAX_FRAMES_IN_FLIGHT + 1;
+
+		AppOffscreenTarget(AppDevice& deviceRef, VkExtent2D extent);
+		~AppOffscreenTarget() override;
+
+		AppOffscreenTarget(const AppOffscreenTarget&) = delete;
+		void operator=(const AppOffscreenTarget&) = delete;
+
+		[[nodiscard]] VkFramebuffer GetFrameBuffer(const size_t index) const override { return _framebuffers[index]; }
+		[[nodiscard]] VkRenderPass GetRenderPass() const override { return _renderPass; }
+		[[nodiscard]] VkRenderPass GetLoadRenderPass() const override { return _loadRenderPass; }
+		[[nodiscard]] size_t ImageCount() const override { return _colorImages.size(); }
+		[[nodiscard]] VkFormat GetImageFormat() const override { return _colorFormat; }
+		[[nodiscard]] VkExtent2D GetExtent() const override { return _extent; }
+		[[nodiscard]] size_t CurrentFrame() const override { return _currentFrame; }
+		[[nodiscard]] VkImage GetDepthImage(const size_t index) const override { return _depthImages[index]; }
+		[[nodiscard]] VkImageView GetDepthImageView(const size_t index) const override { return _depthImageViews[index]; }
+		[[nodiscard]] VkFormat GetDepthFormat() const override { return FindDepthFormat(); }
+		[[nodiscard]] VkImage GetImage(const size_t index) const { return _colorImages[index]; }
+
+		VkResult AcquireNextImage(uint32_t* imageIndex) override;
+		VkResult SubmitCommandBuffers(const VkCommandBuffer* buffers, const uint32_t* imageIndex) override;
+
+		// copies a rendered image back and writes it as a binary PPM, waits for the image's last frame
+		void WriteImage(uint32_t imageIndex, const std::string& path);
+
+	private:
+		void CreateColorResources();
+		void CreateDepthResources();
+		// clears both attachments, or loads them for a pass continuing the frame
+		[[nodiscard]] VkRenderPass CreateRenderPass(bool loadContents) const;
+		void CreateFramebuffers();
+		void CreateSyncObjects();
+		[[nodiscard]] VkFormat FindDepthFormat() const;
+
+		AppDevice& _device;
+		VkExtent2D _extent;
+		VkFormat _colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+
+		std::vector<VkImage> _colorImages;
+		std::vector<MemoryAllocation> _colorImageMemorys;
+		std::vector<VkImageView> _colorImageViews;
+		std::vector<VkImage> _depthImages;
+		std::vector<MemoryAllocation> _depthImageMemorys;
+		std::vector<VkImageView> _depthImageViews;
+		std::vector<VkFramebuffer> _framebuffers;
+		VkRenderPass _renderPass = VK_NULL_HANDLE;
+		VkRenderPass _loadRenderPass = VK_NULL_HANDLE;
+
+		std::vector<VkFence> _inFlightFences;
+		std::vector<VkFence> _imagesInFlight;
+		size_t _currentFrame = 0;
+		uint32_t _nextImage = 0;
+	};
+}
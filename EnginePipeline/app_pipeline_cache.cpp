@@ -0,0 +1,207 @@
+#include "app_pipeline_cache.hpp"
+
+#include "app_environment.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	AppPipelineCache::AppPipelineCache(const VkDevice device, const VkPhysicalDeviceProperties& properties)
+		: _device{device}, _properties{properties}
+	{
+		_path = BuildPath();
+
+		const std::vector<char> data = Load();
+		_loadedFromDisk = !data.empty();
+
+		VkPipelineCacheCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		createInfo.initialDataSize = data.size();
+		createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+		if (vkCreatePipelineCache(_device, &createInfo, nullptr, &_cache) != VK_SUCCESS)
+		{
+			// drivers may still refuse data that passed our checks, start empty rather than fail
+			std::cout << "pipeline_cache rejected reason=driver path=" << _path << std::endl;
+			createInfo.initialDataSize = 0;
+			createInfo.pInitialData = nullptr;
+			_loadedFromDisk = false;
+			_savedHash = 0;
+
+			if (vkCreatePipelineCache(_device, &createInfo, nullptr, &_cache) != VK_SUCCESS)
+				throw std::runtime_error("failed to create pipeline cache!");
+		}
+
+		std::cout << "pipeline_cache loaded=" << (_loadedFromDisk ? 1 : 0) << " bytes=" << data.size()
+			<< " path=" << _path << std::endl;
+	}
+
+	AppPipelineCache::~AppPipelineCache()
+	{
+		Save();
+		vkDestroyPipelineCache(_device, _cache, nullptr);
+	}
+
+	bool AppPipelineCache::Save()
+	{
+		std::lock_guard<std::mutex> lock(_saveMutex);
+
+		size_t size = 0;
+		if (vkGetPipelineCacheData(_device, _cache, &size, nullptr) != VK_SUCCESS || size == 0)
+			return false;
+
+		std::vector<char> data(size);
+		// VK_INCOMPLETE only if the cache grew between the two calls, what we got is still a valid cache
+		const VkResult result = vkGetPipelineCacheData(_device, _cache, &size, data.data());
+		if (result != VK_SUCCESS && result != VK_INCOMPLETE)
+			return false;
+		data.resize(size);
+
+		const uint64_t hash = Hash(data.data(), data.size());
+		if (hash == _savedHash)
+			return true;
+
+		const FileHeader header{FILE_MAGIC, FILE_VERSION, static_cast<uint64_t>(data.size()), hash};
+		const std::filesystem::path path{_path};
+		const std::filesystem::path tempPath{_path + ".tmp"};
+
+		std::error_code error;
+		if (path.has_parent_path())
+			std::filesystem::create_directories(path.parent_path(), error);
+
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				std::cerr << "pipeline_cache save_failed path=" << tempPath.string() << std::endl;
+				return false;
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(data.data(), static_cast<std::streamsize>(data.size()));
+			file.flush();
+			if (!file)
+			{
+				file.close();
+				std::filesystem::remove(tempPath, error);
+				std::cerr << "pipeline_cache save_failed path=" << tempPath.string() << std::endl;
+				return false;
+			}
+		}
+
+		// replaces the previous file in one step, readers see either the old cache or the new one
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+		{
+			std::filesystem::remove(tempPath, error);
+			std::cerr << "pipeline_cache save_failed path=" << _path << std::endl;
+			return false;
+		}
+
+		_savedHash = hash;
+		std::cout << "pipeline_cache saved bytes=" << data.size() << " path=" << _path << std::endl;
+		return true;
+	}
+
+	std::string AppPipelineCache::BuildPath() const
+	{
+		std::string directory = ReadEnvironment(DIRECTORY_ENV);
+		if (directory.empty())
+			directory = DEFAULT_DIRECTORY;
+
+		// the driver version is not part of the cache header, keep it in the name so driver updates start fresh
+		std::ostringstream name;
+		name << std::hex << std::setfill('0') << "pipeline_" << std::setw(4) << _properties.vendorID << "_"
+			<< std::setw(4) << _properties.deviceID << "_" << std::setw(8) << _properties.driverVersion << "_";
+		for (const uint8_t byte : _properties.pipelineCacheUUID)
+			name << std::setw(2) << static_cast<uint32_t>(byte);
+		name << ".bin";
+
+		return (std::filesystem::path{directory} / name.str()).string();
+	}
+
+	std::vector<char> AppPipelineCache::Load()
+	{
+		std::ifstream file(_path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+			return {};
+
+		const auto fileSize = static_cast<size_t>(file.tellg());
+		if (fileSize < sizeof(FileHeader))
+		{
+			std::cout << "pipeline_cache rejected reason=truncated path=" << _path << std::endl;
+			return {};
+		}
+
+		FileHeader header{};
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		std::string reason;
+		if (header.magic != FILE_MAGIC || header.version != FILE_VERSION)
+			reason = "format";
+		else if (header.dataSize != fileSize - sizeof(FileHeader))
+			reason = "truncated";
+
+		std::vector<char> data;
+		if (reason.empty())
+		{
+			data.resize(static_cast<size_t>(header.dataSize));
+			file.read(data.data(), static_cast<std::streamsize>(data.size()));
+			if (!file)
+				reason = "truncated";
+			else if (Hash(data.data(), data.size()) != header.dataHash)
+				reason = "checksum";
+			else
+				reason = DeviceMismatch(data);
+		}
+
+		if (!reason.empty())
+		{
+			std::cout << "pipeline_cache rejected reason=" << reason << " path=" << _path << std::endl;
+			return {};
+		}
+
+		// a matching file is already what Save would write, no need to rewrite it on an unchanged run
+		_savedHash = header.dataHash;
+		return data;
+	}
+
+	std::string AppPipelineCache::DeviceMismatch(const std::vector<char>& data) const
+	{
+		// VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+		constexpr size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+		if (data.size() < headerSize)
+			return "truncated";
+
+		uint32_t fields[4];
+		std::memcpy(fields, data.data(), sizeof(fields));
+
+		if (fields[0] < headerSize || fields[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+			return "header";
+		if (fields[2] != _properties.vendorID || fields[3] != _properties.deviceID)
+			return "device";
+		if (std::memcmp(data.data() + sizeof(fields), _properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+			return "uuid";
+
+		return {};
+	}
+
+	uint64_t AppPipelineCache::Hash(const char* data, const size_t size)
+	{
+		// FNV-1a, only has to catch corruption
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= static_cast<uint8_t>(data[i]);
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+}
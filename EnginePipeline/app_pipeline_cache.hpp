@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace VulkanTest
+{
+	// VkPipelineCache persisted between runs, one file per device and driver build.
+	// A file that does not match this device or fails its checksum is ignored and overwritten on the next save.
+	class AppPipelineCache
+	{
+	public:
+		static constexpr const char* DEFAULT_DIRECTORY = "PipelineCache";
+		// directory to keep cache files in instead of DEFAULT_DIRECTORY
+		static constexpr const char* DIRECTORY_ENV = "VULKANTEST_PIPELINE_CACHE_DIR";
+
+		AppPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties);
+		// saves once more before destroying the cache
+		~AppPipelineCache();
+
+		AppPipelineCache(const AppPipelineCache&) = delete;
+		void operator=(const AppPipelineCache&) = delete;
+
+		[[nodiscard]] VkPipelineCache Handle() const { return _cache; }
+		[[nodiscard]] const std::string& Path() const { return _path; }
+		// true when the driver was handed data from a previous run
+		[[nodiscard]] bool LoadedFromDisk() const { return _loadedFromDisk; }
+
+		// writes the current contents to a temporary file and renames it over the old one,
+		// so a crash mid-write never leaves a truncated cache behind. returns false on failure.
+		bool Save();
+
+	private:
+		// our own prefix ahead of the driver's data, the driver header alone does not catch truncation
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t dataSize;
+			uint64_t dataHash;
+		};
+
+		static constexpr uint32_t FILE_MAGIC = 0x43505456; // "VTPC"
+		static constexpr uint32_t FILE_VERSION = 1;
+
+		[[nodiscard]] std::string BuildPath() const;
+		[[nodiscard]] std::vector<char> Load();
+		// why the driver's header does not belong to this device, empty when it does
+		[[nodiscard]] std::string DeviceMismatch(const std::vector<char>& data) const;
+		static uint64_t Hash(const char* data, size_t size);
+
+		VkDevice _device;
+		VkPhysicalDeviceProperties _properties;
+		VkPipelineCache _cache = VK_NULL_HANDLE;
+		std::string _path;
+		bool _loadedFromDisk = false;
+		// hash of what is on disk, lets Save skip the write when nothing new was compiled
+		uint64_t _savedHash = 0;
+		std::mutex _saveMutex;
+	};
+}
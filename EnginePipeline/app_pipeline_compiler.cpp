@@ -0,0 +1,155 @@
+#include "app_pipeline_compiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	AppPipelineCompiler::AppPipelineCompiler(AppDevice& device, AppJobPool& jobPool)
+		: _device{device}, _jobPool{jobPool}
+	{
+	}
+
+	AppPipelineCompiler::~AppPipelineCompiler()
+	{
+		WaitIdle();
+	}
+
+	std::vector<PipelineFuture> AppPipelineCompiler::Compile(
+		std::vector<std::unique_ptr<PipelineDescription>> descriptions, size_t batchSize)
+	{
+		std::vector<PipelineFuture> futures;
+		futures.reserve(descriptions.size());
+		if (descriptions.empty())
+			return futures;
+
+		if (batchSize == 0)
+		{
+			const size_t workers = std::max<uint32_t>(1, _jobPool.ThreadCount());
+			batchSize = (descriptions.size() + workers - 1) / workers;
+		}
+
+		for (size_t first = 0; first < descriptions.size(); first += batchSize)
+		{
+			auto batch = std::make_shared<Batch>();
+			const size_t last = std::min(descriptions.size(), first + batchSize);
+			for (size_t i = first; i < last; i++)
+			{
+				batch->descriptions.push_back(std::move(descriptions[i]));
+				batch->promises.emplace_back();
+				futures.push_back(batch->promises.back().get_future().share());
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_batchesInFlight++;
+			}
+
+			_jobPool.Submit([this, batch]
+			{
+				CompileBatch(*batch);
+
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (--_batchesInFlight == 0)
+					_idle.notify_all();
+			});
+		}
+
+		return futures;
+	}
+
+	PipelineFuture AppPipelineCompiler::Compile(std::unique_ptr<PipelineDescription> description)
+	{
+		std::vector<std::unique_ptr<PipelineDescription>> descriptions;
+		descriptions.push_back(std::move(description));
+		return Compile(std::move(descriptions), 1).front();
+	}
+
+	void AppPipelineCompiler::CompileBatch(Batch& batch)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const size_t count = batch.descriptions.size();
+
+		// built in place, each one points into itself
+		std::vector<PipelineBuildInfo> builds(count);
+		std::vector<VkGraphicsPipelineCreateInfo> createInfos;
+		createInfos.reserve(count);
+		std::vector<size_t> buildIndices;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			try
+			{
+				const PipelineDescription& description = *batch.descriptions[i];
+				AppPipeline::PrepareBuild(
+					_device, description.vertCode, description.fragCode, description.config, builds[i],
+					&description.vertConstants, &description.fragConstants);
+				createInfos.push_back(builds[i].pipelineInfo);
+				buildIndices.push_back(i);
+			}
+			catch (...)
+			{
+				_failed++;
+				batch.promises[i].set_exception(std::current_exception());
+			}
+		}
+
+		std::vector<VkPipeline> pipelines(createInfos.size(), VK_NULL_HANDLE);
+		VkResult result = VK_SUCCESS;
+		if (!createInfos.empty())
+		{
+			result = vkCreateGraphicsPipelines(
+				_device.Device(),
+				_device.PipelineCache().Handle(),
+				static_cast<uint32_t>(createInfos.size()),
+				createInfos.data(),
+				nullptr,
+				pipelines.data());
+		}
+
+		for (size_t i = 0; i < buildIndices.size(); i++)
+		{
+			const size_t index = buildIndices[i];
+			AppPipeline::ReleaseBuild(_device, builds[index]);
+
+			// on failure the pipelines that did compile are still valid, only the null ones failed
+			if (pipelines[i] == VK_NULL_HANDLE)
+			{
+				_failed++;
+				batch.promises[index].set_exception(std::make_exception_ptr(std::runtime_error(
+					"failed to create graphics pipeline! VkResult " + std::to_string(result))));
+				continue;
+			}
+
+			_compiled++;
+			batch.promises[index].set_value(std::make_shared<AppPipeline>(_device, pipelines[i]));
+		}
+
+		_batches++;
+		_compileMicroseconds += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start).count());
+	}
+
+	void AppPipelineCompiler::WaitAll(const std::vector<PipelineFuture>& pipelines)
+	{
+		for (const auto& pipeline : pipelines)
+			pipeline.wait();
+
+		// only after everything settled, so a failure does not leave others compiling behind our back
+		for (const auto& pipeline : pipelines)
+			pipeline.get();
+	}
+
+	void AppPipelineCompiler::WaitIdle()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_idle.wait(lock, [this] { return _batchesInFlight == 0; });
+	}
+
+	void AppPipelineCompiler::PrintStats(std::ostream& out) const
+	{
+		out << "pipeline_compiler compiled=" << _compiled << " failed=" << _failed << " batches=" << _batches
+			<< " workers=" << _jobPool.ThreadCount() << " compile_ms=" << _compileMicroseconds / 1000.0 << std::endl;
+	}
+}
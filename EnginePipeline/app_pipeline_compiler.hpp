@@ -0,0 +1,78 @@
+#pragma once
+
+#include "app_device.hpp"
+#include "app_job_pool.hpp"
+#include "app_pipline.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Everything needed to build one graphics pipeline. config points into itself
+	// (colorBlendInfo -> colorBlendAttachment), so descriptions are handed over in a unique_ptr and never moved.
+	struct PipelineDescription
+	{
+		std::vector<char> vertCode;
+		std::vector<char> fragCode;
+		PipelineConfigInfo config;
+		SpecializationConstants vertConstants;
+		SpecializationConstants fragConstants;
+	};
+
+	using PipelineFuture = std::shared_future<std::shared_ptr<AppPipeline>>;
+
+	// Compiles pipelines on the job pool. Descriptions are grouped into batches, each batch is a single
+	// multi-create vkCreateGraphicsPipelines call on one worker, all going through the device's pipeline cache.
+	class AppPipelineCompiler
+	{
+	public:
+		AppPipelineCompiler(AppDevice& device, AppJobPool& jobPool);
+		// waits for everything still compiling, the pipelines themselves live on in their futures
+		~AppPipelineCompiler();
+
+		AppPipelineCompiler(const AppPipelineCompiler&) = delete;
+		AppPipelineCompiler& operator=(const AppPipelineCompiler&) = delete;
+
+		// batchSize 0 splits the descriptions evenly so every worker makes one multi-create call,
+		// 1 compiles every pipeline as its own job. futures come back in description order.
+		std::vector<PipelineFuture> Compile(
+			std::vector<std::unique_ptr<PipelineDescription>> descriptions, size_t batchSize = 0);
+		PipelineFuture Compile(std::unique_ptr<PipelineDescription> description);
+
+		// blocks until every pipeline is ready, rethrows the first compile failure
+		static void WaitAll(const std::vector<PipelineFuture>& pipelines);
+		// blocks until no batch is queued or compiling
+		void WaitIdle();
+
+		[[nodiscard]] uint64_t CompiledCount() const { return _compiled; }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		struct Batch
+		{
+			std::vector<std::unique_ptr<PipelineDescription>> descriptions;
+			std::vector<std::promise<std::shared_ptr<AppPipeline>>> promises;
+		};
+
+		void CompileBatch(Batch& batch);
+
+		AppDevice& _device;
+		AppJobPool& _jobPool;
+
+		std::mutex _mutex;
+		std::condition_variable _idle;
+		size_t _batchesInFlight = 0;
+
+		std::atomic<uint64_t> _compiled{0};
+		std::atomic<uint64_t> _failed{0};
+		std::atomic<uint64_t> _batches{0};
+		// summed over workers, so it can exceed wall time
+		std::atomic<uint64_t> _compileMicroseconds{0};
+	};
+}
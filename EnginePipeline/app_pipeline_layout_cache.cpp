@@ -0,0 +1,99 @@
+#include "app_pipeline_layout_cache.hpp"
+
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	AppPipelineLayoutCache::AppPipelineLayoutCache(AppDevice& device) : _device{device}
+	{
+	}
+
+	AppPipelineLayoutCache::~AppPipelineLayoutCache()
+	{
+		for (const auto& [key, layout] : _pipelineLayouts)
+			vkDestroyPipelineLayout(_device.Device(), layout, nullptr);
+		for (const auto& [key, layout] : _setLayouts)
+			vkDestroyDescriptorSetLayout(_device.Device(), layout, nullptr);
+	}
+
+	VkDescriptorSetLayout AppPipelineLayoutCache::GetDescriptorSetLayout(
+		const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return GetDescriptorSetLayoutLocked(bindings);
+	}
+
+	VkDescriptorSetLayout AppPipelineLayoutCache::GetDescriptorSetLayoutLocked(
+		const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		SetLayoutKey key;
+		key.reserve(bindings.size());
+		for (const auto& binding : bindings)
+		{
+			if (binding.pImmutableSamplers != nullptr)
+				throw std::runtime_error("immutable samplers are not supported by the layout cache!");
+
+			key.push_back({binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount,
+			               binding.stageFlags});
+		}
+
+		if (const auto found = _setLayouts.find(key); found != _setLayouts.end())
+		{
+			_hits++;
+			return found->second;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (vkCreateDescriptorSetLayout(_device.Device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+			throw std::runtime_error("failed to create descriptor set layout!");
+
+		_misses++;
+		_setLayouts.emplace(std::move(key), layout);
+		return layout;
+	}
+
+	VkPipelineLayout AppPipelineLayoutCache::GetPipelineLayout(const PipelineInterface& pipelineInterface)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		PipelineLayoutKey key;
+		key.first.reserve(pipelineInterface.sets.size());
+		for (const auto& set : pipelineInterface.sets)
+			key.first.push_back(GetDescriptorSetLayoutLocked(set));
+		for (const auto& range : pipelineInterface.pushConstantRanges)
+			key.second.push_back({range.stageFlags, range.offset, range.size});
+
+		if (const auto found = _pipelineLayouts.find(key); found != _pipelineLayouts.end())
+		{
+			_hits++;
+			return found->second;
+		}
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = static_cast<uint32_t>(key.first.size());
+		layoutInfo.pSetLayouts = key.first.data();
+		layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pipelineInterface.pushConstantRanges.size());
+		layoutInfo.pPushConstantRanges = pipelineInterface.pushConstantRanges.data();
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		if (vkCreatePipelineLayout(_device.Device(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+			throw std::runtime_error("failed to create pipeline layout!");
+
+		_misses++;
+		_pipelineLayouts.emplace(std::move(key), layout);
+		return layout;
+	}
+
+	void AppPipelineLayoutCache::PrintStats(std::ostream& out) const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		out << "pipeline_layouts set_layouts=" << _setLayouts.size() << " layouts=" << _pipelineLayouts.size()
+			<< " hits=" << _hits << " misses=" << _misses << std::endl;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "app_device.hpp"
+#include "app_shader_reflection.hpp"
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Descriptor set layouts and pipeline layouts deduplicated by content. Pipelines whose shaders declare
+	// the same sets get the very same handles, so they stay layout compatible and descriptor sets bound for
+	// one remain valid for the next. Everything lives until the cache is destroyed.
+	class AppPipelineLayoutCache
+	{
+	public:
+		explicit AppPipelineLayoutCache(AppDevice& device);
+		~AppPipelineLayoutCache();
+
+		AppPipelineLayoutCache(const AppPipelineLayoutCache&) = delete;
+		AppPipelineLayoutCache& operator=(const AppPipelineLayoutCache&) = delete;
+
+		VkDescriptorSetLayout GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		// one set layout per set in the interface, empty sets in between get an empty layout
+		VkPipelineLayout GetPipelineLayout(const PipelineInterface& pipelineInterface);
+
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		// binding, type, count, stages. immutable samplers are not supported
+		using SetLayoutKey = std::vector<std::array<uint32_t, 4>>;
+		using PipelineLayoutKey = std::pair<std::vector<VkDescriptorSetLayout>, std::vector<std::array<uint32_t, 3>>>;
+
+		// caller holds _mutex
+		VkDescriptorSetLayout GetDescriptorSetLayoutLocked(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+		AppDevice& _device;
+
+		mutable std::mutex _mutex;
+		std::map<SetLayoutKey, VkDescriptorSetLayout> _setLayouts;
+		std::map<PipelineLayoutKey, VkPipelineLayout> _pipelineLayouts;
+		uint64_t _hits = 0;
+		uint64_t _misses = 0;
+	};
+}
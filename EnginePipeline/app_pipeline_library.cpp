@@ -0,0 +1,391 @@
+#include "app_pipeline_library.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	PipelineHandle::PipelineHandle(std::shared_ptr<AppPipeline> linked, PipelineFuture optimized,
+	                               std::shared_ptr<PipelineHandle> fallback)
+		: _linked{std::move(linked)},
+		  _fallback{std::move(fallback)},
+		  _optimized{std::move(optimized)},
+		  _current{_linked}
+	{
+	}
+
+	std::shared_ptr<AppPipeline> PipelineHandle::Get() const
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_current)
+				return _current;
+		}
+
+		// outside the lock, fallbacks only ever point at older handles so the chain ends
+		return _fallback ? _fallback->Get() : nullptr;
+	}
+
+	bool PipelineHandle::Update()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_settled && _optimized.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			Promote(false);
+
+		return _settled;
+	}
+
+	std::shared_ptr<AppPipeline> PipelineHandle::Wait()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_settled)
+			Promote(true);
+
+		return _current;
+	}
+
+	bool PipelineHandle::IsOptimized() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _current != nullptr && _current != _linked;
+	}
+
+	bool PipelineHandle::IsPlaceholder() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _current == nullptr;
+	}
+
+	void PipelineHandle::Promote(const bool rethrow)
+	{
+		try
+		{
+			_current = _optimized.get();
+		}
+		catch (const std::exception& e)
+		{
+			// the linked pipeline renders the same thing, just slower
+			if (!_linked && rethrow)
+				throw;
+
+			if (!_linked)
+				std::cerr << "pipeline compile failed, keeping the placeholder: " << e.what() << std::endl;
+		}
+
+		_settled = true;
+	}
+
+	namespace
+	{
+		constexpr uint32_t LIBRARY_PARTS[] = {
+			PIPELINE_PART_VERTEX_INPUT,
+			PIPELINE_PART_PRE_RASTERIZATION,
+			PIPELINE_PART_FRAGMENT_SHADER,
+			PIPELINE_PART_FRAGMENT_OUTPUT
+		};
+	}
+
+	AppPipelineLibrary::AppPipelineLibrary(AppDevice& device, AppJobPool& jobPool, AppPipelineRegistry& registry)
+		: _device{device},
+		  _jobPool{jobPool},
+		  _registry{registry},
+		  // without fast linking a link can cost as much as the full compile, the extra pipeline would only waste time
+		  _supported{device.SupportsGraphicsPipelineLibrary() && device.HasFastLinking()}
+	{
+	}
+
+	AppPipelineLibrary::~AppPipelineLibrary()
+	{
+		// linked pipelines go first, they were created from the parts
+		_pending.clear();
+		_handles.clear();
+		for (const auto& [key, part] : _parts)
+		{
+			try
+			{
+				if (const VkPipeline pipeline = part.get(); pipeline != VK_NULL_HANDLE)
+					vkDestroyPipeline(_device.Device(), pipeline, nullptr);
+			}
+			catch (...)
+			{
+				// never built, nothing to destroy
+			}
+		}
+	}
+
+	void AppPipelineLibrary::PrecompileParts(std::unique_ptr<PipelineDescription> description)
+	{
+		if (!_supported)
+			return;
+
+		auto job = std::make_shared<PartJob>();
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (const uint32_t part : LIBRARY_PARTS)
+			{
+				const PipelineStateKey partKey{*description, part};
+				if (_parts.count(partKey) != 0)
+				{
+					_partHits++;
+					continue;
+				}
+
+				// claimed before it is built, a concurrent request for the same part finds the future
+				job->promises.emplace_back();
+				job->parts.push_back(part);
+				_parts.emplace(partKey, job->promises.back().get_future().share());
+			}
+		}
+
+		if (job->parts.empty())
+			return;
+
+		job->description = std::move(description);
+		_jobPool.Submit([this, job] { BuildParts(*job); });
+	}
+
+	std::shared_ptr<PipelineHandle> AppPipelineLibrary::Link(std::unique_ptr<PipelineDescription> description)
+	{
+		const PipelineStateKey key{*description};
+
+		std::array<VkPipeline, std::size(LIBRARY_PARTS)> libraries{};
+		bool partsReady = _supported;
+		std::shared_ptr<PipelineHandle> fallback;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (const auto found = _handles.find(key); found != _handles.end())
+				return found->second;
+
+			fallback = _fallback;
+			for (size_t i = 0; partsReady && i < libraries.size(); i++)
+			{
+				const auto found = _parts.find(PipelineStateKey{*description, LIBRARY_PARTS[i]});
+				partsReady = found != _parts.end() &&
+					found->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+				if (!partsReady)
+					break;
+
+				try
+				{
+					libraries[i] = found->second.get();
+				}
+				catch (...)
+				{
+					partsReady = false;
+				}
+			}
+		}
+
+		if (_supported && !partsReady)
+			_partsNotReady++;
+
+		std::shared_ptr<AppPipeline> linked;
+		if (partsReady)
+		{
+			try
+			{
+				linked = LinkParts(libraries, description->config.pipelineLayout);
+			}
+			catch (const std::runtime_error&)
+			{
+				// the optimized build below still runs, callers just wait for it
+			}
+		}
+
+		if (!linked)
+			_fallbacks++;
+
+		PipelineFuture optimized = _registry.GetOrCreate(key, std::move(description));
+
+		std::shared_ptr<PipelineHandle> handle;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			// another thread linked the same state meanwhile, its pipeline is as good as this one
+			if (const auto found = _handles.find(key); found != _handles.end())
+				return found->second;
+
+			handle = std::make_shared<PipelineHandle>(std::move(linked), std::move(optimized), std::move(fallback));
+			_handles.emplace(key, handle);
+		}
+
+		std::lock_guard<std::mutex> pendingLock(_pendingMutex);
+		_pending.push_back(handle);
+		return handle;
+	}
+
+	void AppPipelineLibrary::SetFallback(std::shared_ptr<PipelineHandle> fallback)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_fallback = std::move(fallback);
+	}
+
+	void AppPipelineLibrary::BeginFrame()
+	{
+		std::lock_guard<std::mutex> lock(_pendingMutex);
+		const auto settled = std::remove_if(_pending.begin(), _pending.end(),
+		                                    [](const std::shared_ptr<PipelineHandle>& handle)
+		                                    {
+			                                    return handle->Update();
+		                                    });
+		_swaps += static_cast<uint64_t>(std::distance(settled, _pending.end()));
+		_pending.erase(settled, _pending.end());
+	}
+
+	void AppPipelineLibrary::BuildParts(PartJob& job)
+	{
+		std::vector<VkPipeline> built(job.parts.size(), VK_NULL_HANDLE);
+		std::exception_ptr failure;
+		const PipelineDescription& description = *job.description;
+
+		PipelineBuildInfo build;
+		bool prepared = false;
+		try
+		{
+			AppPipeline::PrepareBuild(
+				_device, description.vertCode, description.fragCode, description.config, build,
+				&description.vertConstants, &description.fragConstants);
+			prepared = true;
+
+			for (size_t i = 0; i < job.parts.size(); i++)
+				built[i] = CreatePart(build.pipelineInfo, job.parts[i]);
+		}
+		catch (...)
+		{
+			failure = std::current_exception();
+		}
+
+		if (prepared)
+			AppPipeline::ReleaseBuild(_device, build);
+
+		// the promises go last, the destructor may run as soon as the final one is set
+		for (size_t i = 0; i < job.parts.size(); i++)
+		{
+			if (built[i] != VK_NULL_HANDLE)
+			{
+				_partsBuilt++;
+				job.promises[i].set_value(built[i]);
+			}
+			else
+			{
+				_partsFailed++;
+				job.promises[i].set_exception(failure);
+			}
+		}
+	}
+
+	std::shared_ptr<AppPipeline> AppPipelineLibrary::LinkParts(const std::array<VkPipeline, 4>& libraries,
+	                                                           const VkPipelineLayout layout)
+	{
+		VkPipelineLibraryCreateInfoKHR libraryInfo{};
+		libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+		libraryInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+		libraryInfo.pLibraries = libraries.data();
+
+		// no link time optimization, that is what the registry build is for
+		VkGraphicsPipelineCreateInfo linkInfo{};
+		linkInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		linkInfo.pNext = &libraryInfo;
+		linkInfo.layout = layout;
+		linkInfo.basePipelineIndex = -1;
+
+		const auto start = std::chrono::steady_clock::now();
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		if (vkCreateGraphicsPipelines(_device.Device(), _device.PipelineCache().Handle(), 1, &linkInfo, nullptr,
+		                              &pipeline) != VK_SUCCESS)
+			throw std::runtime_error("failed to link graphics pipeline library!");
+
+		const auto microseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start).count());
+		_links++;
+		_linkMicroseconds += microseconds;
+		uint64_t previousMax = _linkMicrosecondsMax;
+		while (previousMax < microseconds && !_linkMicrosecondsMax.compare_exchange_weak(previousMax, microseconds))
+		{
+		}
+
+		return std::make_shared<AppPipeline>(_device, pipeline);
+	}
+
+	VkPipeline AppPipelineLibrary::CreatePart(const VkGraphicsPipelineCreateInfo& full, const uint32_t part) const
+	{
+		VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+		libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+		libraryInfo.flags = part;
+
+		// only the state the part consumes, the driver ignores dynamic states outside it
+		VkGraphicsPipelineCreateInfo partInfo{};
+		partInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		partInfo.pNext = &libraryInfo;
+		partInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+		partInfo.pDynamicState = full.pDynamicState;
+		partInfo.basePipelineIndex = -1;
+
+		switch (part)
+		{
+		case PIPELINE_PART_VERTEX_INPUT:
+			partInfo.pVertexInputState = full.pVertexInputState;
+			partInfo.pInputAssemblyState = full.pInputAssemblyState;
+			break;
+		case PIPELINE_PART_PRE_RASTERIZATION:
+			partInfo.stageCount = 1;
+			partInfo.pStages = &full.pStages[0];
+			partInfo.pViewportState = full.pViewportState;
+			partInfo.pRasterizationState = full.pRasterizationState;
+			partInfo.layout = full.layout;
+			partInfo.renderPass = full.renderPass;
+			partInfo.subpass = full.subpass;
+			break;
+		case PIPELINE_PART_FRAGMENT_SHADER:
+			partInfo.stageCount = 1;
+			partInfo.pStages = &full.pStages[1];
+			partInfo.pMultisampleState = full.pMultisampleState;
+			partInfo.pDepthStencilState = full.pDepthStencilState;
+			partInfo.layout = full.layout;
+			partInfo.renderPass = full.renderPass;
+			partInfo.subpass = full.subpass;
+			break;
+		case PIPELINE_PART_FRAGMENT_OUTPUT:
+			partInfo.pMultisampleState = full.pMultisampleState;
+			partInfo.pColorBlendState = full.pColorBlendState;
+			partInfo.renderPass = full.renderPass;
+			partInfo.subpass = full.subpass;
+			break;
+		default:
+			throw std::runtime_error("unknown graphics pipeline library part!");
+		}
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		if (vkCreateGraphicsPipelines(_device.Device(), _device.PipelineCache().Handle(), 1, &partInfo, nullptr,
+		                              &pipeline) != VK_SUCCESS)
+			throw std::runtime_error("failed to create graphics pipeline library part!");
+
+		return pipeline;
+	}
+
+	void AppPipelineLibrary::PrintStats(std::ostream& out) const
+	{
+		size_t handles = 0;
+		size_t optimized = 0;
+		size_t placeholders = 0;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			handles = _handles.size();
+			for (const auto& [key, handle] : _handles)
+			{
+				optimized += handle->IsOptimized() ? 1 : 0;
+				placeholders += handle->IsPlaceholder() ? 1 : 0;
+			}
+		}
+
+		const uint64_t links = _links;
+		out << "pipeline_library supported=" << (_supported ? 1 : 0) << " handles=" << handles
+			<< " optimized=" << optimized << " placeholders=" << placeholders << " swaps=" << _swaps << " links=" << links
+			<< " link_us_avg=" << (links > 0 ? _linkMicroseconds / links : 0)
+			<< " link_us_max=" << _linkMicrosecondsMax << " parts_built=" << _partsBuilt
+			<< " parts_failed=" << _partsFailed << " part_hits=" << _partHits << " parts_not_ready=" << _partsNotReady
+			<< " fallbacks=" << _fallbacks << std::endl;
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "app_pipeline_registry.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace VulkanTest
+{
+	// What draw code binds for one pipeline state. Starts out as a fast-linked pipeline built from
+	// precompiled parts, or whatever the fallback handle (possibly none) binds without one, and switches to
+	// the fully optimized pipeline in the first Update after its background compile finished. Draw code never
+	// waits.
+	class PipelineHandle
+	{
+	public:
+		PipelineHandle(std::shared_ptr<AppPipeline> linked, PipelineFuture optimized,
+		               std::shared_ptr<PipelineHandle> fallback = nullptr);
+
+		PipelineHandle(const PipelineHandle&) = delete;
+		PipelineHandle& operator=(const PipelineHandle&) = delete;
+
+		// what to bind this frame, null means skip the draw. only changes in Update and Wait, of this handle
+		// or the fallback's
+		[[nodiscard]] std::shared_ptr<AppPipeline> Get() const;
+		// swaps in the optimized pipeline if its compile finished, true once there is nothing left to swap
+		bool Update();
+		// blocks until the optimized pipeline is ready, rethrows its failure only if there is nothing to fall back to
+		std::shared_ptr<AppPipeline> Wait();
+
+		[[nodiscard]] bool IsLinked() const { return _linked != nullptr; }
+		[[nodiscard]] bool IsOptimized() const;
+		// drawing with the fallback or not at all
+		[[nodiscard]] bool IsPlaceholder() const;
+
+	private:
+		// caller holds _mutex. a failed compile leaves the linked or fallback pipeline in place
+		void Promote(bool rethrow);
+
+		mutable std::mutex _mutex;
+		// both kept after the swap, frames still in flight may have them bound
+		const std::shared_ptr<AppPipeline> _linked;
+		const std::shared_ptr<PipelineHandle> _fallback;
+		PipelineFuture _optimized;
+		std::shared_ptr<AppPipeline> _current;
+		bool _settled = false;
+	};
+
+	// Graphics pipeline library path (VK_EXT_graphics_pipeline_library). A pipeline is split into its
+	// four parts, each compiled once on the job pool and shared by every state that agrees on it, then
+	// linked without optimization in well under a millisecond. Parts are only ever built by PrecompileParts,
+	// a Link whose parts are not ready draws with the fallback instead of compiling on the calling thread.
+	// The optimized pipeline is compiled through the registry at the same time and replaces the linked one
+	// when ready. Without driver support every Link is a plain registry request.
+	class AppPipelineLibrary
+	{
+	public:
+		AppPipelineLibrary(AppDevice& device, AppJobPool& jobPool, AppPipelineRegistry& registry);
+		// waits for the parts still compiling
+		~AppPipelineLibrary();
+
+		AppPipelineLibrary(const AppPipelineLibrary&) = delete;
+		AppPipelineLibrary& operator=(const AppPipelineLibrary&) = delete;
+
+		// the extension and fast linking are both available
+		[[nodiscard]] bool IsSupported() const { return _supported; }
+
+		// queues the parts of the state no one built or requested yet on the job pool and returns, meant for
+		// load time so the later Link finds them ready. does nothing without support
+		void PrecompileParts(std::unique_ptr<PipelineDescription> description);
+		// the same state always gets the same handle. never compiles on the calling thread and never waits
+		std::shared_ptr<PipelineHandle> Link(std::unique_ptr<PipelineDescription> description);
+
+		// stands in for pipelines that are neither linked nor compiled yet, with whatever it binds at the time,
+		// so it can still be compiling itself. null skips their draws. applies to handles linked afterwards,
+		// it has to match their render pass
+		void SetFallback(std::shared_ptr<PipelineHandle> fallback);
+		// once per frame before recording: swaps in every optimized pipeline that finished since the last
+		// frame, so a frame never mixes old and new pipelines of one handle
+		void BeginFrame();
+
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		using PartFuture = std::shared_future<VkPipeline>;
+
+		// the parts one PrecompileParts call claimed, built together so the shader modules are created once
+		struct PartJob
+		{
+			std::unique_ptr<PipelineDescription> description;
+			std::vector<uint32_t> parts;
+			std::vector<std::promise<VkPipeline>> promises;
+		};
+
+		// on a worker, fulfills every promise, with the failure for parts that could not be built
+		void BuildParts(PartJob& job);
+		// throws if the link fails
+		std::shared_ptr<AppPipeline> LinkParts(const std::array<VkPipeline, 4>& libraries, VkPipelineLayout layout);
+		[[nodiscard]] VkPipeline CreatePart(const VkGraphicsPipelineCreateInfo& full, uint32_t part) const;
+
+		AppDevice& _device;
+		AppJobPool& _jobPool;
+		AppPipelineRegistry& _registry;
+		const bool _supported;
+
+		// only held for lookups and inserts, nothing compiles or links under it
+		mutable std::mutex _mutex;
+		// inserted before the part is built, so a second request for it waits on the first one's future
+		std::unordered_map<PipelineStateKey, PartFuture, PipelineStateKey::Hasher> _parts;
+		std::unordered_map<PipelineStateKey, std::shared_ptr<PipelineHandle>, PipelineStateKey::Hasher> _handles;
+		std::shared_ptr<PipelineHandle> _fallback;
+
+		// separate from _mutex, BeginFrame must not wait behind a Link
+		std::mutex _pendingMutex;
+		std::vector<std::shared_ptr<PipelineHandle>> _pending;
+
+		std::atomic<uint64_t> _links{0};
+		std::atomic<uint64_t> _linkMicroseconds{0};
+		std::atomic<uint64_t> _linkMicrosecondsMax{0};
+		std::atomic<uint64_t> _partsBuilt{0};
+		std::atomic<uint64_t> _partsFailed{0};
+		std::atomic<uint64_t> _partHits{0};
+		// links whose parts were missing, still compiling or failed
+		std::atomic<uint64_t> _partsNotReady{0};
+		std::atomic<uint64_t> _fallbacks{0};
+		std::atomic<uint64_t> _swaps{0};
+	};
+}
@@ -0,0 +1,303 @@
+#include "app_pipeline_registry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <type_traits>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		// appends plain values field by field, never whole structs, so padding and pointers stay out of the key
+		class KeyWriter
+		{
+		public:
+			explicit KeyWriter(std::vector<uint8_t>& bytes) : _bytes{bytes}
+			{
+			}
+
+			template <typename T>
+			void Put(const T& value)
+			{
+				static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>,
+				              "only scalars and handles go into a pipeline key");
+				const auto* data = reinterpret_cast<const uint8_t*>(&value);
+				_bytes.insert(_bytes.end(), data, data + sizeof(T));
+			}
+
+			void PutCode(const std::vector<char>& code)
+			{
+				Put(static_cast<uint64_t>(code.size()));
+				Put(Fnv1a(reinterpret_cast<const uint8_t*>(code.data()), code.size()));
+			}
+
+			static uint64_t Fnv1a(const uint8_t* data, const size_t size)
+			{
+				uint64_t hash = 0xcbf29ce484222325ull;
+				for (size_t i = 0; i < size; i++)
+				{
+					hash ^= data[i];
+					hash *= 0x100000001b3ull;
+				}
+				return hash;
+			}
+
+		private:
+			std::vector<uint8_t>& _bytes;
+		};
+
+		void PutStencil(KeyWriter& writer, const VkStencilOpState& state)
+		{
+			writer.Put(state.failOp);
+			writer.Put(state.passOp);
+			writer.Put(state.depthFailOp);
+			writer.Put(state.compareOp);
+			writer.Put(state.compareMask);
+			writer.Put(state.writeMask);
+			writer.Put(state.reference);
+		}
+
+		// by constant id rather than by position, so the order values were set in does not matter
+		void PutConstants(KeyWriter& writer, const SpecializationConstants& constants)
+		{
+			std::vector<std::pair<uint32_t, uint32_t>> values;
+			values.reserve(constants.entries.size());
+			for (const auto& entry : constants.entries)
+				values.emplace_back(entry.constantID, constants.data[entry.offset / sizeof(uint32_t)]);
+			std::sort(values.begin(), values.end());
+
+			writer.Put(static_cast<uint32_t>(values.size()));
+			for (const auto& [constantId, value] : values)
+			{
+				writer.Put(constantId);
+				writer.Put(value);
+			}
+		}
+	}
+
+	PipelineStateKey::PipelineStateKey(const PipelineConfigInfo& config,
+	                                   const std::vector<char>& vertCode,
+	                                   const std::vector<char>& fragCode,
+	                                   const SpecializationConstants& vertConstants,
+	                                   const SpecializationConstants& fragConstants,
+	                                   const uint32_t parts)
+	{
+		_bytes.reserve(256);
+		KeyWriter writer{_bytes};
+
+		// a part key never equals a full key with the same state
+		writer.Put(parts);
+
+		// every part gets the dynamic state list, the driver needs it to know what is left unbaked
+		writer.Put(config.dynamicStateInfo.dynamicStateCount);
+		for (uint32_t i = 0; i < config.dynamicStateInfo.dynamicStateCount; i++)
+			writer.Put(config.dynamicStateInfo.pDynamicStates[i]);
+
+		if (parts & PIPELINE_PART_VERTEX_INPUT)
+		{
+			writer.Put(static_cast<uint32_t>(config.vertexBindings.size()));
+			for (const auto& binding : config.vertexBindings)
+			{
+				writer.Put(binding.binding);
+				writer.Put(binding.stride);
+				writer.Put(binding.inputRate);
+			}
+			writer.Put(static_cast<uint32_t>(config.vertexAttributes.size()));
+			for (const auto& attribute : config.vertexAttributes)
+			{
+				writer.Put(attribute.location);
+				writer.Put(attribute.binding);
+				writer.Put(attribute.format);
+				writer.Put(attribute.offset);
+			}
+
+			writer.Put(config.inputAssemblyInfo.topology);
+			writer.Put(config.inputAssemblyInfo.primitiveRestartEnable);
+		}
+
+		if (parts & PIPELINE_PART_PRE_RASTERIZATION)
+		{
+			// shaders by content, two loads of the same file are the same shader.
+			// a 64 bit hash plus the size is treated as identity for SPIR-V
+			writer.PutCode(vertCode);
+			PutConstants(writer, vertConstants);
+
+			// viewport and scissor values are dynamic state, only the counts are baked in
+			writer.Put(config.viewportInfo.viewportCount);
+			writer.Put(config.viewportInfo.scissorCount);
+
+			const auto& raster = config.rasterizationInfo;
+			writer.Put(raster.depthClampEnable);
+			writer.Put(raster.rasterizerDiscardEnable);
+			writer.Put(raster.polygonMode);
+			writer.Put(raster.cullMode);
+			writer.Put(raster.frontFace);
+			writer.Put(raster.depthBiasEnable);
+			writer.Put(raster.depthBiasConstantFactor);
+			writer.Put(raster.depthBiasClamp);
+			writer.Put(raster.depthBiasSlopeFactor);
+			writer.Put(raster.lineWidth);
+		}
+
+		if (parts & PIPELINE_PART_FRAGMENT_SHADER)
+		{
+			writer.PutCode(fragCode);
+			PutConstants(writer, fragConstants);
+
+			const auto& depth = config.depthStencilInfo;
+			writer.Put(depth.depthTestEnable);
+			writer.Put(depth.depthWriteEnable);
+			writer.Put(depth.depthCompareOp);
+			writer.Put(depth.depthBoundsTestEnable);
+			writer.Put(depth.stencilTestEnable);
+			PutStencil(writer, depth.front);
+			PutStencil(writer, depth.back);
+			writer.Put(depth.minDepthBounds);
+			writer.Put(depth.maxDepthBounds);
+		}
+
+		// multisample state is consumed by both fragment parts
+		if (parts & (PIPELINE_PART_FRAGMENT_SHADER | PIPELINE_PART_FRAGMENT_OUTPUT))
+		{
+			const auto& multisample = config.multisampleInfo;
+			writer.Put(multisample.rasterizationSamples);
+			writer.Put(multisample.sampleShadingEnable);
+			writer.Put(multisample.minSampleShading);
+			writer.Put(multisample.pSampleMask != nullptr ? *multisample.pSampleMask : ~0u);
+			writer.Put(multisample.alphaToCoverageEnable);
+			writer.Put(multisample.alphaToOneEnable);
+		}
+
+		if (parts & PIPELINE_PART_FRAGMENT_OUTPUT)
+		{
+			const auto& blend = config.colorBlendAttachment;
+			writer.Put(blend.blendEnable);
+			writer.Put(blend.srcColorBlendFactor);
+			writer.Put(blend.dstColorBlendFactor);
+			writer.Put(blend.colorBlendOp);
+			writer.Put(blend.srcAlphaBlendFactor);
+			writer.Put(blend.dstAlphaBlendFactor);
+			writer.Put(blend.alphaBlendOp);
+			writer.Put(blend.colorWriteMask);
+
+			const auto& colorBlend = config.colorBlendInfo;
+			writer.Put(colorBlend.logicOpEnable);
+			writer.Put(colorBlend.logicOp);
+			writer.Put(colorBlend.attachmentCount);
+			for (const float constant : colorBlend.blendConstants)
+				writer.Put(constant);
+		}
+
+		// handles by identity, compatible but distinct render passes still get their own pipeline.
+		// the vertex input part is the only one that needs neither layout nor render pass
+		if (parts & ~PIPELINE_PART_VERTEX_INPUT)
+		{
+			writer.Put(config.pipelineLayout);
+			writer.Put(config.renderPass);
+			writer.Put(config.subpass);
+		}
+
+		_hash = KeyWriter::Fnv1a(_bytes.data(), _bytes.size());
+	}
+
+	AppPipelineRegistry::AppPipelineRegistry(AppPipelineCompiler& compiler) : _compiler{compiler}
+	{
+	}
+
+	PipelineFuture AppPipelineRegistry::GetOrCreate(std::unique_ptr<PipelineDescription> description)
+	{
+		const PipelineStateKey key{*description};
+		return GetOrCreate(key, std::move(description));
+	}
+
+	PipelineFuture AppPipelineRegistry::GetOrCreate(const PipelineStateKey& key,
+	                                                std::unique_ptr<PipelineDescription> description)
+	{
+		{
+			std::shared_lock<std::shared_mutex> lock(_mutex);
+			if (const auto found = _pipelines.find(key); found != _pipelines.end())
+			{
+				_hits++;
+				return found->second;
+			}
+		}
+
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		// someone else may have inserted it between the two locks
+		if (const auto found = _pipelines.find(key); found != _pipelines.end())
+		{
+			_hits++;
+			return found->second;
+		}
+
+		_misses++;
+		PipelineFuture pipeline = _compiler.Compile(std::move(description));
+		_pipelines.emplace(key, pipeline);
+		return pipeline;
+	}
+
+	std::shared_ptr<AppPipeline> AppPipelineRegistry::Find(const PipelineStateKey& key) const
+	{
+		std::shared_lock<std::shared_mutex> lock(_mutex);
+		const auto found = _pipelines.find(key);
+		if (found == _pipelines.end() ||
+			found->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return nullptr;
+
+		try
+		{
+			return found->second.get();
+		}
+		catch (...)
+		{
+			// the failure reaches whoever waits on GetOrCreate's future, draw submission only skips the draw
+			return nullptr;
+		}
+	}
+
+	size_t AppPipelineRegistry::PurgeUnused()
+	{
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+
+		size_t purged = 0;
+		for (auto it = _pipelines.begin(); it != _pipelines.end();)
+		{
+			bool unused = false;
+			if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				try
+				{
+					// the future's own copy is the registry's reference, anything above one is a user
+					unused = it->second.get().use_count() <= 1;
+				}
+				catch (...)
+				{
+					// failed compiles are dropped too, the next GetOrCreate retries
+					unused = true;
+				}
+			}
+
+			if (unused)
+			{
+				it = _pipelines.erase(it);
+				purged++;
+			}
+			else
+				++it;
+		}
+
+		return purged;
+	}
+
+	size_t AppPipelineRegistry::Size() const
+	{
+		std::shared_lock<std::shared_mutex> lock(_mutex);
+		return _pipelines.size();
+	}
+
+	void AppPipelineRegistry::PrintStats(std::ostream& out) const
+	{
+		out << "pipeline_registry pipelines=" << Size() << " hits=" << _hits << " misses=" << _misses << std::endl;
+	}
+}
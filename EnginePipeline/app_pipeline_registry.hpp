@@ -0,0 +1,101 @@
+#pragma once
+
+#include "app_pipeline_compiler.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace VulkanTest
+{
+	// the four independently compilable parts of a graphics pipeline, passed straight to the driver as library flags
+	enum PipelineParts : uint32_t
+	{
+		PIPELINE_PART_VERTEX_INPUT = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+		PIPELINE_PART_PRE_RASTERIZATION = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+		PIPELINE_PART_FRAGMENT_SHADER = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+		PIPELINE_PART_FRAGMENT_OUTPUT = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+		PIPELINE_PART_ALL = PIPELINE_PART_VERTEX_INPUT | PIPELINE_PART_PRE_RASTERIZATION |
+			PIPELINE_PART_FRAGMENT_SHADER | PIPELINE_PART_FRAGMENT_OUTPUT
+	};
+
+	// Canonical form of everything that makes two pipelines different: fixed function state from
+	// PipelineConfigInfo with pointers resolved and sTypes dropped, the SPIR-V contents and specialization
+	// constants, layout, render pass and subpass. Build it once when a material is set up, comparing and hashing it afterwards is cheap.
+	// Restricting parts keys only the state one pipeline library part consumes, so materials that differ
+	// elsewhere share that part.
+	class PipelineStateKey
+	{
+	public:
+		PipelineStateKey() = default;
+		PipelineStateKey(const PipelineConfigInfo& config,
+		                 const std::vector<char>& vertCode,
+		                 const std::vector<char>& fragCode,
+		                 const SpecializationConstants& vertConstants = {},
+		                 const SpecializationConstants& fragConstants = {},
+		                 uint32_t parts = PIPELINE_PART_ALL);
+		explicit PipelineStateKey(const PipelineDescription& description, const uint32_t parts = PIPELINE_PART_ALL)
+			: PipelineStateKey(description.config, description.vertCode, description.fragCode,
+			                   description.vertConstants, description.fragConstants, parts)
+		{
+		}
+
+		[[nodiscard]] uint64_t Hash() const { return _hash; }
+
+		bool operator==(const PipelineStateKey& other) const
+		{
+			return _hash == other._hash && _bytes == other._bytes;
+		}
+
+		bool operator!=(const PipelineStateKey& other) const { return !(*this == other); }
+
+		struct Hasher
+		{
+			size_t operator()(const PipelineStateKey& key) const { return static_cast<size_t>(key._hash); }
+		};
+
+	private:
+		std::vector<uint8_t> _bytes;
+		uint64_t _hash = 0;
+	};
+
+	// Deduplicates pipelines by state: the first request for a key compiles, later ones share the same pipeline.
+	// The registry holds a reference to everything it handed out until PurgeUnused, so a pipeline is never
+	// destroyed behind a frame that might still be using it.
+	class AppPipelineRegistry
+	{
+	public:
+		explicit AppPipelineRegistry(AppPipelineCompiler& compiler);
+
+		AppPipelineRegistry(const AppPipelineRegistry&) = delete;
+		AppPipelineRegistry& operator=(const AppPipelineRegistry&) = delete;
+
+		// compiles only on a miss, the description is dropped on a hit. only these count as hits and misses
+		PipelineFuture GetOrCreate(std::unique_ptr<PipelineDescription> description);
+		PipelineFuture GetOrCreate(const PipelineStateKey& key, std::unique_ptr<PipelineDescription> description);
+		// for draw submission: a shared lock and one hash lookup, null if the key is unknown, still compiling or
+		// failed to compile, never throws
+		[[nodiscard]] std::shared_ptr<AppPipeline> Find(const PipelineStateKey& key) const;
+
+		// drops pipelines only the registry still references, call once the gpu is done with them
+		size_t PurgeUnused();
+
+		[[nodiscard]] uint64_t Hits() const { return _hits; }
+		[[nodiscard]] uint64_t Misses() const { return _misses; }
+		[[nodiscard]] size_t Size() const;
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		AppPipelineCompiler& _compiler;
+
+		mutable std::shared_mutex _mutex;
+		std::unordered_map<PipelineStateKey, PipelineFuture, PipelineStateKey::Hasher> _pipelines;
+
+		std::atomic<uint64_t> _hits{0};
+		std::atomic<uint64_t> _misses{0};
+	};
+}
@@ -9,15 +9,26 @@ namespace VulkanTest
 	AppPipeline::AppPipeline(AppDevice& device,
 	                         const std::string& vertPathFile,
 	                         const std::string& fragFilepath,
+	                         const PipelineConfigInfo& configinfo)
+		: AppPipeline(device, ReadFile(vertPathFile), ReadFile(fragFilepath), configinfo)
+	{
+	}
+
+	AppPipeline::AppPipeline(AppDevice& device,
+	                         const std::vector<char>& vertCode,
+	                         const std::vector<char>& fragCode,
 	                         const PipelineConfigInfo& configinfo) : appDevice{device}
 	{
-		CreateGraphicsPipline(vertPathFile, fragFilepath, configinfo);
+		CreateGraphicsPipline(vertCode, fragCode, configinfo);
+	}
+
+	AppPipeline::AppPipeline(AppDevice& device, const VkPipeline pipeline)
+		: appDevice{device}, graphicsPipeline{pipeline}
+	{
 	}
 
 	AppPipeline::~AppPipeline()
 	{
-		vkDestroyShaderModule(appDevice.Device(), vertShaderModule, nullptr);
-		vkDestroyShaderModule(appDevice.Device(), fragShaderModule, nullptr);
 		vkDestroyPipeline(appDevice.Device(), graphicsPipeline, nullptr);
 	}
 
@@ -47,9 +58,34 @@ namespace VulkanTest
 		return buffer;
 	}
 
-	void AppPipeline::CreateGraphicsPipline(const std::string& vertPathFile,
-	                                        const std::string& fragFilepath,
+	void AppPipeline::CreateGraphicsPipline(const std::vector<char>& vertCode,
+	                                        const std::vector<char>& fragCode,
 	                                        const PipelineConfigInfo& configInfo)
+	{
+		PipelineBuildInfo build;
+		PrepareBuild(appDevice, vertCode, fragCode, configInfo, build);
+
+		const VkResult result = vkCreateGraphicsPipelines(
+			appDevice.Device(),
+			appDevice.PipelineCache().Handle(),
+			1,
+			&build.pipelineInfo,
+			nullptr,
+			&graphicsPipeline);
+
+		ReleaseBuild(appDevice, build);
+
+		if (result != VK_SUCCESS)
+			throw std::runtime_error("Failed to create graphics pipeline");
+	}
+
+	void AppPipeline::PrepareBuild(const AppDevice& device,
+	                               const std::vector<char>& vertCode,
+	                               const std::vector<char>& fragCode,
+	                               const PipelineConfigInfo& configInfo,
+	                               PipelineBuildInfo& build,
+	                               const SpecializationConstants* vertConstants,
+	                               const SpecializationConstants* fragConstants)
 	{
 		assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline, no pipline layout provided in config info");
@@ -57,38 +93,57 @@ namespace VulkanTest
 		assert(configInfo.renderPass != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline, no renderpass provided in config info");
 
-		const auto vertCode = ReadFile(vertPathFile);
-		const auto fragCode = ReadFile(fragFilepath);
+		CreateShaderModule(device, vertCode, &build.vertShaderModule);
+		try
+		{
+			CreateShaderModule(device, fragCode, &build.fragShaderModule);
+		}
+		catch (...)
+		{
+			ReleaseBuild(device, build);
+			throw;
+		}
 
-		CreateShaderModule(vertCode, &vertShaderModule);
-		CreateShaderModule(fragCode, &fragShaderModule);
+		const SpecializationConstants* constants[2] = {vertConstants, fragConstants};
+		for (size_t i = 0; i < 2; i++)
+		{
+			if (constants[i] == nullptr || constants[i]->Empty())
+				continue;
 
-		VkPipelineShaderStageCreateInfo shaderStages[2];
+			build.specializationInfos[i].mapEntryCount = static_cast<uint32_t>(constants[i]->entries.size());
+			build.specializationInfos[i].pMapEntries = constants[i]->entries.data();
+			build.specializationInfos[i].dataSize = constants[i]->data.size() * sizeof(uint32_t);
+			build.specializationInfos[i].pData = constants[i]->data.data();
+		}
+
+		VkPipelineShaderStageCreateInfo* shaderStages = build.shaderStages;
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = vertShaderModule;
+		shaderStages[0].module = build.vertShaderModule;
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo =
+			build.specializationInfos[0].mapEntryCount > 0 ? &build.specializationInfos[0] : nullptr;
 
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = fragShaderModule;
+		shaderStages[1].module = build.fragShaderModule;
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
+		shaderStages[1].pSpecializationInfo =
+			build.specializationInfos[1].mapEntryCount > 0 ? &build.specializationInfos[1] : nullptr;
 
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		VkPipelineVertexInputStateCreateInfo& vertexInputInfo = build.vertexInputInfo;
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexAttributeDescriptionCount = 0;
-		vertexInputInfo.vertexBindingDescriptionCount = 0;
-		vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-		vertexInputInfo.pVertexBindingDescriptions = nullptr;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(configInfo.vertexAttributes.size());
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(configInfo.vertexBindings.size());
+		vertexInputInfo.pVertexAttributeDescriptions = configInfo.vertexAttributes.data();
+		vertexInputInfo.pVertexBindingDescriptions = configInfo.vertexBindings.data();
 
 
-		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		VkGraphicsPipelineCreateInfo& pipelineInfo = build.pipelineInfo;
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelineInfo.stageCount = 2;
 
@@ -101,7 +156,7 @@ namespace VulkanTest
 
 		pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
 		pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
-		pipelineInfo.pDynamicState = nullptr;
+		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
 
 		pipelineInfo.layout = configInfo.pipelineLayout;
 		pipelineInfo.renderPass = configInfo.renderPass;
@@ -109,63 +164,57 @@ namespace VulkanTest
 
 		pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	}
 
-
-		if (vkCreateGraphicsPipelines(
-			appDevice.Device(),
-			VK_NULL_HANDLE,
-			1,
-			&pipelineInfo,
-			nullptr,
-			&graphicsPipeline) != VK_SUCCESS)
+	void SpecializationConstants::Set(const uint32_t constantId, const uint32_t value)
+	{
+		for (const auto& entry : entries)
 		{
-			throw std::runtime_error("Failed to create graphics pipeline");
+			if (entry.constantID == constantId)
+			{
+				data[entry.offset / sizeof(uint32_t)] = value;
+				return;
+			}
 		}
 
-		vkDestroyShaderModule(appDevice.Device(), fragShaderModule, nullptr);
-		vkDestroyShaderModule(appDevice.Device(), vertShaderModule, nullptr);
+		entries.push_back({constantId, static_cast<uint32_t>(data.size() * sizeof(uint32_t)), sizeof(uint32_t)});
+		data.push_back(value);
+	}
 
-		fragShaderModule = VK_NULL_HANDLE;
-		vertShaderModule = VK_NULL_HANDLE;
+	void AppPipeline::ReleaseBuild(const AppDevice& device, PipelineBuildInfo& build)
+	{
+		// modules are only needed while the pipeline is created
+		vkDestroyShaderModule(device.Device(), build.fragShaderModule, nullptr);
+		vkDestroyShaderModule(device.Device(), build.vertShaderModule, nullptr);
+
+		build.fragShaderModule = VK_NULL_HANDLE;
+		build.vertShaderModule = VK_NULL_HANDLE;
 	}
 
-	void AppPipeline::CreateShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) const
+	void AppPipeline::CreateShaderModule(const AppDevice& device, const std::vector<char>& code,
+	                                     VkShaderModule* shaderModule)
 	{
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 		createInfo.codeSize = code.size();
 		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
-		if (vkCreateShaderModule(appDevice.Device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
+		if (vkCreateShaderModule(device.Device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
 			throw std::runtime_error("failed to create shader module");
 	}
 
-	void AppPipeline::DefaultPipelineConfigInfo(
-		PipelineConfigInfo& configInfo, const uint32_t width, const uint32_t height)
+	void AppPipeline::DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
 	{
 		configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 		configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		configInfo.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
 
-		configInfo.viewport.x = 0.0f;
-		configInfo.viewport.y = 0.0f;
-
-		configInfo.viewport.width = static_cast<float>(width);
-		configInfo.viewport.height = static_cast<float>(height);
-
-		// viewport, shrink/expand
-		configInfo.viewport.minDepth = 0.0f;
-		configInfo.viewport.maxDepth = 1.0f;
-
-		// scissor, cuts anything out of rect
-		configInfo.scissor.offset = {0, 0};
-		configInfo.scissor.extent = {width, height};
-
+		// viewport and scissor are set with vkCmdSetViewport/vkCmdSetScissor when recording
 		configInfo.viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		configInfo.viewportInfo.viewportCount = 1;
-		configInfo.viewportInfo.pViewports = &configInfo.viewport;
+		configInfo.viewportInfo.pViewports = nullptr;
 		configInfo.viewportInfo.scissorCount = 1;
-		configInfo.viewportInfo.pScissors = &configInfo.scissor;
+		configInfo.viewportInfo.pScissors = nullptr;
 
 		// raster struct type
 		configInfo.rasterizationInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -254,5 +303,13 @@ namespace VulkanTest
 		configInfo.depthStencilInfo.stencilTestEnable = VK_FALSE;
 		configInfo.depthStencilInfo.front = {}; // Optional
 		configInfo.depthStencilInfo.back = {}; // Optional
+
+		// dynamic state struct type
+		configInfo.dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+		configInfo.dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
+		configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
+		configInfo.dynamicStateInfo.flags = 0;
+		configInfo.dynamicStateInfo.pNext = nullptr;
 	}
 }
@@ -12,10 +12,12 @@ namespace VulkanTest
 		PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
 
 
-		VkViewport viewport;
-		VkRect2D scissor;
+		// viewport and scissor are dynamic, so one pipeline serves every swap chain size
 		VkPipelineViewportStateCreateInfo viewportInfo;
 
+		// empty when the vertex shader pulls no vertex buffers, PipelineInterface::ApplyVertexInput fills them
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
 		VkPipelineRasterizationStateCreateInfo rasterizationInfo;
 
@@ -23,11 +25,41 @@ namespace VulkanTest
 		VkPipelineColorBlendAttachmentState colorBlendAttachment;
 		VkPipelineColorBlendStateCreateInfo colorBlendInfo;
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
+		std::vector<VkDynamicState> dynamicStateEnables;
+		VkPipelineDynamicStateCreateInfo dynamicStateInfo;
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
 	};
 
+	// Values for one stage's specialization constants, all 32 bit (int, uint, float bits or VkBool32)
+	struct SpecializationConstants
+	{
+		std::vector<VkSpecializationMapEntry> entries;
+		std::vector<uint32_t> data;
+
+		[[nodiscard]] bool Empty() const { return entries.empty(); }
+
+		// adds or overwrites the value for layout(constant_id = constantId)
+		void Set(uint32_t constantId, uint32_t value);
+	};
+
+	// Shader modules and create info for one pipeline. Holds pointers into itself, so it is built in place
+	// and must stay put until vkCreateGraphicsPipelines returned.
+	struct PipelineBuildInfo
+	{
+		PipelineBuildInfo() = default;
+		PipelineBuildInfo(const PipelineBuildInfo&) = delete;
+		PipelineBuildInfo& operator=(const PipelineBuildInfo&) = delete;
+
+		VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+		VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+		VkPipelineShaderStageCreateInfo shaderStages[2]{};
+		VkSpecializationInfo specializationInfos[2]{};
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+	};
+
 	class AppPipeline
 	{
 	public:
@@ -36,6 +68,14 @@ namespace VulkanTest
 			const std::string& vertPathFile,
 			const std::string& fragFilepath,
 			const PipelineConfigInfo& configinfo);
+		// for callers that already loaded the SPIR-V, e.g. on a worker thread during startup
+		AppPipeline(
+			AppDevice& device,
+			const std::vector<char>& vertCode,
+			const std::vector<char>& fragCode,
+			const PipelineConfigInfo& configinfo);
+		// takes ownership of a pipeline created elsewhere, e.g. by AppPipelineCompiler
+		AppPipeline(AppDevice& device, VkPipeline pipeline);
 		~AppPipeline();
 
 		AppPipeline(const AppPipeline&) = delete;
@@ -43,22 +83,34 @@ namespace VulkanTest
 
 		void Bind(VkCommandBuffer commandBuffer) const;
 
-		static void DefaultPipelineConfigInfo(
-			PipelineConfigInfo& configInfo, uint32_t width, uint32_t height);
+		static void DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
-	private:
 		static std::vector<char> ReadFile(const std::string& filePath);
 
+		// creates the shader modules and fills build.pipelineInfo, ReleaseBuild destroys the modules again.
+		// specialization constants are referenced, not copied, and have to outlive the build
+		static void PrepareBuild(
+			const AppDevice& device,
+			const std::vector<char>& vertCode,
+			const std::vector<char>& fragCode,
+			const PipelineConfigInfo& configInfo,
+			PipelineBuildInfo& build,
+			const SpecializationConstants* vertConstants = nullptr,
+			const SpecializationConstants* fragConstants = nullptr);
+		static void ReleaseBuild(const AppDevice& device, PipelineBuildInfo& build);
+
+		[[nodiscard]] VkPipeline Handle() const { return graphicsPipeline; }
+
+	private:
 		void CreateGraphicsPipline(
-			const std::string& vertPathFile,
-			const std::string& fragFilepath,
+			const std::vector<char>& vertCode,
+			const std::vector<char>& fragCode,
 			const PipelineConfigInfo& configInfo);
 
-		void CreateShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) const;
+		static void CreateShaderModule(
+			const AppDevice& device, const std::vector<char>& code, VkShaderModule* shaderModule);
 
 		AppDevice& appDevice;
-		VkPipeline graphicsPipeline;
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+		VkPipeline graphicsPipeline = VK_NULL_HANDLE;
 	};
 }
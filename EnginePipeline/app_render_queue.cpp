@@ -0,0 +1,177 @@
+#include "app_render_queue.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		constexpr uint64_t MAX_DEPTH = (1ull << SortKey::DEPTH_BITS) - 1;
+
+		uint64_t QuantizeDepth(const float depth)
+		{
+			return static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * static_cast<float>(MAX_DEPTH));
+		}
+
+		uint64_t CheckId(const uint32_t id)
+		{
+			if (id > SortKey::MAX_ID)
+				throw std::runtime_error("sort key id out of range!");
+			return id;
+		}
+	}
+
+	uint64_t SortKey::Opaque(const uint32_t layer, const uint32_t pipeline, const uint32_t material,
+	                         const uint32_t mesh, const float depth)
+	{
+		return static_cast<uint64_t>(layer & ((1u << LAYER_BITS) - 1)) << 60 |
+			CheckId(pipeline) << 45 | CheckId(material) << 31 | CheckId(mesh) << 17 | QuantizeDepth(depth);
+	}
+
+	uint64_t SortKey::Translucent(const uint32_t layer, const uint32_t pipeline, const uint32_t material,
+	                              const uint32_t mesh, const float depth)
+	{
+		// far sorts first
+		return static_cast<uint64_t>(layer & ((1u << LAYER_BITS) - 1)) << 60 | 1ull << 59 |
+			(MAX_DEPTH - QuantizeDepth(depth)) << 42 | CheckId(pipeline) << 28 | CheckId(material) << 14 |
+			CheckId(mesh);
+	}
+
+	uint32_t AppRenderQueue::PipelineId(const AppPipeline* pipeline)
+	{
+		return Intern(_pipelineIds, pipeline);
+	}
+
+	uint32_t AppRenderQueue::MaterialId(const VkDescriptorSet material)
+	{
+		return Intern(_materialIds, material);
+	}
+
+	uint32_t AppRenderQueue::MeshId(const MeshBinding* mesh)
+	{
+		return Intern(_meshIds, mesh);
+	}
+
+	uint32_t AppRenderQueue::Intern(std::unordered_map<const void*, uint32_t>& ids, const void* state)
+	{
+		// null is id 0, so "nothing bound" sorts ahead of everything else
+		if (state == nullptr)
+			return 0;
+
+		const auto [it, inserted] = ids.try_emplace(state, static_cast<uint32_t>(ids.size() + 1));
+		if (it->second > SortKey::MAX_ID)
+			throw std::runtime_error("too many distinct states in one frame for the sort key!");
+		return it->second;
+	}
+
+	void AppRenderQueue::Push(const DrawPacket& packet)
+	{
+		if (packet.pipeline == nullptr)
+			throw std::runtime_error("draw packet without a pipeline!");
+
+		_packets.push_back(packet);
+	}
+
+	void AppRenderQueue::Sort()
+	{
+		const size_t count = _packets.size();
+		_keys.resize(count);
+		_order.resize(count);
+		_keyScratch.resize(count);
+		_orderScratch.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			_keys[i] = _packets[i].sortKey;
+			_order[i] = static_cast<uint32_t>(i);
+		}
+
+		// lsd radix over 8 bit digits, stable so equal keys keep submission order
+		for (uint32_t shift = 0; shift < 64; shift += 8)
+		{
+			std::array<size_t, 256> offsets{};
+			for (const uint64_t key : _keys)
+				offsets[(key >> shift) & 0xFF]++;
+
+			// every key has the same digit, e.g. unused layers or a single pipeline, the pass would not move anything
+			if (count == 0 || offsets[(_keys[0] >> shift) & 0xFF] == count)
+			{
+				_sortPassesSkipped++;
+				continue;
+			}
+
+			size_t sum = 0;
+			for (auto& offset : offsets)
+			{
+				const size_t digitCount = offset;
+				offset = sum;
+				sum += digitCount;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const size_t dst = offsets[(_keys[i] >> shift) & 0xFF]++;
+				_keyScratch[dst] = _keys[i];
+				_orderScratch[dst] = _order[i];
+			}
+			_keys.swap(_keyScratch);
+			_order.swap(_orderScratch);
+			_sortPasses++;
+		}
+	}
+
+	void AppRenderQueue::Record(AppCommandEncoder& encoder, const size_t begin, const size_t end) const
+	{
+		// sorted neighbours mostly share state, the encoder drops the binds that repeat
+		for (size_t i = begin; i < end; i++)
+		{
+			const DrawPacket& packet = _packets[_order[i]];
+
+			encoder.BindPipeline(*packet.pipeline);
+			if (packet.material != VK_NULL_HANDLE)
+				encoder.BindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, packet.layout, MATERIAL_SET, 1,
+				                           &packet.material);
+			if (packet.pushConstants != nullptr)
+				encoder.PushConstants(packet.layout, packet.pushConstantStages, 0, packet.pushConstantSize,
+				                      packet.pushConstants);
+
+			if (packet.mesh != nullptr)
+			{
+				if (packet.mesh->vertexStreamCount > 0)
+					encoder.BindVertexBuffers(0, packet.mesh->vertexStreamCount, packet.mesh->vertexBuffers.data(),
+					                          packet.mesh->vertexOffsets.data());
+				if (packet.mesh->indexBuffer != VK_NULL_HANDLE)
+				{
+					encoder.BindIndexBuffer(packet.mesh->indexBuffer, packet.mesh->indexOffset, packet.mesh->indexType);
+					encoder.DrawIndexed(packet.count, packet.instanceCount, packet.first, packet.vertexOffset,
+					                    packet.firstInstance);
+					continue;
+				}
+			}
+
+			encoder.Draw(packet.count, packet.instanceCount, packet.first, packet.firstInstance);
+		}
+
+		_draws += end - begin;
+	}
+
+	void AppRenderQueue::Clear()
+	{
+		_packets.clear();
+		_order.clear();
+		_keys.clear();
+		// pipelines swapped for their optimized version, rebuilt ones and reloaded meshes would otherwise
+		// use up the ids over the process lifetime
+		_pipelineIds.clear();
+		_materialIds.clear();
+		_meshIds.clear();
+	}
+
+	void AppRenderQueue::PrintStats(std::ostream& out) const
+	{
+		// the binds saved by sorting show up in the command encoder's stats
+		out << "render_queue draws=" << _draws << " sort_passes=" << _sortPasses
+			<< " sort_passes_skipped=" << _sortPassesSkipped << std::endl;
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "app_command_encoder.hpp"
+#include "app_pipline.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace VulkanTest
+{
+	// The 64 bit key a draw is ordered by, most significant field first. Opaque draws group by state so
+	// the recorder can skip binds, front to back within a group. Translucent draws put depth first, back to
+	// front, state only breaks ties.
+	//   opaque:      layer(4) | 0 | pipeline(14) | material(14) | mesh(14) | depth(17)
+	//   translucent: layer(4) | 1 | ~depth(17)   | pipeline(14) | material(14) | mesh(14)
+	struct SortKey
+	{
+		static constexpr uint32_t LAYER_BITS = 4;
+		static constexpr uint32_t ID_BITS = 14;
+		static constexpr uint32_t DEPTH_BITS = 17;
+		static constexpr uint32_t MAX_ID = (1u << ID_BITS) - 1;
+
+		// depth is view depth normalized to [0, 1], clamped
+		static uint64_t Opaque(uint32_t layer, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+		static uint64_t Translucent(uint32_t layer, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+	};
+
+	// vertex and index buffers a draw reads, bound together
+	struct MeshBinding
+	{
+		// one per attribute when a mesh splits its streams
+		static constexpr uint32_t MAX_VERTEX_STREAMS = 4;
+
+		// bound to bindings [0, vertexStreamCount)
+		std::array<VkBuffer, MAX_VERTEX_STREAMS> vertexBuffers{};
+		std::array<VkDeviceSize, MAX_VERTEX_STREAMS> vertexOffsets{};
+		uint32_t vertexStreamCount = 0;
+		// VK_NULL_HANDLE for non-indexed meshes
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		VkDeviceSize indexOffset = 0;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+	};
+
+	struct DrawPacket
+	{
+		uint64_t sortKey = 0;
+		const AppPipeline* pipeline = nullptr;
+		// the material's descriptor set is bound at MATERIAL_SET against this layout
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkDescriptorSet material = VK_NULL_HANDLE;
+		// null draws without vertex buffers, e.g. vertices generated in the shader
+		const MeshBinding* mesh = nullptr;
+		// vertices, or indices for indexed meshes
+		uint32_t count = 0;
+		uint32_t instanceCount = 1;
+		// first vertex, or first index for indexed meshes
+		uint32_t first = 0;
+		int32_t vertexOffset = 0;
+		uint32_t firstInstance = 0;
+		// pushed at offset 0 against layout when set, e.g. a mesh's dequantization. must outlive the recording
+		const void* pushConstants = nullptr;
+		uint32_t pushConstantSize = 0;
+		VkShaderStageFlags pushConstantStages = 0;
+	};
+
+	// Draw packets pushed during the frame, radix sorted by key so neighbours share state and the encoder
+	// can drop their binds. Push and Sort are for one thread, Record may run on disjoint ranges in parallel.
+	class AppRenderQueue
+	{
+	public:
+		static constexpr uint32_t MATERIAL_SET = 0;
+
+		// small ids for the key fields, assigned on first use in a frame and forgotten by Clear, so only the
+		// states of one frame count against the id range. they order draws, nothing else
+		uint32_t PipelineId(const AppPipeline* pipeline);
+		uint32_t MaterialId(VkDescriptorSet material);
+		uint32_t MeshId(const MeshBinding* mesh);
+
+		void Push(const DrawPacket& packet);
+		void Sort();
+		// records sorted packets [begin, end), one encoder per range
+		void Record(AppCommandEncoder& encoder, size_t begin, size_t end) const;
+		// after the frame was recorded, keeps the storage for the next one and starts the ids over
+		void Clear();
+
+		[[nodiscard]] size_t Size() const { return _packets.size(); }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		static uint32_t Intern(std::unordered_map<const void*, uint32_t>& ids, const void* state);
+
+		std::vector<DrawPacket> _packets;
+		// sorted indices into _packets, and the key and index scratch the radix passes ping-pong through
+		std::vector<uint32_t> _order;
+		std::vector<uint64_t> _keys;
+		std::vector<uint64_t> _keyScratch;
+		std::vector<uint32_t> _orderScratch;
+
+		std::unordered_map<const void*, uint32_t> _pipelineIds;
+		std::unordered_map<const void*, uint32_t> _materialIds;
+		std::unordered_map<const void*, uint32_t> _meshIds;
+
+		uint64_t _sortPasses = 0;
+		uint64_t _sortPassesSkipped = 0;
+		mutable std::atomic<uint64_t> _draws{0};
+	};
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VulkanTest
+{
+	// What FirstApp renders into, a presentable swap chain or offscreen images when running headless.
+	// Both pace frames the same way: MAX_FRAMES_IN_FLIGHT fences and one fence per image.
+	class AppRenderTarget
+	{
+	public:
+		static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+
+		virtual ~AppRenderTarget() = default;
+
+		[[nodiscard]] virtual VkFramebuffer GetFrameBuffer(size_t index) const = 0;
+		[[nodiscard]] virtual VkRenderPass GetRenderPass() const = 0;
+		// compatible with GetRenderPass and its framebuffers but loads color and depth instead of clearing,
+		// for a second pass that keeps drawing into what the first one stored
+		[[nodiscard]] virtual VkRenderPass GetLoadRenderPass() const = 0;
+		[[nodiscard]] virtual size_t ImageCount() const = 0;
+		[[nodiscard]] virtual VkFormat GetImageFormat() const = 0;
+		[[nodiscard]] virtual VkExtent2D GetExtent() const = 0;
+		// the depth attachment of each framebuffer, stored and sampleable. both passes leave it in
+		// DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		[[nodiscard]] virtual VkImage GetDepthImage(size_t index) const = 0;
+		[[nodiscard]] virtual VkImageView GetDepthImageView(size_t index) const = 0;
+		[[nodiscard]] virtual VkFormat GetDepthFormat() const = 0;
+		// frame slot the next AcquireNextImage waits on, in [0, MAX_FRAMES_IN_FLIGHT)
+		[[nodiscard]] virtual size_t CurrentFrame() const = 0;
+
+		[[nodiscard]] uint32_t Width() const { return GetExtent().width; }
+		[[nodiscard]] uint32_t Height() const { return GetExtent().height; }
+
+		[[nodiscard]] float ExtentAspectRatio() const
+		{
+			return static_cast<float>(GetExtent().width) / static_cast<float>(GetExtent().height);
+		}
+
+		// waits for the frame slot to free up and picks the image to record into
+		virtual VkResult AcquireNextImage(uint32_t* imageIndex) = 0;
+		virtual VkResult SubmitCommandBuffers(const VkCommandBuffer* buffers, const uint32_t* imageIndex) = 0;
+
+		// rebuilds size dependent resources without stalling frames still in flight.
+		// returns true if the render pass was replaced, pipelines built against the old one must be rebuilt.
+		// fixed size targets ignore it.
+		virtual bool Recreate(VkExtent2D /*extent*/) { return false; }
+	};
+}
@@ -0,0 +1,156 @@
+#include "app_shader_permutations.hpp"
+
+#include <mutex>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	AppShaderPermutations::AppShaderPermutations(std::string name,
+	                                             AppPipelineLibrary& library,
+	                                             std::vector<char> vertCode,
+	                                             std::vector<char> fragCode,
+	                                             std::vector<ShaderFeature> features,
+	                                             ConfigureFunction configure)
+		: _name{std::move(name)},
+		  _library{library},
+		  _vertCode{std::move(vertCode)},
+		  _fragCode{std::move(fragCode)},
+		  _features{std::move(features)},
+		  _configure{std::move(configure)}
+	{
+		for (size_t i = 0; i < _features.size(); i++)
+		{
+			if (_features[i].defaultValue > _features[i].maxValue)
+				throw std::runtime_error("shader feature " + _features[i].name + " has its default past its max!");
+
+			for (size_t j = 0; j < i; j++)
+			{
+				if (_features[j].name == _features[i].name || _features[j].constantId == _features[i].constantId)
+					throw std::runtime_error("shader feature " + _features[i].name + " is declared twice!");
+			}
+		}
+	}
+
+	PermutationValues AppShaderPermutations::Defaults() const
+	{
+		PermutationValues values;
+		values.reserve(_features.size());
+		for (const auto& feature : _features)
+			values.push_back(feature.defaultValue);
+		return values;
+	}
+
+	void AppShaderPermutations::Set(PermutationValues& values, const std::string& feature,
+	                                const uint32_t value) const
+	{
+		for (size_t i = 0; i < _features.size(); i++)
+		{
+			if (_features[i].name != feature)
+				continue;
+
+			if (value > _features[i].maxValue)
+				throw std::runtime_error("value out of range for shader feature " + feature + "!");
+
+			values.resize(_features.size());
+			values[i] = value;
+			return;
+		}
+
+		throw std::runtime_error(_name + " has no shader feature " + feature + "!");
+	}
+
+	void AppShaderPermutations::Precompile(const PermutationValues& values)
+	{
+		Validate(values);
+		_library.PrecompileParts(Describe(values));
+	}
+
+	std::shared_ptr<PipelineHandle> AppShaderPermutations::Get(const PermutationValues& values)
+	{
+		Validate(values);
+		_requests++;
+
+		{
+			std::shared_lock<std::shared_mutex> lock(_mutex);
+			if (const auto found = _permutations.find(values); found != _permutations.end())
+				return found->second;
+		}
+
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		if (const auto found = _permutations.find(values); found != _permutations.end())
+			return found->second;
+
+		_built++;
+		// parts not built yet still get queued, later permutations sharing them can link
+		_library.PrecompileParts(Describe(values));
+		auto handle = _library.Link(Describe(values));
+		_permutations.emplace(values, handle);
+		return handle;
+	}
+
+	std::shared_ptr<PipelineHandle> AppShaderPermutations::Find(const PermutationValues& values) const
+	{
+		std::shared_lock<std::shared_mutex> lock(_mutex);
+		const auto found = _permutations.find(values);
+		return found != _permutations.end() ? found->second : nullptr;
+	}
+
+	void AppShaderPermutations::Clear()
+	{
+		std::unique_lock<std::shared_mutex> lock(_mutex);
+		_permutations.clear();
+	}
+
+	size_t AppShaderPermutations::LiveCount() const
+	{
+		std::shared_lock<std::shared_mutex> lock(_mutex);
+		return _permutations.size();
+	}
+
+	void AppShaderPermutations::PrintStats(std::ostream& out) const
+	{
+		out << "shader_permutations name=" << _name << " features=" << _features.size() << " live=" << LiveCount()
+			<< " built=" << _built << " requests=" << _requests << std::endl;
+	}
+
+	size_t AppShaderPermutations::ValuesHasher::operator()(const PermutationValues& values) const
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (const uint32_t value : values)
+		{
+			hash ^= value;
+			hash *= 0x100000001b3ull;
+		}
+		return static_cast<size_t>(hash);
+	}
+
+	void AppShaderPermutations::Validate(const PermutationValues& values) const
+	{
+		if (values.size() != _features.size())
+			throw std::runtime_error(_name + " expects one value per shader feature!");
+
+		for (size_t i = 0; i < values.size(); i++)
+		{
+			if (values[i] > _features[i].maxValue)
+				throw std::runtime_error("value out of range for shader feature " + _features[i].name + "!");
+		}
+	}
+
+	std::unique_ptr<PipelineDescription> AppShaderPermutations::Describe(const PermutationValues& values) const
+	{
+		auto description = std::make_unique<PipelineDescription>();
+		description->vertCode = _vertCode;
+		description->fragCode = _fragCode;
+		_configure(description->config);
+
+		for (size_t i = 0; i < _features.size(); i++)
+		{
+			if (_features[i].stages & VK_SHADER_STAGE_VERTEX_BIT)
+				description->vertConstants.Set(_features[i].constantId, values[i]);
+			if (_features[i].stages & VK_SHADER_STAGE_FRAGMENT_BIT)
+				description->fragConstants.Set(_features[i].constantId, values[i]);
+		}
+
+		return description;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "app_pipeline_library.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace VulkanTest
+{
+	// One feature switch of a shader, declared in GLSL as layout(constant_id = constantId) const ...
+	// Light counts, alpha test, quality tiers: anything the driver should constant-fold per pipeline.
+	struct ShaderFeature
+	{
+		std::string name;
+		uint32_t constantId = 0;
+		VkShaderStageFlags stages = VK_SHADER_STAGE_FRAGMENT_BIT;
+		uint32_t defaultValue = 0;
+		// larger values are rejected, keeps the number of possible permutations bounded
+		uint32_t maxValue = 1;
+	};
+
+	// the chosen value of every feature, in the order the features were declared
+	using PermutationValues = std::vector<uint32_t>;
+
+	// Specialized pipelines of one vertex/fragment pair, built on first request and reused afterwards.
+	// Linking, compilation and deduplication go through the pipeline library, this only maps feature values
+	// to pipeline handles.
+	class AppShaderPermutations
+	{
+	public:
+		// fills fixed function state, layout and render pass, called once per new permutation
+		using ConfigureFunction = std::function<void(PipelineConfigInfo&)>;
+
+		AppShaderPermutations(std::string name,
+		                      AppPipelineLibrary& library,
+		                      std::vector<char> vertCode,
+		                      std::vector<char> fragCode,
+		                      std::vector<ShaderFeature> features,
+		                      ConfigureFunction configure);
+
+		AppShaderPermutations(const AppShaderPermutations&) = delete;
+		AppShaderPermutations& operator=(const AppShaderPermutations&) = delete;
+
+		[[nodiscard]] PermutationValues Defaults() const;
+		// throws for a feature this shader does not declare or a value past its maxValue
+		void Set(PermutationValues& values, const std::string& feature, uint32_t value) const;
+
+		// queues the library parts of these values on the job pool and returns, at load time so the first Get
+		// can link them instead of drawing with the fallback
+		void Precompile(const PermutationValues& values);
+		// links on the first request for these values, later ones get the same handle. draws with the fallback
+		// until the optimized pipeline is ready if the parts were not precompiled
+		std::shared_ptr<PipelineHandle> Get(const PermutationValues& values);
+		// for draw submission: never links, null if not requested yet
+		[[nodiscard]] std::shared_ptr<PipelineHandle> Find(const PermutationValues& values) const;
+
+		// forgets every permutation, e.g. after the render pass was replaced. the library and registry keep
+		// the old pipelines alive
+		void Clear();
+
+		[[nodiscard]] size_t LiveCount() const;
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		struct ValuesHasher
+		{
+			size_t operator()(const PermutationValues& values) const;
+		};
+
+		void Validate(const PermutationValues& values) const;
+		[[nodiscard]] std::unique_ptr<PipelineDescription> Describe(const PermutationValues& values) const;
+
+		std::string _name;
+		AppPipelineLibrary& _library;
+		std::vector<char> _vertCode;
+		std::vector<char> _fragCode;
+		std::vector<ShaderFeature> _features;
+		ConfigureFunction _configure;
+
+		mutable std::shared_mutex _mutex;
+		std::unordered_map<PermutationValues, std::shared_ptr<PipelineHandle>, ValuesHasher> _permutations;
+
+		std::atomic<uint64_t> _requests{0};
+		std::atomic<uint64_t> _built{0};
+	};
+}
@@ -0,0 +1,608 @@
+#include "app_shader_reflection.hpp"
+#include "app_pipline.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		// the few parts of the SPIR-V grammar reflection needs, spirv.h is not part of the build
+		constexpr uint32_t SPIRV_MAGIC = 0x07230203u;
+		constexpr size_t SPIRV_HEADER_WORDS = 5;
+
+		enum Op : uint32_t
+		{
+			OP_NAME = 5,
+			OP_ENTRY_POINT = 15,
+			OP_EXECUTION_MODE = 16,
+			OP_TYPE_BOOL = 20,
+			OP_TYPE_INT = 21,
+			OP_TYPE_FLOAT = 22,
+			OP_TYPE_VECTOR = 23,
+			OP_TYPE_MATRIX = 24,
+			OP_TYPE_IMAGE = 25,
+			OP_TYPE_SAMPLER = 26,
+			OP_TYPE_SAMPLED_IMAGE = 27,
+			OP_TYPE_ARRAY = 28,
+			OP_TYPE_RUNTIME_ARRAY = 29,
+			OP_TYPE_STRUCT = 30,
+			OP_TYPE_POINTER = 32,
+			OP_CONSTANT = 43,
+			OP_SPEC_CONSTANT = 50,
+			OP_VARIABLE = 59,
+			OP_DECORATE = 71,
+			OP_MEMBER_DECORATE = 72,
+			OP_EXECUTION_MODE_ID = 331,
+			OP_TYPE_ACCELERATION_STRUCTURE = 5341
+		};
+
+		enum Decoration : uint32_t
+		{
+			DECORATION_BLOCK = 2,
+			DECORATION_BUFFER_BLOCK = 3,
+			DECORATION_ARRAY_STRIDE = 6,
+			DECORATION_MATRIX_STRIDE = 7,
+			DECORATION_BUILT_IN = 11,
+			DECORATION_LOCATION = 30,
+			DECORATION_BINDING = 33,
+			DECORATION_DESCRIPTOR_SET = 34,
+			DECORATION_OFFSET = 35
+		};
+
+		enum StorageClass : uint32_t
+		{
+			STORAGE_UNIFORM_CONSTANT = 0,
+			STORAGE_INPUT = 1,
+			STORAGE_UNIFORM = 2,
+			STORAGE_PUSH_CONSTANT = 9,
+			STORAGE_STORAGE_BUFFER = 12
+		};
+
+		constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE = 17;
+		constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE_ID = 38;
+
+		constexpr uint32_t DIM_BUFFER = 5;
+		constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+		// decorations that matter here, UINT32_MAX where absent
+		struct Decorations
+		{
+			uint32_t set = UINT32_MAX;
+			uint32_t binding = UINT32_MAX;
+			uint32_t location = UINT32_MAX;
+			uint32_t offset = UINT32_MAX;
+			uint32_t arrayStride = 0;
+			uint32_t matrixStride = 0;
+			bool builtIn = false;
+			bool block = false;
+			bool bufferBlock = false;
+		};
+
+		struct Type
+		{
+			uint32_t op = 0;
+			// operands after the result id
+			std::vector<uint32_t> operands;
+		};
+
+		struct Variable
+		{
+			uint32_t id = 0;
+			uint32_t pointerType = 0;
+			uint32_t storageClass = 0;
+		};
+
+		class Module
+		{
+		public:
+			explicit Module(const std::vector<char>& code)
+			{
+				if (code.size() % sizeof(uint32_t) != 0 || code.size() < SPIRV_HEADER_WORDS * sizeof(uint32_t))
+					throw std::runtime_error("failed to reflect shader, not a SPIR-V module!");
+
+				_words.resize(code.size() / sizeof(uint32_t));
+				std::memcpy(_words.data(), code.data(), code.size());
+				if (_words[0] != SPIRV_MAGIC)
+					throw std::runtime_error("failed to reflect shader, bad SPIR-V magic!");
+
+				Parse();
+			}
+
+			const Type& GetType(const uint32_t id) const
+			{
+				const auto found = _types.find(id);
+				if (found == _types.end())
+					throw std::runtime_error("failed to reflect shader, unknown type id!");
+				return found->second;
+			}
+
+			Decorations GetDecorations(const uint32_t id) const
+			{
+				const auto found = _decorations.find(id);
+				return found != _decorations.end() ? found->second : Decorations{};
+			}
+
+			Decorations GetMemberDecorations(const uint32_t structId, const uint32_t member) const
+			{
+				const auto found = _memberDecorations.find(structId);
+				if (found == _memberDecorations.end() || member >= found->second.size())
+					return {};
+				return found->second[member];
+			}
+
+			std::string GetName(const uint32_t id) const
+			{
+				const auto found = _names.find(id);
+				return found != _names.end() ? found->second : std::string{};
+			}
+
+			uint32_t GetConstant(const uint32_t id) const
+			{
+				const auto found = _constants.find(id);
+				if (found == _constants.end())
+					throw std::runtime_error("failed to reflect shader, array length is not a constant!");
+				return found->second;
+			}
+
+			// in bytes, laid out as the block's Offset/ArrayStride/MatrixStride decorations say
+			uint32_t SizeOf(const uint32_t typeId, const uint32_t matrixStride = 0) const
+			{
+				const Type& type = GetType(typeId);
+				switch (type.op)
+				{
+				case OP_TYPE_BOOL:
+					return 4;
+				case OP_TYPE_INT:
+				case OP_TYPE_FLOAT:
+					return type.operands[0] / 8;
+				case OP_TYPE_VECTOR:
+					return type.operands[1] * SizeOf(type.operands[0]);
+				case OP_TYPE_MATRIX:
+					return type.operands[1] * (matrixStride != 0 ? matrixStride : SizeOf(type.operands[0]));
+				case OP_TYPE_ARRAY:
+				{
+					const uint32_t stride = GetDecorations(typeId).arrayStride;
+					return GetConstant(type.operands[1]) * (stride != 0 ? stride : SizeOf(type.operands[0]));
+				}
+				case OP_TYPE_STRUCT:
+				{
+					uint32_t size = 0;
+					for (uint32_t member = 0; member < type.operands.size(); member++)
+					{
+						const Decorations decorations = GetMemberDecorations(typeId, member);
+						const uint32_t offset = decorations.offset != UINT32_MAX ? decorations.offset : size;
+						size = std::max(size, offset + SizeOf(type.operands[member], decorations.matrixStride));
+					}
+					return size;
+				}
+				default:
+					throw std::runtime_error("failed to reflect shader, block member of unsized type!");
+				}
+			}
+
+			uint32_t executionModel = UINT32_MAX;
+			std::string entryPoint;
+			std::array<uint32_t, 3> localSize{1, 1, 1};
+			std::vector<Variable> variables;
+
+		private:
+			std::string ReadString(const size_t word, const size_t end) const
+			{
+				std::string text;
+				for (size_t i = word; i < end; i++)
+				{
+					for (size_t byte = 0; byte < 4; byte++)
+					{
+						const char c = static_cast<char>((_words[i] >> (byte * 8)) & 0xff);
+						if (c == '\0')
+							return text;
+						text.push_back(c);
+					}
+				}
+				return text;
+			}
+
+			Decorations& MemberDecorations(const uint32_t structId, const uint32_t member)
+			{
+				auto& members = _memberDecorations[structId];
+				if (member >= members.size())
+					members.resize(member + 1);
+				return members[member];
+			}
+
+			static void Apply(Decorations& decorations, const uint32_t decoration, const uint32_t literal)
+			{
+				switch (decoration)
+				{
+				case DECORATION_BLOCK: decorations.block = true;
+					break;
+				case DECORATION_BUFFER_BLOCK: decorations.bufferBlock = true;
+					break;
+				case DECORATION_ARRAY_STRIDE: decorations.arrayStride = literal;
+					break;
+				case DECORATION_MATRIX_STRIDE: decorations.matrixStride = literal;
+					break;
+				case DECORATION_BUILT_IN: decorations.builtIn = true;
+					break;
+				case DECORATION_LOCATION: decorations.location = literal;
+					break;
+				case DECORATION_BINDING: decorations.binding = literal;
+					break;
+				case DECORATION_DESCRIPTOR_SET: decorations.set = literal;
+					break;
+				case DECORATION_OFFSET: decorations.offset = literal;
+					break;
+				default:
+					break;
+				}
+			}
+
+			void Parse()
+			{
+				size_t word = SPIRV_HEADER_WORDS;
+				while (word < _words.size())
+				{
+					const uint32_t op = _words[word] & 0xffffu;
+					const uint32_t count = _words[word] >> 16;
+					if (count == 0 || word + count > _words.size())
+						throw std::runtime_error("failed to reflect shader, truncated instruction!");
+
+					const uint32_t* operands = &_words[word + 1];
+					const size_t end = word + count;
+
+					switch (op)
+					{
+					case OP_NAME:
+						_names[operands[0]] = ReadString(word + 2, end);
+						break;
+					case OP_ENTRY_POINT:
+						// the first entry point is the one the pipeline uses
+						if (executionModel == UINT32_MAX)
+						{
+							executionModel = operands[0];
+							entryPoint = ReadString(word + 3, end);
+						}
+						break;
+					case OP_EXECUTION_MODE:
+						if (count >= 6 && operands[1] == EXECUTION_MODE_LOCAL_SIZE)
+							localSize = {operands[2], operands[3], operands[4]};
+						break;
+					case OP_EXECUTION_MODE_ID:
+						// the constants come later in the module, resolved once everything is read
+						if (count >= 6 && operands[1] == EXECUTION_MODE_LOCAL_SIZE_ID)
+							_localSizeIds = {operands[2], operands[3], operands[4]};
+						break;
+					case OP_TYPE_BOOL:
+					case OP_TYPE_INT:
+					case OP_TYPE_FLOAT:
+					case OP_TYPE_VECTOR:
+					case OP_TYPE_MATRIX:
+					case OP_TYPE_IMAGE:
+					case OP_TYPE_SAMPLER:
+					case OP_TYPE_SAMPLED_IMAGE:
+					case OP_TYPE_ARRAY:
+					case OP_TYPE_RUNTIME_ARRAY:
+					case OP_TYPE_STRUCT:
+					case OP_TYPE_POINTER:
+					case OP_TYPE_ACCELERATION_STRUCTURE:
+						_types[operands[0]] = {op, {operands + 1, operands + (count - 1)}};
+						break;
+					case OP_CONSTANT:
+					case OP_SPEC_CONSTANT:
+						// only 32 bit values can size arrays, wider ones keep their low word
+						if (count > 3)
+							_constants[operands[1]] = operands[2];
+						break;
+					case OP_VARIABLE:
+						variables.push_back({operands[1], operands[0], operands[2]});
+						break;
+					case OP_DECORATE:
+						if (count >= 3)
+							Apply(_decorations[operands[0]], operands[1], count > 3 ? operands[2] : 0);
+						break;
+					case OP_MEMBER_DECORATE:
+						if (count >= 4)
+							Apply(MemberDecorations(operands[0], operands[1]), operands[2], count > 4 ? operands[3] : 0);
+						break;
+					default:
+						break;
+					}
+
+					word = end;
+				}
+
+				if (executionModel == UINT32_MAX)
+					throw std::runtime_error("failed to reflect shader, no entry point!");
+
+				if (_localSizeIds[0] != 0)
+				{
+					for (size_t i = 0; i < 3; i++)
+						localSize[i] = GetConstant(_localSizeIds[i]);
+				}
+			}
+
+			std::vector<uint32_t> _words;
+			std::array<uint32_t, 3> _localSizeIds{};
+			std::unordered_map<uint32_t, std::string> _names;
+			std::unordered_map<uint32_t, Type> _types;
+			std::unordered_map<uint32_t, uint32_t> _constants;
+			std::unordered_map<uint32_t, Decorations> _decorations;
+			std::unordered_map<uint32_t, std::vector<Decorations>> _memberDecorations;
+		};
+
+		VkShaderStageFlagBits StageFromExecutionModel(const uint32_t model)
+		{
+			switch (model)
+			{
+			case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+			case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+			case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+			case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+			case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+			default:
+				throw std::runtime_error("failed to reflect shader, unsupported execution model!");
+			}
+		}
+
+		// everything but buffer blocks in the Uniform class
+		VkDescriptorType DescriptorTypeOf(const Type& type, const uint32_t storageClass)
+		{
+			if (storageClass == STORAGE_STORAGE_BUFFER)
+				return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+			switch (type.op)
+			{
+			case OP_TYPE_SAMPLER:
+				return VK_DESCRIPTOR_TYPE_SAMPLER;
+			case OP_TYPE_SAMPLED_IMAGE:
+				return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			case OP_TYPE_ACCELERATION_STRUCTURE:
+				return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+			case OP_TYPE_IMAGE:
+			{
+				const uint32_t dim = type.operands[1];
+				const uint32_t sampled = type.operands[5];
+				if (dim == DIM_BUFFER)
+					return sampled == 1 ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+				if (dim == DIM_SUBPASS_DATA)
+					return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				return sampled == 1 ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			}
+			default:
+				break;
+			}
+
+			throw std::runtime_error("failed to reflect shader, unsupported descriptor type!");
+		}
+
+		VkFormat VertexFormat(const Type& component, const uint32_t components)
+		{
+			if (component.operands[0] != 32)
+				throw std::runtime_error("failed to reflect shader, only 32 bit vertex inputs are supported!");
+
+			static constexpr VkFormat floats[] = {
+				VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT
+			};
+			static constexpr VkFormat sints[] = {
+				VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT
+			};
+			static constexpr VkFormat uints[] = {
+				VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT
+			};
+
+			if (component.op == OP_TYPE_FLOAT)
+				return floats[components - 1];
+			return component.operands[1] != 0 ? sints[components - 1] : uints[components - 1];
+		}
+
+		// one entry per location the type occupies: matrices by column, arrays by element
+		void AddVertexInputs(const Module& module, const uint32_t typeId, uint32_t& location, const std::string& name,
+		                     std::vector<ReflectedVertexInput>& inputs)
+		{
+			const Type& type = module.GetType(typeId);
+			switch (type.op)
+			{
+			case OP_TYPE_INT:
+			case OP_TYPE_FLOAT:
+				inputs.push_back({location++, VertexFormat(type, 1), 4, name});
+				break;
+			case OP_TYPE_VECTOR:
+			{
+				const uint32_t components = type.operands[1];
+				inputs.push_back({location++, VertexFormat(module.GetType(type.operands[0]), components), 4 * components, name});
+				break;
+			}
+			case OP_TYPE_MATRIX:
+				for (uint32_t column = 0; column < type.operands[1]; column++)
+					AddVertexInputs(module, type.operands[0], location, name, inputs);
+				break;
+			case OP_TYPE_ARRAY:
+				for (uint32_t element = 0; element < module.GetConstant(type.operands[1]); element++)
+					AddVertexInputs(module, type.operands[0], location, name, inputs);
+				break;
+			default:
+				throw std::runtime_error("failed to reflect shader, unsupported vertex input type for " + name + "!");
+			}
+		}
+	}
+
+	ShaderReflection ShaderReflection::Reflect(const std::vector<char>& code)
+	{
+		const Module module{code};
+
+		ShaderReflection reflection;
+		reflection.stage = StageFromExecutionModel(module.executionModel);
+		reflection.entryPoint = module.entryPoint;
+		reflection.localSize = module.localSize;
+
+		for (const auto& variable : module.variables)
+		{
+			const Type& pointer = module.GetType(variable.pointerType);
+			const uint32_t pointeeId = pointer.operands[1];
+			const Decorations decorations = module.GetDecorations(variable.id);
+			const std::string name = module.GetName(variable.id);
+
+			switch (variable.storageClass)
+			{
+			case STORAGE_UNIFORM_CONSTANT:
+			case STORAGE_UNIFORM:
+			case STORAGE_STORAGE_BUFFER:
+			{
+				if (decorations.binding == UINT32_MAX)
+					continue;
+
+				// arrays of descriptors, the element decides the type
+				uint32_t typeId = pointeeId;
+				uint32_t count = 1;
+				while (module.GetType(typeId).op == OP_TYPE_ARRAY || module.GetType(typeId).op == OP_TYPE_RUNTIME_ARRAY)
+				{
+					const Type& array = module.GetType(typeId);
+					if (array.op == OP_TYPE_RUNTIME_ARRAY)
+						throw std::runtime_error("failed to reflect shader, unbounded descriptor array " + name + "!");
+					count *= module.GetConstant(array.operands[1]);
+					typeId = array.operands[0];
+				}
+
+				const Type& type = module.GetType(typeId);
+				VkDescriptorType descriptorType;
+				if (type.op == OP_TYPE_STRUCT && variable.storageClass == STORAGE_UNIFORM)
+				{
+					// SPIR-V before 1.3 marks storage buffers as BufferBlock in the Uniform class
+					descriptorType = module.GetDecorations(typeId).bufferBlock
+						                 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+						                 : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				}
+				else
+					descriptorType = DescriptorTypeOf(type, variable.storageClass);
+
+				reflection.bindings.push_back({
+					decorations.set != UINT32_MAX ? decorations.set : 0, decorations.binding, descriptorType, count,
+					static_cast<VkShaderStageFlags>(reflection.stage),
+					name.empty() ? module.GetName(typeId) : name
+				});
+				break;
+			}
+			case STORAGE_PUSH_CONSTANT:
+			{
+				const Type& block = module.GetType(pointeeId);
+				uint32_t offset = UINT32_MAX;
+				for (uint32_t member = 0; member < block.operands.size(); member++)
+					offset = std::min(offset, module.GetMemberDecorations(pointeeId, member).offset);
+
+				const uint32_t size = module.SizeOf(pointeeId);
+				if (offset == UINT32_MAX || offset >= size)
+					offset = 0;
+
+				// only what the stage actually declares, layout(offset = N) blocks start at N
+				reflection.pushConstants.stageFlags = reflection.stage;
+				reflection.pushConstants.offset = offset;
+				reflection.pushConstants.size = size - offset;
+				break;
+			}
+			case STORAGE_INPUT:
+			{
+				if (reflection.stage != VK_SHADER_STAGE_VERTEX_BIT || decorations.builtIn ||
+					decorations.location == UINT32_MAX)
+					continue;
+
+				uint32_t location = decorations.location;
+				AddVertexInputs(module, pointeeId, location, name, reflection.inputs);
+				break;
+			}
+			default:
+				break;
+			}
+		}
+
+		std::sort(reflection.bindings.begin(), reflection.bindings.end(),
+		          [](const ReflectedBinding& a, const ReflectedBinding& b)
+		          {
+			          return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		          });
+		std::sort(reflection.inputs.begin(), reflection.inputs.end(),
+		          [](const ReflectedVertexInput& a, const ReflectedVertexInput& b) { return a.location < b.location; });
+
+		return reflection;
+	}
+
+	PipelineInterface PipelineInterface::Merge(const std::vector<ShaderReflection>& stages)
+	{
+		PipelineInterface merged;
+
+		for (const auto& stage : stages)
+		{
+			for (const auto& binding : stage.bindings)
+			{
+				if (merged.sets.size() <= binding.set)
+					merged.sets.resize(binding.set + 1);
+
+				auto& set = merged.sets[binding.set];
+				const auto existing = std::find_if(set.begin(), set.end(), [&](const VkDescriptorSetLayoutBinding& b)
+				{
+					return b.binding == binding.binding;
+				});
+
+				if (existing == set.end())
+				{
+					set.push_back({binding.binding, binding.type, binding.count, binding.stages, nullptr});
+					continue;
+				}
+
+				if (existing->descriptorType != binding.type || existing->descriptorCount != binding.count)
+				{
+					throw std::runtime_error("shader stages disagree on set " + std::to_string(binding.set) +
+						" binding " + std::to_string(binding.binding) + "!");
+				}
+				existing->stageFlags |= binding.stages;
+			}
+
+			if (stage.pushConstants.size > 0)
+			{
+				const auto existing = std::find_if(
+					merged.pushConstantRanges.begin(), merged.pushConstantRanges.end(),
+					[&](const VkPushConstantRange& range)
+					{
+						return range.offset == stage.pushConstants.offset && range.size == stage.pushConstants.size;
+					});
+
+				if (existing != merged.pushConstantRanges.end())
+					existing->stageFlags |= stage.pushConstants.stageFlags;
+				else
+					merged.pushConstantRanges.push_back(stage.pushConstants);
+			}
+
+			if (stage.stage != VK_SHADER_STAGE_VERTEX_BIT || stage.inputs.empty())
+				continue;
+
+			uint32_t offset = 0;
+			for (const auto& input : stage.inputs)
+			{
+				merged.vertexAttributes.push_back({input.location, 0, input.format, offset});
+				offset += input.size;
+			}
+			merged.vertexBindings.push_back({0, offset, VK_VERTEX_INPUT_RATE_VERTEX});
+		}
+
+		for (auto& set : merged.sets)
+		{
+			std::sort(set.begin(), set.end(), [](const VkDescriptorSetLayoutBinding& a,
+			                                     const VkDescriptorSetLayoutBinding& b)
+			{
+				return a.binding < b.binding;
+			});
+		}
+
+		return merged;
+	}
+
+	void PipelineInterface::ApplyVertexInput(PipelineConfigInfo& configInfo) const
+	{
+		configInfo.vertexBindings = vertexBindings;
+		configInfo.vertexAttributes = vertexAttributes;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace VulkanTest
+{
+	struct PipelineConfigInfo;
+
+	struct ReflectedBinding
+	{
+		uint32_t set = 0;
+		uint32_t binding = 0;
+		VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		uint32_t count = 1;
+		VkShaderStageFlags stages = 0;
+		std::string name;
+	};
+
+	struct ReflectedVertexInput
+	{
+		uint32_t location = 0;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t size = 0;
+		std::string name;
+	};
+
+	// The resource interface of one SPIR-V module, read straight from the binary: descriptor bindings,
+	// the push constant block and, for vertex shaders, the vertex inputs.
+	struct ShaderReflection
+	{
+		VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+		std::string entryPoint;
+		// sorted by set, then binding
+		std::vector<ReflectedBinding> bindings;
+		// size 0 when the stage has no push constant block
+		VkPushConstantRange pushConstants{};
+		// vertex stage only, one entry per location (a mat4 takes four), sorted by location
+		std::vector<ReflectedVertexInput> inputs;
+		// compute stage only, layout(local_size_x = ...) in
+		std::array<uint32_t, 3> localSize{1, 1, 1};
+
+		// throws for anything that is not valid SPIR-V or uses a resource this cannot describe
+		static ShaderReflection Reflect(const std::vector<char>& code);
+	};
+
+	// Everything a pipeline needs from its shaders, merged over all stages. Bindings used by several
+	// stages are merged into one with both stage bits, conflicting declarations throw.
+	struct PipelineInterface
+	{
+		// indexed by set number, sets no stage uses in between stay empty. sorted by binding
+		std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+		// one range per distinct block, stages sharing an identical block share the range
+		std::vector<VkPushConstantRange> pushConstantRanges;
+		// vertex inputs interleaved into binding 0 in location order
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+
+		static PipelineInterface Merge(const std::vector<ShaderReflection>& stages);
+
+		void ApplyVertexInput(PipelineConfigInfo& configInfo) const;
+	};
+}
@@ -0,0 +1,354 @@
+#include "app_software_occlusion.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VULKANTEST_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace VulkanTest
+{
+	namespace
+	{
+		// vertices closer to the eye than this are not projected, their triangle or box is left to the gpu
+		constexpr float MIN_W = 1e-5f;
+		// in pixels squared, thinner triangles cover no pixel center worth the setup
+		constexpr float MIN_AREA = 1e-6f;
+		constexpr float CLEAR_DEPTH = 1.0f;
+		// boxes per job pool range, testing one is a few hundred cycles
+		constexpr size_t MIN_BOXES_PER_RANGE = 256;
+		constexpr size_t MIN_TILES_PER_RANGE = 4;
+
+		std::array<float, 4> Transform(const std::array<float, 16>& matrix, const std::array<float, 3>& position)
+		{
+			std::array<float, 4> clip{};
+			for (int r = 0; r < 4; r++)
+				clip[r] = matrix[r] * position[0] + matrix[4 + r] * position[1] + matrix[8 + r] * position[2] + matrix[12 + r];
+			return clip;
+		}
+	}
+
+	AppSoftwareOcclusion::AppSoftwareOcclusion(AppJobPool& jobPool, const uint32_t width, const uint32_t height)
+		: _jobPool{jobPool},
+		  _tilesX{std::max((width + TILE_WIDTH - 1) / TILE_WIDTH, 1u)},
+		  _tilesY{std::max((height + TILE_HEIGHT - 1) / TILE_HEIGHT, 1u)}
+	{
+		_width = _tilesX * TILE_WIDTH;
+		_height = _tilesY * TILE_HEIGHT;
+		_depth.assign(static_cast<size_t>(_width) * _height, CLEAR_DEPTH);
+		_tileMaxDepth.assign(static_cast<size_t>(_tilesX) * _tilesY, CLEAR_DEPTH);
+
+		// one binning group per thread that can run one
+		const uint32_t groups = jobPool.ThreadCount() + 1;
+		_bins.resize(groups, std::vector<std::vector<uint32_t>>(_tileMaxDepth.size()));
+		_groupTriangles.resize(groups);
+	}
+
+	void AppSoftwareOcclusion::AddOccluder(const std::vector<std::array<float, 3>>& positions,
+	                                       const std::vector<uint32_t>& indices)
+	{
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			_occluderTriangles.push_back({positions.at(indices[i]), positions.at(indices[i + 1]), positions.at(indices[i + 2])});
+	}
+
+	void AppSoftwareOcclusion::ClearOccluders()
+	{
+		_occluderTriangles.clear();
+	}
+
+	bool AppSoftwareOcclusion::SetupTriangle(const size_t triangle, ScreenTriangle& screen) const
+	{
+		// x, y in pixels and z in [0, 1]
+		std::array<std::array<float, 3>, 3> v{};
+		for (size_t k = 0; k < 3; k++)
+		{
+			const std::array<float, 4> clip = Transform(_viewProjection, _occluderTriangles[triangle][k]);
+			if (clip[3] <= MIN_W || clip[2] < 0.0f)
+				return false;
+			const float invW = 1.0f / clip[3];
+			v[k] = {
+				(clip[0] * invW * 0.5f + 0.5f) * static_cast<float>(_width),
+				(clip[1] * invW * 0.5f + 0.5f) * static_cast<float>(_height),
+				clip[2] * invW
+			};
+		}
+
+		float area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) - (v[2][0] - v[0][0]) * (v[1][1] - v[0][1]);
+		if (std::fabs(area) < MIN_AREA)
+			return false;
+		// double sided, flipping the winding keeps the inside positive
+		if (area < 0.0f)
+		{
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		// pixels whose center lies within the triangle's bounds
+		const float minX = std::ceil(std::min({v[0][0], v[1][0], v[2][0]}) - 0.5f);
+		const float maxX = std::floor(std::max({v[0][0], v[1][0], v[2][0]}) - 0.5f);
+		const float minY = std::ceil(std::min({v[0][1], v[1][1], v[2][1]}) - 0.5f);
+		const float maxY = std::floor(std::max({v[0][1], v[1][1], v[2][1]}) - 0.5f);
+		if (maxX < 0.0f || maxY < 0.0f || minX > static_cast<float>(_width - 1) || minY > static_cast<float>(_height - 1) ||
+			minX > maxX || minY > maxY)
+			return false;
+		screen.minX = static_cast<uint32_t>(std::max(minX, 0.0f));
+		screen.minY = static_cast<uint32_t>(std::max(minY, 0.0f));
+		screen.maxX = static_cast<uint32_t>(std::min(maxX, static_cast<float>(_width - 1)));
+		screen.maxY = static_cast<uint32_t>(std::min(maxY, static_cast<float>(_height - 1)));
+
+		for (size_t k = 0; k < 3; k++)
+		{
+			const std::array<float, 3>& a = v[k];
+			const std::array<float, 3>& b = v[(k + 1) % 3];
+			const float edgeA = a[1] - b[1];
+			const float edgeB = b[0] - a[0];
+			screen.edges[k] = {edgeA, edgeB, -(edgeA * a[0] + edgeB * a[1])};
+		}
+
+		// the plane through the three depths
+		const float depthA = ((v[1][2] - v[0][2]) * (v[2][1] - v[0][1]) - (v[2][2] - v[0][2]) * (v[1][1] - v[0][1])) / area;
+		const float depthB = ((v[2][2] - v[0][2]) * (v[1][0] - v[0][0]) - (v[1][2] - v[0][2]) * (v[2][0] - v[0][0])) / area;
+		screen.depth = {depthA, depthB, v[0][2] - depthA * v[0][0] - depthB * v[0][1]};
+		return true;
+	}
+
+	void AppSoftwareOcclusion::RasterizeRows(const ScreenTriangle& triangle, const uint32_t minX, const uint32_t maxX,
+	                                         const uint32_t minY, const uint32_t maxY)
+	{
+		const auto& e = triangle.edges;
+		for (uint32_t y = minY; y <= maxY; y++)
+		{
+			const float py = static_cast<float>(y) + 0.5f;
+			const float row0 = e[0][1] * py + e[0][2];
+			const float row1 = e[1][1] * py + e[1][2];
+			const float row2 = e[2][1] * py + e[2][2];
+			const float rowDepth = triangle.depth[1] * py + triangle.depth[2];
+			float* depth = &_depth[static_cast<size_t>(y) * _width];
+
+#if defined(VULKANTEST_SSE2)
+			// four pixels at a time from the aligned group holding minX, tiles are whole groups so the last
+			// one never leaves the tile. pixels outside the triangle fail an edge and keep their depth
+			const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			const __m128 zero = _mm_setzero_ps();
+			for (uint32_t x = minX & ~3u; x <= maxX; x += 4)
+			{
+				const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+				const __m128 edge0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e[0][0]), px), _mm_set1_ps(row0));
+				const __m128 edge1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e[1][0]), px), _mm_set1_ps(row1));
+				const __m128 edge2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e[2][0]), px), _mm_set1_ps(row2));
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)),
+				                                 _mm_cmpge_ps(edge2, zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depth[0]), px), _mm_set1_ps(rowDepth));
+				const __m128 old = _mm_loadu_ps(depth + x);
+				_mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, z)), _mm_andnot_ps(inside, old)));
+			}
+#else
+			for (uint32_t x = minX; x <= maxX; x++)
+			{
+				const float px = static_cast<float>(x) + 0.5f;
+				if (e[0][0] * px + row0 >= 0.0f && e[1][0] * px + row1 >= 0.0f && e[2][0] * px + row2 >= 0.0f)
+					depth[x] = std::min(depth[x], triangle.depth[0] * px + rowDepth);
+			}
+#endif
+		}
+	}
+
+	void AppSoftwareOcclusion::RasterizeTile(const uint32_t tile)
+	{
+		const uint32_t minX = tile % _tilesX * TILE_WIDTH;
+		const uint32_t minY = tile / _tilesX * TILE_HEIGHT;
+		const uint32_t maxX = minX + TILE_WIDTH - 1;
+		const uint32_t maxY = minY + TILE_HEIGHT - 1;
+
+		for (uint32_t y = minY; y <= maxY; y++)
+			std::fill_n(&_depth[static_cast<size_t>(y) * _width + minX], TILE_WIDTH, CLEAR_DEPTH);
+
+		// depth only keeps the minimum, the order the groups binned in does not matter
+		for (const auto& group : _bins)
+		{
+			for (const uint32_t index : group[tile])
+			{
+				const ScreenTriangle& triangle = _screenTriangles[index];
+				RasterizeRows(triangle, std::max(triangle.minX, minX), std::min(triangle.maxX, maxX),
+				              std::max(triangle.minY, minY), std::min(triangle.maxY, maxY));
+			}
+		}
+
+		float maxDepth = 0.0f;
+		for (uint32_t y = minY; y <= maxY; y++)
+		{
+			const float* row = &_depth[static_cast<size_t>(y) * _width + minX];
+			maxDepth = std::max(maxDepth, *std::max_element(row, row + TILE_WIDTH));
+		}
+		_tileMaxDepth[tile] = maxDepth;
+	}
+
+	void AppSoftwareOcclusion::RenderOccluders()
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		const size_t triangleCount = _occluderTriangles.size();
+		const size_t groupCount = _bins.size();
+		_screenTriangles.resize(triangleCount);
+
+		// each group sets up a contiguous share of the triangles and bins them into its own lists
+		_jobPool.ParallelFor(groupCount, 1, [&](const size_t firstGroup, const size_t lastGroup)
+		{
+			for (size_t group = firstGroup; group < lastGroup; group++)
+			{
+				for (auto& bin : _bins[group])
+					bin.clear();
+
+				uint32_t setUp = 0;
+				for (size_t i = triangleCount * group / groupCount; i < triangleCount * (group + 1) / groupCount; i++)
+				{
+					ScreenTriangle& triangle = _screenTriangles[i];
+					if (!SetupTriangle(i, triangle))
+						continue;
+					setUp++;
+					for (uint32_t tileY = triangle.minY / TILE_HEIGHT; tileY <= triangle.maxY / TILE_HEIGHT; tileY++)
+					{
+						for (uint32_t tileX = triangle.minX / TILE_WIDTH; tileX <= triangle.maxX / TILE_WIDTH; tileX++)
+							_bins[group][tileY * _tilesX + tileX].push_back(static_cast<uint32_t>(i));
+					}
+				}
+				_groupTriangles[group] = setUp;
+			}
+		});
+
+		// tiles own disjoint pixels
+		_jobPool.ParallelFor(_tileMaxDepth.size(), MIN_TILES_PER_RANGE, [&](const size_t first, const size_t last)
+		{
+			for (size_t tile = first; tile < last; tile++)
+				RasterizeTile(static_cast<uint32_t>(tile));
+		});
+
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		_frames++;
+		_renderMs += elapsed.count();
+		for (size_t group = 0; group < groupCount; group++)
+		{
+			_trianglesRasterized += _groupTriangles[group];
+			for (const auto& bin : _bins[group])
+				_binEntries += bin.size();
+		}
+	}
+
+	AppSoftwareOcclusion::Result AppSoftwareOcclusion::TestBox(const OccludeeBox& box) const
+	{
+		float minX = std::numeric_limits<float>::max();
+		float minY = std::numeric_limits<float>::max();
+		float maxX = std::numeric_limits<float>::lowest();
+		float maxY = std::numeric_limits<float>::lowest();
+		float minDepth = std::numeric_limits<float>::max();
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			const std::array<float, 3> position = {
+				(corner & 1) != 0 ? box.max[0] : box.min[0],
+				(corner & 2) != 0 ? box.max[1] : box.min[1],
+				(corner & 4) != 0 ? box.max[2] : box.min[2]
+			};
+			const std::array<float, 4> clip = Transform(_viewProjection, position);
+			// reaches in front of the near plane, nothing can be said from its projection
+			if (clip[3] <= MIN_W || clip[2] < 0.0f)
+				return Result::Visible;
+
+			const float invW = 1.0f / clip[3];
+			const float x = (clip[0] * invW * 0.5f + 0.5f) * static_cast<float>(_width);
+			const float y = (clip[1] * invW * 0.5f + 0.5f) * static_cast<float>(_height);
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+			minDepth = std::min(minDepth, clip[2] * invW);
+		}
+
+		if (maxX < 0.0f || maxY < 0.0f || minX > static_cast<float>(_width) || minY > static_cast<float>(_height) ||
+			minDepth > 1.0f)
+			return Result::FrustumCulled;
+
+		// every pixel the rectangle touches
+		const auto firstX = static_cast<uint32_t>(std::max(std::floor(minX), 0.0f));
+		const auto firstY = static_cast<uint32_t>(std::max(std::floor(minY), 0.0f));
+		const auto lastX = static_cast<uint32_t>(std::min(std::floor(maxX), static_cast<float>(_width - 1)));
+		const auto lastY = static_cast<uint32_t>(std::min(std::floor(maxY), static_cast<float>(_height - 1)));
+
+		for (uint32_t tileY = firstY / TILE_HEIGHT; tileY <= lastY / TILE_HEIGHT; tileY++)
+		{
+			for (uint32_t tileX = firstX / TILE_WIDTH; tileX <= lastX / TILE_WIDTH; tileX++)
+			{
+				// the whole tile is nearer than the box
+				if (_tileMaxDepth[tileY * _tilesX + tileX] < minDepth)
+					continue;
+
+				const uint32_t x0 = std::max(firstX, tileX * TILE_WIDTH);
+				const uint32_t x1 = std::min(lastX, tileX * TILE_WIDTH + TILE_WIDTH - 1);
+				const uint32_t y0 = std::max(firstY, tileY * TILE_HEIGHT);
+				const uint32_t y1 = std::min(lastY, tileY * TILE_HEIGHT + TILE_HEIGHT - 1);
+				for (uint32_t y = y0; y <= y1; y++)
+				{
+					const float* row = &_depth[static_cast<size_t>(y) * _width];
+					for (uint32_t x = x0; x <= x1; x++)
+					{
+						if (row[x] >= minDepth)
+							return Result::Visible;
+					}
+				}
+			}
+		}
+		return Result::Occluded;
+	}
+
+	void AppSoftwareOcclusion::CullBoxes(const std::vector<OccludeeBox>& boxes, std::vector<uint32_t>& visible)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		_results.resize(boxes.size());
+		_jobPool.ParallelFor(boxes.size(), MIN_BOXES_PER_RANGE, [&](const size_t first, const size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				_results[i] = TestBox(boxes[i]);
+		});
+
+		visible.clear();
+		for (size_t i = 0; i < _results.size(); i++)
+		{
+			switch (_results[i])
+			{
+			case Result::Visible:
+				visible.push_back(static_cast<uint32_t>(i));
+				break;
+			case Result::Occluded:
+				_occluded++;
+				break;
+			case Result::FrustumCulled:
+				_frustumCulled++;
+				break;
+			}
+		}
+
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		_tested += boxes.size();
+		_visible += visible.size();
+		_testMs += elapsed.count();
+	}
+
+	void AppSoftwareOcclusion::PrintStats(std::ostream& out) const
+	{
+		const double frames = static_cast<double>(std::max<uint64_t>(_frames, 1));
+		out << "software_occlusion width=" << _width << " height=" << _height
+			<< " occluder_triangles=" << _occluderTriangles.size() << " frames=" << _frames
+			<< " rasterized_per_frame=" << _trianglesRasterized / frames << " bin_entries_per_frame=" << _binEntries / frames
+			<< " render_ms=" << _renderMs / frames << " tested=" << _tested << " visible=" << _visible
+			<< " occluded=" << _occluded << " frustum_culled=" << _frustumCulled
+			<< " ns_per_box=" << (_tested > 0 ? _testMs * 1e6 / static_cast<double>(_tested) : 0.0) << std::endl;
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "app_job_pool.hpp"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace VulkanTest
+{
+	// an object's bounds for the occlusion test, world space
+	struct OccludeeBox
+	{
+		std::array<float, 3> min{};
+		std::array<float, 3> max{};
+	};
+
+	// Occlusion culling on the cpu, for devices that cannot spare a hi-z pass: integrated gpus, lavapipe.
+	// A few designated occluder meshes are rasterized into a small depth buffer, then every occludee's
+	// screen rectangle is tested against it at its nearest depth. Triangles are set up and binned to tiles
+	// in parallel, the tiles are rasterized in parallel four pixels at a time, and the boxes are tested in
+	// parallel. Coverage is sampled at pixel centers, so an occludee may be reported hidden behind the
+	// sliver of a pixel an occluder edge leaves open.
+	class AppSoftwareOcclusion
+	{
+	public:
+		// pixels per tile, a tile row is eight SSE registers
+		static constexpr uint32_t TILE_WIDTH = 32;
+		static constexpr uint32_t TILE_HEIGHT = 8;
+
+		enum class Result : uint8_t
+		{
+			Visible,
+			Occluded,
+			// entirely outside the view
+			FrustumCulled
+		};
+
+		// rounded up to whole tiles
+		AppSoftwareOcclusion(AppJobPool& jobPool, uint32_t width, uint32_t height);
+
+		AppSoftwareOcclusion(const AppSoftwareOcclusion&) = delete;
+		AppSoftwareOcclusion& operator=(const AppSoftwareOcclusion&) = delete;
+
+		// triangles as index triples, world space. occluders are double sided
+		void AddOccluder(const std::vector<std::array<float, 3>>& positions, const std::vector<uint32_t>& indices);
+		void ClearOccluders();
+		[[nodiscard]] size_t OccluderTriangleCount() const { return _occluderTriangles.size(); }
+
+		// column major with vulkan's [0, 1] depth range, identity when everything is already in clip space
+		void SetViewProjection(const std::array<float, 16>& viewProjection) { _viewProjection = viewProjection; }
+
+		// clears the depth buffer and rasterizes every occluder, call after the view projection changed
+		void RenderOccluders();
+		// against the last RenderOccluders, safe to call from several threads
+		[[nodiscard]] Result TestBox(const OccludeeBox& box) const;
+		// replaces visible with the indices of the boxes that may be seen, ascending
+		void CullBoxes(const std::vector<OccludeeBox>& boxes, std::vector<uint32_t>& visible);
+
+		[[nodiscard]] uint32_t Width() const { return _width; }
+		[[nodiscard]] uint32_t Height() const { return _height; }
+		// nearest occluder depth at the pixel, 1 where nothing was drawn
+		[[nodiscard]] float Depth(uint32_t x, uint32_t y) const { return _depth[y * _width + x]; }
+
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		// a triangle in pixel space, each function evaluated at a pixel center as a * x + b * y + c
+		struct ScreenTriangle
+		{
+			// non-negative inside, the edges are oriented so the triangle's area is positive
+			std::array<std::array<float, 3>, 3> edges;
+			std::array<float, 3> depth;
+			// inclusive pixel bounds, clamped to the buffer
+			uint32_t minX, minY, maxX, maxY;
+		};
+
+		// false if the triangle is degenerate, off screen or crosses the near plane, which skips it
+		bool SetupTriangle(size_t triangle, ScreenTriangle& screen) const;
+		void RasterizeTile(uint32_t tile);
+		void RasterizeRows(const ScreenTriangle& triangle, uint32_t minX, uint32_t maxX, uint32_t minY,
+		                   uint32_t maxY);
+
+		AppJobPool& _jobPool;
+		uint32_t _width;
+		uint32_t _height;
+		uint32_t _tilesX;
+		uint32_t _tilesY;
+		std::array<float, 16> _viewProjection{
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		};
+
+		// the three corners of every occluder triangle, flattened when the occluder is added
+		std::vector<std::array<std::array<float, 3>, 3>> _occluderTriangles;
+		std::vector<ScreenTriangle> _screenTriangles;
+		// [group][tile] triangle indices, every binning group fills its own lists so nothing is locked
+		std::vector<std::vector<std::vector<uint32_t>>> _bins;
+		std::vector<uint32_t> _groupTriangles;
+
+		// row major
+		std::vector<float> _depth;
+		// farthest depth per tile, a box nearer than it cannot be hidden there
+		std::vector<float> _tileMaxDepth;
+		std::vector<Result> _results;
+
+		uint64_t _frames = 0;
+		uint64_t _trianglesRasterized = 0;
+		uint64_t _binEntries = 0;
+		uint64_t _tested = 0;
+		uint64_t _visible = 0;
+		uint64_t _occluded = 0;
+		uint64_t _frustumCulled = 0;
+		double _renderMs = 0.0;
+		double _testMs = 0.0;
+	};
+}
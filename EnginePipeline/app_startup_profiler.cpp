@@ -0,0 +1,66 @@
+#include "app_startup_profiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace VulkanTest
+{
+	AppStartupProfiler& AppStartupProfiler::Instance()
+	{
+		// constructed on first use, main touches it before anything else so the origin is process start
+		static AppStartupProfiler profiler;
+		return profiler;
+	}
+
+	double AppStartupProfiler::SinceOrigin(const Clock::time_point time) const
+	{
+		return std::chrono::duration<double, std::milli>(time - _origin).count();
+	}
+
+	void AppStartupProfiler::Record(const std::string& name, const Clock::time_point start,
+	                                const Clock::time_point end)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_phases.push_back({name, SinceOrigin(start), std::chrono::duration<double, std::milli>(end - start).count(),
+		                   std::this_thread::get_id()});
+	}
+
+	void AppStartupProfiler::FirstFrame(std::ostream& out)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_firstFrameMs >= 0.0)
+				return;
+			_firstFrameMs = SinceOrigin(Clock::now());
+		}
+
+		Report(out);
+	}
+
+	std::vector<AppStartupProfiler::Phase> AppStartupProfiler::Phases() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _phases;
+	}
+
+	void AppStartupProfiler::Report(std::ostream& out) const
+	{
+		auto phases = Phases();
+		std::stable_sort(phases.begin(), phases.end(),
+		                 [](const Phase& a, const Phase& b) { return a.startMs < b.startMs; });
+
+		const auto flags = out.flags();
+		out << std::fixed << std::setprecision(2);
+
+		// same key=value shape as the device selection log
+		for (const auto& [name, startMs, durationMs, thread] : phases)
+		{
+			out << "startup_phase name=" << name << " start_ms=" << startMs << " duration_ms=" << durationMs
+				<< " thread=" << (thread == _mainThread ? "main" : "worker") << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		out << "startup_total time_to_first_frame_ms=" << _firstFrameMs << std::endl;
+		out.flags(flags);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VulkanTest
+{
+	// Collects how long each bring-up phase took, from process start to the first submitted frame.
+	// Phases may be recorded from worker threads, overlapping phases simply show up side by side.
+	class AppStartupProfiler
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		struct Phase
+		{
+			std::string name;
+			double startMs = 0.0;
+			double durationMs = 0.0;
+			std::thread::id thread;
+		};
+
+		// times the enclosing block
+		class Scope
+		{
+		public:
+			explicit Scope(std::string name)
+				: _name{std::move(name)}, _start{Clock::now()}
+			{
+			}
+
+			~Scope() { Instance().Record(_name, _start, Clock::now()); }
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			std::string _name;
+			Clock::time_point _start;
+		};
+
+		static AppStartupProfiler& Instance();
+
+		void Record(const std::string& name, Clock::time_point start, Clock::time_point end);
+		// marks the first frame as submitted and prints the report, later calls do nothing
+		void FirstFrame(std::ostream& out);
+
+		[[nodiscard]] std::vector<Phase> Phases() const;
+		void Report(std::ostream& out) const;
+
+	private:
+		AppStartupProfiler() = default;
+
+		[[nodiscard]] double SinceOrigin(Clock::time_point time) const;
+
+		const Clock::time_point _origin = Clock::now();
+		std::thread::id _mainThread = std::this_thread::get_id();
+		std::vector<Phase> _phases;
+		double _firstFrameMs = -1.0;
+
+		mutable std::mutex _mutex;
+	};
+}
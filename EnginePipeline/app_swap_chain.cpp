@@ -13,7 +13,8 @@ namespace VulkanTest
 	{
 		CreateSwapChain();
 		CreateImageViews();
-		CreateRenderPass();
+		_renderPass = CreateRenderPass(false);
+		_loadRenderPass = CreateRenderPass(true);
 		CreateDepthResources();
 		CreateFramebuffers();
 		CreateSyncObjects();
@@ -21,42 +22,113 @@ namespace VulkanTest
 
 	AppSwapChain::~AppSwapChain()
 	{
-		for (const auto imageView : _swapChainImageViews)
+		DestroyRetired(true);
+
+		RetiredResources current;
+		current.swapChain = _swapChain;
+		current.imageViews = std::move(_swapChainImageViews);
+		current.framebuffers = std::move(_swapChainFramebuffers);
+		current.depthImages = std::move(_depthImages);
+		current.depthImageMemorys = std::move(_depthImageMemorys);
+		current.depthImageViews = std::move(_depthImageViews);
+		current.renderPass = _renderPass;
+		current.loadRenderPass = _loadRenderPass;
+		DestroyResources(current);
+		_swapChain = VK_NULL_HANDLE;
+
+		// cleanup synchronization objects
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 		{
-			vkDestroyImageView(_device.Device(), imageView, nullptr);
+			vkDestroySemaphore(_device.Device(), _renderFinishedSemaphores[i], nullptr);
+			vkDestroySemaphore(_device.Device(), _imageAvailableSemaphores[i], nullptr);
+			vkDestroyFence(_device.Device(), _inFlightFences[i], nullptr);
 		}
+	}
+
+	bool AppSwapChain::Recreate(const VkExtent2D windowExtent)
+	{
+		_windowExtent = windowExtent;
+
+		// frames in flight keep rendering into the old generation, it is only destroyed once they retired
+		RetiredResources retired;
+		retired.swapChain = _swapChain;
+		retired.imageViews = std::move(_swapChainImageViews);
+		retired.framebuffers = std::move(_swapChainFramebuffers);
+		retired.depthImages = std::move(_depthImages);
+		retired.depthImageMemorys = std::move(_depthImageMemorys);
+		retired.depthImageViews = std::move(_depthImageViews);
+		retired.retiredAtFrame = _frameNumber;
+
 		_swapChainImageViews.clear();
+		_swapChainFramebuffers.clear();
+		_depthImages.clear();
+		_depthImageMemorys.clear();
+		_depthImageViews.clear();
 
-		if (_swapChain != nullptr)
-		{
-			vkDestroySwapchainKHR(_device.Device(), _swapChain, nullptr);
-			_swapChain = nullptr;
-		}
+		const VkFormat oldFormat = _swapChainImageFormat;
+		CreateSwapChain(retired.swapChain);
+		CreateImageViews();
 
-		for (size_t i = 0; i < _depthImages.size(); i++)
+		// the render pass only depends on the formats, so a plain resize keeps it and every pipeline built on it
+		const bool renderPassReplaced = _swapChainImageFormat != oldFormat;
+		if (renderPassReplaced)
 		{
-			vkDestroyImageView(_device.Device(), _depthImageViews[i], nullptr);
-			vkDestroyImage(_device.Device(), _depthImages[i], nullptr);
-			vkFreeMemory(_device.Device(), _depthImageMemorys[i], nullptr);
+			retired.renderPass = _renderPass;
+			retired.loadRenderPass = _loadRenderPass;
+			_renderPass = CreateRenderPass(false);
+			_loadRenderPass = CreateRenderPass(true);
 		}
 
-		for (const auto framebuffer : _swapChainFramebuffers)
-		{
+		CreateDepthResources();
+		CreateFramebuffers();
+
+		// per frame fences still guard the frames in flight, image fences start over with the new images
+		_imagesInFlight.assign(ImageCount(), VK_NULL_HANDLE);
+		_retired.push_back(std::move(retired));
+
+		std::cout << "swapchain_recreated width=" << _swapChainExtent.width << " height=" << _swapChainExtent.height
+			<< " images=" << ImageCount() << " render_pass_replaced=" << (renderPassReplaced ? 1 : 0) << std::endl;
+
+		return renderPassReplaced;
+	}
+
+	void AppSwapChain::DestroyResources(RetiredResources& resources) const
+	{
+		for (const auto framebuffer : resources.framebuffers)
 			vkDestroyFramebuffer(_device.Device(), framebuffer, nullptr);
+
+		for (const auto imageView : resources.imageViews)
+			vkDestroyImageView(_device.Device(), imageView, nullptr);
+
+		for (size_t i = 0; i < resources.depthImages.size(); i++)
+		{
+			vkDestroyImageView(_device.Device(), resources.depthImageViews[i], nullptr);
+			_device.DestroyImage(resources.depthImages[i], resources.depthImageMemorys[i]);
 		}
 
-		vkDestroyRenderPass(_device.Device(), _renderPass, nullptr);
+		if (resources.swapChain != VK_NULL_HANDLE)
+			vkDestroySwapchainKHR(_device.Device(), resources.swapChain, nullptr);
 
-		// cleanup synchronization objects
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		if (resources.renderPass != VK_NULL_HANDLE)
+			vkDestroyRenderPass(_device.Device(), resources.renderPass, nullptr);
+
+		if (resources.loadRenderPass != VK_NULL_HANDLE)
+			vkDestroyRenderPass(_device.Device(), resources.loadRenderPass, nullptr);
+	}
+
+	void AppSwapChain::DestroyRetired(const bool all)
+	{
+		// called right after waiting on the current slot's fence, which was the fence of frame
+		// _frameNumber - MAX_FRAMES_IN_FLIGHT, so every frame up to that one has finished
+		while (!_retired.empty() &&
+			(all || _frameNumber + 1 >= _retired.front().retiredAtFrame + MAX_FRAMES_IN_FLIGHT))
 		{
-			vkDestroySemaphore(_device.Device(), _renderFinishedSemaphores[i], nullptr);
-			vkDestroySemaphore(_device.Device(), _imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(_device.Device(), _inFlightFences[i], nullptr);
+			DestroyResources(_retired.front());
+			_retired.pop_front();
 		}
 	}
 
-	VkResult AppSwapChain::AcquireNextImage(uint32_t* imageIndex) const
+	VkResult AppSwapChain::AcquireNextImage(uint32_t* imageIndex)
 	{
 		vkWaitForFences(
 			_device.Device(),
@@ -65,6 +137,8 @@ namespace VulkanTest
 			VK_TRUE,
 			std::numeric_limits<uint64_t>::max());
 
+		DestroyRetired(false);
+
 		const VkResult result = vkAcquireNextImageKHR(
 			_device.Device(),
 			_swapChain,
@@ -120,11 +194,12 @@ namespace VulkanTest
 		const auto result = vkQueuePresentKHR(_device.PresentQueue(), &presentInfo);
 
 		_currentFrame = (_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		_frameNumber++;
 
 		return result;
 	}
 
-	void AppSwapChain::CreateSwapChain()
+	void AppSwapChain::CreateSwapChain(const VkSwapchainKHR oldSwapChain)
 	{
 		const SwapChainSupportDetails swapChainSupport = _device.getSwapChainSupport();
 
@@ -172,7 +247,8 @@ namespace VulkanTest
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE;
 
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+		// lets the driver reuse the old chain's resources, the old chain is retired but stays valid for frames in flight
+		createInfo.oldSwapchain = oldSwapChain;
 
 		if (vkCreateSwapchainKHR(_device.Device(), &createInfo, nullptr, &_swapChain) != VK_SUCCESS)
 			throw std::runtime_error("failed to create swap chain!");
@@ -211,16 +287,18 @@ namespace VulkanTest
 		}
 	}
 
-	void AppSwapChain::CreateRenderPass()
+	VkRenderPass AppSwapChain::CreateRenderPass(const bool loadContents) const
 	{
+		// depth is stored so compute passes can sample it, e.g. to build an occlusion pyramid
 		VkAttachmentDescription depthAttachment{};
 		depthAttachment.format = FindDepthFormat();
 		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.loadOp = loadContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.initialLayout =
+			loadContents ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
 		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		VkAttachmentReference depthAttachmentRef{};
@@ -230,11 +308,11 @@ namespace VulkanTest
 		VkAttachmentDescription colorAttachment = {};
 		colorAttachment.format = GetSwapChainImageFormat();
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.loadOp = loadContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
 		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		colorAttachment.initialLayout = loadContents ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
 		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 		VkAttachmentReference colorAttachmentRef = {};
@@ -258,6 +336,17 @@ namespace VulkanTest
 		dependency.dstAccessMask =
 			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+		// the loading pass reads what the earlier pass of the frame wrote
+		if (loadContents)
+		{
+			dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependency.srcAccessMask =
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			dependency.dstStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			dependency.dstAccessMask |=
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		}
+
 		const std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
 		VkRenderPassCreateInfo renderPassInfo = {};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -268,10 +357,12 @@ namespace VulkanTest
 		renderPassInfo.dependencyCount = 1;
 		renderPassInfo.pDependencies = &dependency;
 
-		if (vkCreateRenderPass(_device.Device(), &renderPassInfo, nullptr, &_renderPass) != VK_SUCCESS)
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		if (vkCreateRenderPass(_device.Device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to create render pass!");
 		}
+		return renderPass;
 	}
 
 	void AppSwapChain::CreateFramebuffers()
@@ -320,7 +411,7 @@ namespace VulkanTest
 			imageInfo.format = depthFormat;
 			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 			imageInfo.flags = 0;
@@ -437,6 +528,6 @@ namespace VulkanTest
 		return _device.FindSupportedFormat(
 			{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
 			VK_IMAGE_TILING_OPTIMAL,
-			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 	}
 }
@@ -1,47 +1,72 @@
 #pragma once
 
 #include "app_device.hpp"
+#include "app_render_target.hpp"
 
 #include <vulkan/vulkan.h>
+#include <cstdint>
+#include <deque>
 #include <vector>
 
 namespace VulkanTest
 {
-	class AppSwapChain
+	class AppSwapChain : public AppRenderTarget
 	{
 	public:
-		static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
 		AppSwapChain(AppDevice& deviceRef, VkExtent2D windowExtent);
-		~AppSwapChain();
+		~AppSwapChain() override;
 
 		AppSwapChain(const AppSwapChain&) = delete;
 		void operator=(const AppSwapChain&) = delete;
 
-		[[nodiscard]] VkFramebuffer GetFrameBuffer(const size_t index) const { return _swapChainFramebuffers[index]; }
-		[[nodiscard]] VkRenderPass GetRenderPass() const { return _renderPass; }
+		[[nodiscard]] VkFramebuffer GetFrameBuffer(const size_t index) const override
+		{
+			return _swapChainFramebuffers[index];
+		}
+
+		[[nodiscard]] VkRenderPass GetRenderPass() const override { return _renderPass; }
+		[[nodiscard]] VkRenderPass GetLoadRenderPass() const override { return _loadRenderPass; }
 		[[nodiscard]] VkImageView GetImageView(const int index) const { return _swapChainImageViews[index]; }
-		[[nodiscard]] size_t ImageCount() const { return _swapChainImages.size(); }
+		[[nodiscard]] size_t ImageCount() const override { return _swapChainImages.size(); }
+		[[nodiscard]] VkFormat GetImageFormat() const override { return _swapChainImageFormat; }
 		[[nodiscard]] VkFormat GetSwapChainImageFormat() const { return _swapChainImageFormat; }
+		[[nodiscard]] VkExtent2D GetExtent() const override { return _swapChainExtent; }
 		[[nodiscard]] VkExtent2D GetSwapChainExtent() const { return _swapChainExtent; }
-		[[nodiscard]] uint32_t Width() const { return _swapChainExtent.width; }
-		[[nodiscard]] uint32_t Height() const { return _swapChainExtent.height; }
-
-		[[nodiscard]] float ExtentAspectRatio() const
-		{
-			return static_cast<float>(_swapChainExtent.width) / static_cast<float>(_swapChainExtent.height);
-		}
+		[[nodiscard]] size_t CurrentFrame() const override { return _currentFrame; }
+		[[nodiscard]] VkImage GetDepthImage(const size_t index) const override { return _depthImages[index]; }
+		[[nodiscard]] VkImageView GetDepthImageView(const size_t index) const override { return _depthImageViews[index]; }
+		[[nodiscard]] VkFormat GetDepthFormat() const override { return FindDepthFormat(); }
 
 		[[nodiscard]] VkFormat FindDepthFormat() const;
 
-		VkResult AcquireNextImage(uint32_t* imageIndex) const;
-		VkResult SubmitCommandBuffers(const VkCommandBuffer* buffers, const uint32_t* imageIndex);
+		VkResult AcquireNextImage(uint32_t* imageIndex) override;
+		VkResult SubmitCommandBuffers(const VkCommandBuffer* buffers, const uint32_t* imageIndex) override;
+
+		// new swap chain from the old one via oldSwapchain. the render pass is kept unless the surface format
+		// changed, the old images, views and framebuffers are destroyed once the frames using them retired
+		bool Recreate(VkExtent2D windowExtent) override;
 
 	private:
-		void CreateSwapChain();
+		// one swap chain generation, kept alive until the last frame recorded against it is done
+		struct RetiredResources
+		{
+			VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+			std::vector<VkImageView> imageViews;
+			std::vector<VkFramebuffer> framebuffers;
+			std::vector<VkImage> depthImages;
+			std::vector<MemoryAllocation> depthImageMemorys;
+			std::vector<VkImageView> depthImageViews;
+			// only set when Recreate had to replace the render passes
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+			uint64_t retiredAtFrame = 0;
+		};
+
+		void CreateSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
 		void CreateImageViews();
 		void CreateDepthResources();
-		void CreateRenderPass();
+		// clears both attachments, or loads them for a pass continuing the frame
+		[[nodiscard]] VkRenderPass CreateRenderPass(bool loadContents) const;
 		void CreateFramebuffers();
 		void CreateSyncObjects();
 
@@ -52,14 +77,19 @@ namespace VulkanTest
 			const std::vector<VkPresentModeKHR>& availablePresentModes);
 		[[nodiscard]] VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) const;
 
+		void DestroyResources(RetiredResources& resources) const;
+		// destroys the generations no frame in flight can still reference, or all of them
+		void DestroyRetired(bool all);
+
 		VkFormat _swapChainImageFormat;
 		VkExtent2D _swapChainExtent;
 
 		std::vector<VkFramebuffer> _swapChainFramebuffers;
 		VkRenderPass _renderPass;
+		VkRenderPass _loadRenderPass;
 
 		std::vector<VkImage> _depthImages;
-		std::vector<VkDeviceMemory> _depthImageMemorys;
+		std::vector<MemoryAllocation> _depthImageMemorys;
 		std::vector<VkImageView> _depthImageViews;
 		std::vector<VkImage> _swapChainImages;
 		std::vector<VkImageView> _swapChainImageViews;
@@ -67,12 +97,15 @@ namespace VulkanTest
 		AppDevice& _device;
 		VkExtent2D _windowExtent;
 
-		VkSwapchainKHR _swapChain;
+		VkSwapchainKHR _swapChain = VK_NULL_HANDLE;
+		std::deque<RetiredResources> _retired;
 
 		std::vector<VkSemaphore> _imageAvailableSemaphores;
 		std::vector<VkSemaphore> _renderFinishedSemaphores;
 		std::vector<VkFence> _inFlightFences;
 		std::vector<VkFence> _imagesInFlight;
 		size_t _currentFrame = 0;
+		// frames submitted so far, retired generations are freed by comparing against it
+		uint64_t _frameNumber = 0;
 	};
 }
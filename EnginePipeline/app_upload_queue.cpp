@@ -0,0 +1,607 @@
+#include "app_upload_queue.hpp"
+
+#include "app_device.hpp"
+#include "Init.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		// vkCmdCopyBufferToImage wants offsets aligned to the texel size and 4, 16 covers every format we use
+		constexpr VkDeviceSize IMAGE_COPY_ALIGNMENT = 16;
+		constexpr VkDeviceSize BUFFER_COPY_ALIGNMENT = 4;
+
+		VkDeviceSize AlignUp(const VkDeviceSize value, const VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	AppUploadQueue::AppUploadQueue(AppDevice& device, VkQueue queue, const uint32_t queueFamilyIndex,
+	                               VkQueue ownerQueue, const uint32_t ownerQueueFamilyIndex,
+	                               const VkDeviceSize ringSize)
+		: _device{device}, _queue{queue}, _queueFamilyIndex{queueFamilyIndex}, _ownerQueue{ownerQueue},
+		  _ownerQueueFamilyIndex{ownerQueueFamilyIndex}, _ringSize{ringSize}
+	{
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndex;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		if (vkCreateCommandPool(_device.Device(), &poolInfo, nullptr, &_commandPool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create upload command pool!");
+
+		if (TransfersOwnership())
+		{
+			poolInfo.queueFamilyIndex = _ownerQueueFamilyIndex;
+			if (vkCreateCommandPool(_device.Device(), &poolInfo, nullptr, &_ownerCommandPool) != VK_SUCCESS)
+				throw std::runtime_error("failed to create upload acquire command pool!");
+		}
+
+		_device.CreateBuffer(_ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Upload, _ringBuffer,
+		                     _ringMemory);
+
+		if (_ringMemory.mappedData == nullptr)
+			throw std::runtime_error("failed to map upload staging ring!");
+	}
+
+	AppUploadQueue::~AppUploadQueue()
+	{
+		WaitIdle();
+
+		for (const auto& batch : _freeBatches)
+			vkDestroyFence(_device.Device(), batch.fence, nullptr);
+		if (_hasOpenBatch)
+			vkDestroyFence(_device.Device(), _openBatch.fence, nullptr);
+
+		for (const auto& [commandBuffer, fence] : _acquireSubmissions)
+		{
+			vkWaitForFences(_device.Device(), 1, &fence, VK_TRUE, UINT64_MAX);
+			vkDestroyFence(_device.Device(), fence, nullptr);
+		}
+
+		vkDestroyCommandPool(_device.Device(), _commandPool, nullptr);
+		if (_ownerCommandPool != VK_NULL_HANDLE)
+			vkDestroyCommandPool(_device.Device(), _ownerCommandPool, nullptr);
+		_device.DestroyBuffer(_ringBuffer, _ringMemory);
+	}
+
+	UploadToken AppUploadQueue::UploadBuffer(const VkBuffer dstBuffer, const VkDeviceSize dstOffset,
+	                                         const void* data, const VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		ClaimBuffer(dstBuffer);
+		VkBuffer stagingBuffer;
+		const VkDeviceSize stagingOffset = StageData(data, size, BUFFER_COPY_ALIGNMENT, stagingBuffer);
+
+		Batch& batch = OpenBatch();
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = stagingOffset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(batch.commandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
+
+		batch.copyCount++;
+		return batch.token;
+	}
+
+	UploadToken AppUploadQueue::UploadImage(
+		const VkImage image, const uint32_t width, const uint32_t height, const uint32_t layerCount,
+		const void* data, const VkDeviceSize size, const VkImageLayout finalLayout)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		VkBuffer stagingBuffer;
+		const VkDeviceSize stagingOffset = StageData(data, size, IMAGE_COPY_ALIGNMENT, stagingBuffer);
+
+		Batch& batch = OpenBatch();
+
+		VkImageMemoryBarrier barrier = initializers::CreateImageMemoryBarrier();
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = layerCount;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = stagingOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = layerCount;
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = {width, height, 1};
+
+		vkCmdCopyBufferToImage(batch.commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+		                       &region);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = finalLayout;
+
+		if (TransfersOwnership())
+		{
+			// the layout change rides along with the release/acquire pair
+			ReleaseImage(batch, barrier);
+		}
+		else
+		{
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			                     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		batch.copyCount++;
+		return batch.token;
+	}
+
+	UploadToken AppUploadQueue::CopyBuffer(const VkBuffer srcBuffer, const VkBuffer dstBuffer,
+	                                       const VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		ClaimBuffer(dstBuffer);
+		Batch& batch = OpenBatch();
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = 0;
+		copyRegion.dstOffset = 0;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(batch.commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+		batch.copyCount++;
+		return batch.token;
+	}
+
+	UploadToken AppUploadQueue::CopyBufferToImage(
+		const VkBuffer buffer, const VkImage image, const uint32_t width, const uint32_t height,
+		const uint32_t layerCount)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		Batch& batch = OpenBatch();
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = layerCount;
+
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = {width, height, 1};
+
+		vkCmdCopyBufferToImage(batch.commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		if (TransfersOwnership())
+		{
+			// the caller put the image in TRANSFER_DST and expects to find it there
+			VkImageMemoryBarrier barrier = initializers::CreateImageMemoryBarrier();
+			barrier.image = image;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = layerCount;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			ReleaseImage(batch, barrier);
+		}
+
+		batch.copyCount++;
+		return batch.token;
+	}
+
+	UploadToken AppUploadQueue::Flush()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		SubmitOpenBatch(true);
+		Retire(false);
+		SubmitPendingAcquires();
+		return _nextToken - 1;
+	}
+
+	uint32_t AppUploadQueue::RecordAcquireBarriers(const VkCommandBuffer commandBuffer)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		Retire(false);
+
+		const auto count = static_cast<uint32_t>(_pendingBufferAcquires.size() + _pendingImageAcquires.size());
+		if (count == 0)
+			return 0;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+		                     0, nullptr,
+		                     static_cast<uint32_t>(_pendingBufferAcquires.size()), _pendingBufferAcquires.data(),
+		                     static_cast<uint32_t>(_pendingImageAcquires.size()), _pendingImageAcquires.data());
+
+		_pendingBufferAcquires.clear();
+		_pendingImageAcquires.clear();
+		return count;
+	}
+
+	void AppUploadQueue::ClaimBuffer(const VkBuffer buffer)
+	{
+		if (!TransfersOwnership())
+			return;
+
+		{
+			// the transfer queue no longer owns it, a copy would leave the whole buffer undefined
+			std::lock_guard<std::mutex> releasedLock(_releasedMutex);
+			if (_releasedBuffers.count(buffer) != 0)
+				throw std::runtime_error("failed to upload, the buffer was already released to the graphics queue!");
+		}
+
+		if (std::find(_unreleasedBuffers.begin(), _unreleasedBuffers.end(), buffer) == _unreleasedBuffers.end())
+			_unreleasedBuffers.push_back(buffer);
+	}
+
+	void AppUploadQueue::ReleaseBuffers(Batch& batch)
+	{
+		if (_unreleasedBuffers.empty())
+			return;
+
+		// one release per buffer after all of its copies, earlier batches on this queue are covered by the barrier
+		std::vector<VkBufferMemoryBarrier> releases;
+		releases.reserve(_unreleasedBuffers.size());
+		for (const VkBuffer buffer : _unreleasedBuffers)
+		{
+			VkBufferMemoryBarrier barrier = initializers::CreateBufferMemoryBarrier(
+				_queueFamilyIndex, _ownerQueueFamilyIndex);
+			barrier.buffer = buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			releases.push_back(barrier);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			batch.bufferAcquires.push_back(barrier);
+		}
+
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+		                     static_cast<uint32_t>(releases.size()), releases.data(), 0, nullptr);
+
+		std::lock_guard<std::mutex> releasedLock(_releasedMutex);
+		_releasedBuffers.insert(_unreleasedBuffers.begin(), _unreleasedBuffers.end());
+		_unreleasedBuffers.clear();
+	}
+
+	void AppUploadQueue::ForgetBuffer(const VkBuffer buffer)
+	{
+		std::lock_guard<std::mutex> releasedLock(_releasedMutex);
+		_releasedBuffers.erase(buffer);
+	}
+
+	void AppUploadQueue::ReleaseImage(Batch& batch, VkImageMemoryBarrier barrier)
+	{
+		barrier.srcQueueFamilyIndex = _queueFamilyIndex;
+		barrier.dstQueueFamilyIndex = _ownerQueueFamilyIndex;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+			                        ? VK_ACCESS_TRANSFER_WRITE_BIT
+			                        : VK_ACCESS_SHADER_READ_BIT;
+		batch.imageAcquires.push_back(barrier);
+	}
+
+	void AppUploadQueue::SubmitPendingAcquires()
+	{
+		// finished acquire submissions are only kept around for their fence
+		while (!_acquireSubmissions.empty() &&
+			vkGetFenceStatus(_device.Device(), _acquireSubmissions.front().fence) == VK_SUCCESS)
+		{
+			const auto [commandBuffer, fence] = _acquireSubmissions.front();
+			vkFreeCommandBuffers(_device.Device(), _ownerCommandPool, 1, &commandBuffer);
+			vkDestroyFence(_device.Device(), fence, nullptr);
+			_acquireSubmissions.pop_front();
+		}
+
+		if (_pendingBufferAcquires.empty() && _pendingImageAcquires.empty())
+			return;
+
+		AcquireSubmission submission;
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = _ownerCommandPool;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(_device.Device(), &allocInfo, &submission.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate upload acquire command buffer!");
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(_device.Device(), &fenceInfo, nullptr, &submission.fence) != VK_SUCCESS)
+			throw std::runtime_error("failed to create upload acquire fence!");
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(submission.commandBuffer, &beginInfo);
+
+		vkCmdPipelineBarrier(submission.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		                     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+		                     static_cast<uint32_t>(_pendingBufferAcquires.size()), _pendingBufferAcquires.data(),
+		                     static_cast<uint32_t>(_pendingImageAcquires.size()), _pendingImageAcquires.data());
+
+		if (vkEndCommandBuffer(submission.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to record upload acquire command buffer!");
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &submission.commandBuffer;
+
+		// the release already completed on the cpu's watch (its fence signaled), so no semaphore is needed
+		if (vkQueueSubmit(_ownerQueue, 1, &submitInfo, submission.fence) != VK_SUCCESS)
+			throw std::runtime_error("failed to submit upload acquire barriers!");
+
+		_acquireSubmissions.push_back(submission);
+		_pendingBufferAcquires.clear();
+		_pendingImageAcquires.clear();
+	}
+
+	bool AppUploadQueue::IsComplete(const UploadToken token)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		Retire(false);
+		return token <= _completedToken;
+	}
+
+	void AppUploadQueue::Wait(const UploadToken token)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		// the data only becomes usable with its release, which may sit in a later batch than its copy
+		UploadToken waitToken = token;
+		if ((_hasOpenBatch && token >= _openBatch.token) || !_unreleasedBuffers.empty())
+		{
+			SubmitOpenBatch(true);
+			waitToken = std::max(token, _nextToken - 1);
+		}
+
+		while (_completedToken < waitToken && !_inFlight.empty())
+			Retire(true);
+	}
+
+	void AppUploadQueue::WaitIdle()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		SubmitOpenBatch(true);
+		while (!_inFlight.empty())
+			Retire(true);
+	}
+
+	AppUploadQueue::Batch& AppUploadQueue::OpenBatch()
+	{
+		if (_hasOpenBatch)
+			return _openBatch;
+
+		if (!_freeBatches.empty())
+		{
+			_openBatch = std::move(_freeBatches.back());
+			_freeBatches.pop_back();
+		}
+		else
+		{
+			_openBatch = Batch{};
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = _commandPool;
+			allocInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(_device.Device(), &allocInfo, &_openBatch.commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("failed to allocate upload command buffer!");
+
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			if (vkCreateFence(_device.Device(), &fenceInfo, nullptr, &_openBatch.fence) != VK_SUCCESS)
+				throw std::runtime_error("failed to create upload fence!");
+		}
+
+		_openBatch.token = _nextToken++;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(_openBatch.commandBuffer, &beginInfo) != VK_SUCCESS)
+			throw std::runtime_error("failed to begin upload command buffer!");
+
+		_hasOpenBatch = true;
+		return _openBatch;
+	}
+
+	VkDeviceSize AppUploadQueue::StageData(const void* data, const VkDeviceSize size, const VkDeviceSize alignment,
+	                                       VkBuffer& stagingBuffer)
+	{
+		// anything that would hog more than half the ring goes through a one-off buffer instead
+		if (size > _ringSize / 2)
+		{
+			MemoryAllocation stagingMemory;
+			_device.CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Upload, stagingBuffer,
+			                     stagingMemory);
+			std::memcpy(stagingMemory.mappedData, data, size);
+
+			OpenBatch().oversizedStaging.emplace_back(stagingBuffer, stagingMemory);
+			return 0;
+		}
+
+		VkDeviceSize offset;
+		while (!TryAllocateRing(size, alignment, offset))
+		{
+			// ring is full of work the gpu has not consumed yet, push ours out and wait for the oldest batch
+			if (_hasOpenBatch && _openBatch.copyCount > 0)
+				SubmitOpenBatch(false);
+
+			if (_inFlight.empty())
+				throw std::runtime_error("failed to allocate upload staging memory!");
+
+			Retire(true);
+		}
+
+		std::memcpy(static_cast<char*>(_ringMemory.mappedData) + offset, data, size);
+		stagingBuffer = _ringBuffer;
+		return offset;
+	}
+
+	bool AppUploadQueue::TryAllocateRing(const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize& offset)
+	{
+		if (_ringUsed == 0)
+			_ringHead = _ringTail = 0;
+
+		const VkDeviceSize alignedHead = AlignUp(_ringHead, alignment);
+
+		// head == tail on a non-empty ring means it is completely full
+		if (_ringHead > _ringTail || _ringUsed == 0)
+		{
+			if (alignedHead + size <= _ringSize)
+			{
+				offset = alignedHead;
+				_ringUsed += alignedHead + size - _ringHead;
+				_ringHead = alignedHead + size;
+			}
+			// wrap around, the skipped tail end of the ring counts as used until this batch retires
+			else if (size <= _ringTail)
+			{
+				offset = 0;
+				_ringUsed += _ringSize - _ringHead + size;
+				_ringHead = size;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if (alignedHead + size <= _ringTail)
+		{
+			offset = alignedHead;
+			_ringUsed += alignedHead + size - _ringHead;
+			_ringHead = alignedHead + size;
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	void AppUploadQueue::SubmitOpenBatch(const bool releaseBuffers)
+	{
+		const bool release = releaseBuffers && !_unreleasedBuffers.empty();
+		if (!_hasOpenBatch && !release)
+			return;
+
+		if (_inFlight.size() >= MAX_BATCHES_IN_FLIGHT)
+			Retire(true);
+
+		// the releases of buffers written by batches already in flight still need a batch to carry them
+		if (release)
+			ReleaseBuffers(OpenBatch());
+
+		// later submissions on the queue see the copied data without waiting on our fence
+		VkMemoryBarrier barrier = initializers::CreateMemoryBarrier();
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(_openBatch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		if (vkEndCommandBuffer(_openBatch.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to record upload command buffer!");
+
+		// every ring byte not yet claimed by an earlier batch belongs to this one
+		VkDeviceSize claimedBytes = 0;
+		for (const auto& submitted : _inFlight)
+			claimedBytes += submitted.ringBytes;
+		_openBatch.ringEnd = _ringHead;
+		_openBatch.ringBytes = _ringUsed - claimedBytes;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &_openBatch.commandBuffer;
+
+		if (vkQueueSubmit(_queue, 1, &submitInfo, _openBatch.fence) != VK_SUCCESS)
+			throw std::runtime_error("failed to submit upload batch!");
+
+		_inFlight.push_back(std::move(_openBatch));
+		_hasOpenBatch = false;
+	}
+
+	void AppUploadQueue::Retire(bool wait)
+	{
+		while (!_inFlight.empty())
+		{
+			Batch& batch = _inFlight.front();
+
+			if (wait)
+			{
+				vkWaitForFences(_device.Device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+				wait = false;
+			}
+			else if (vkGetFenceStatus(_device.Device(), batch.fence) != VK_SUCCESS)
+			{
+				break;
+			}
+
+			_ringTail = batch.ringEnd;
+			_ringUsed -= batch.ringBytes;
+			_completedToken = batch.token;
+
+			_pendingBufferAcquires.insert(_pendingBufferAcquires.end(), batch.bufferAcquires.begin(),
+			                              batch.bufferAcquires.end());
+			_pendingImageAcquires.insert(_pendingImageAcquires.end(), batch.imageAcquires.begin(),
+			                             batch.imageAcquires.end());
+
+			RecycleBatch(batch);
+			_inFlight.pop_front();
+		}
+	}
+
+	void AppUploadQueue::RecycleBatch(Batch& batch)
+	{
+		for (auto& [buffer, memory] : batch.oversizedStaging)
+			_device.DestroyBuffer(buffer, memory);
+		batch.oversizedStaging.clear();
+		batch.bufferAcquires.clear();
+		batch.imageAcquires.clear();
+
+		vkResetFences(_device.Device(), 1, &batch.fence);
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+
+		batch.copyCount = 0;
+		batch.ringBytes = 0;
+		_freeBatches.push_back(std::move(batch));
+	}
+}
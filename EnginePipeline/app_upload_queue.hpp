@@ -0,0 +1,149 @@
+#pragma once
+
+#include "app_memory_allocator.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace VulkanTest
+{
+	class AppDevice;
+
+	// Increases with every batch, a token is complete once the batch it was handed out for has retired
+	using UploadToken = uint64_t;
+
+	// Streams data to the gpu through a persistently mapped staging ring.
+	// Copies are recorded into an open batch and submitted together, nothing blocks unless the ring is full
+	// or the caller explicitly waits on a token.
+	// When the queue belongs to another family than the owner (graphics), a destination buffer is released to the
+	// owner once, after all of its copies, by the next Flush or Wait, and the matching acquire is submitted on the
+	// owner queue by Flush once that batch retired. From then on the buffer belongs to the owner, later writes to it
+	// are refused. Images are released after each copy.
+	class AppUploadQueue
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_RING_SIZE = 32ull * 1024 * 1024;
+		static constexpr uint32_t MAX_BATCHES_IN_FLIGHT = 4;
+
+		AppUploadQueue(AppDevice& device, VkQueue queue, uint32_t queueFamilyIndex,
+		               VkQueue ownerQueue, uint32_t ownerQueueFamilyIndex,
+		               VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+		~AppUploadQueue();
+
+		AppUploadQueue(const AppUploadQueue&) = delete;
+		AppUploadQueue& operator=(const AppUploadQueue&) = delete;
+
+		// data is copied into staging immediately, the caller's memory can be reused on return.
+		// throws if the buffer was already released to the owner
+		UploadToken UploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+		// transitions the whole image to TRANSFER_DST, copies mip 0 and leaves it in finalLayout
+		UploadToken UploadImage(
+			VkImage image, uint32_t width, uint32_t height, uint32_t layerCount,
+			const void* data, VkDeviceSize size,
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		// plain gpu side copies, batched with everything else
+		UploadToken CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		UploadToken CopyBufferToImage(
+			VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
+
+		// submits the open batch and any pending ownership acquires, returns the token of everything recorded so far.
+		// Call it from the thread that submits to the owner queue.
+		UploadToken Flush();
+		// records pending ownership acquires into an owner queue command buffer instead of leaving them to Flush
+		uint32_t RecordAcquireBarriers(VkCommandBuffer commandBuffer);
+		[[nodiscard]] bool IsComplete(UploadToken token);
+		// flushes if needed and blocks until the token has retired, with ownership transfer the data is usable
+		// on the owner queue after the next Flush
+		void Wait(UploadToken token);
+		void WaitIdle();
+		// the buffer is being destroyed, its handle may come back for a new buffer the queue has to accept
+		void ForgetBuffer(VkBuffer buffer);
+
+		[[nodiscard]] UploadToken CompletedToken() const { return _completedToken; }
+		[[nodiscard]] VkDeviceSize RingSize() const { return _ringSize; }
+		[[nodiscard]] bool TransfersOwnership() const { return _queueFamilyIndex != _ownerQueueFamilyIndex; }
+
+	private:
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			UploadToken token = 0;
+			// ring head once this batch was closed, the tail moves here when it retires
+			VkDeviceSize ringEnd = 0;
+			VkDeviceSize ringBytes = 0;
+			uint32_t copyCount = 0;
+			// requests too big for the ring get a staging buffer of their own
+			std::vector<std::pair<VkBuffer, MemoryAllocation>> oversizedStaging;
+			// acquire halves of the releases recorded at the end of this batch
+			std::vector<VkBufferMemoryBarrier> bufferAcquires;
+			std::vector<VkImageMemoryBarrier> imageAcquires;
+		};
+
+		Batch& OpenBatch();
+		// returns the offset in the ring, or writes a dedicated buffer into stagingBuffer
+		VkDeviceSize StageData(const void* data, VkDeviceSize size, VkDeviceSize alignment, VkBuffer& stagingBuffer);
+		bool TryAllocateRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		// releaseBuffers records the releases of every buffer written so far, submits made only to free up the
+		// ring leave them to a later batch, the buffer may still be in the middle of a chunked upload
+		void SubmitOpenBatch(bool releaseBuffers);
+		// retires finished batches in submission order, wait blocks on the oldest one
+		void Retire(bool wait);
+		void RecycleBatch(Batch& batch);
+		// throws if the buffer belongs to the owner already, otherwise remembers it for the next release
+		void ClaimBuffer(VkBuffer buffer);
+		void ReleaseBuffers(Batch& batch);
+		void ReleaseImage(Batch& batch, VkImageMemoryBarrier barrier);
+		void SubmitPendingAcquires();
+
+		struct AcquireSubmission
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+		};
+
+		AppDevice& _device;
+		VkQueue _queue;
+		uint32_t _queueFamilyIndex;
+		VkQueue _ownerQueue;
+		uint32_t _ownerQueueFamilyIndex;
+		VkCommandPool _commandPool = VK_NULL_HANDLE;
+		// only created when ownership has to be transferred
+		VkCommandPool _ownerCommandPool = VK_NULL_HANDLE;
+
+		VkBuffer _ringBuffer = VK_NULL_HANDLE;
+		MemoryAllocation _ringMemory;
+		VkDeviceSize _ringSize;
+		// bytes are written at head and reclaimed from tail, head == tail with _ringUsed == 0 means empty
+		VkDeviceSize _ringHead = 0;
+		VkDeviceSize _ringTail = 0;
+		VkDeviceSize _ringUsed = 0;
+
+		std::vector<Batch> _freeBatches;
+		std::deque<Batch> _inFlight;
+		Batch _openBatch;
+		bool _hasOpenBatch = false;
+
+		// written on this queue, possibly in batches already submitted, and not released yet
+		std::vector<VkBuffer> _unreleasedBuffers;
+		// released to the owner, separate from _mutex so ForgetBuffer works while the queue destroys its staging
+		std::mutex _releasedMutex;
+		std::unordered_set<VkBuffer> _releasedBuffers;
+
+		std::vector<VkBufferMemoryBarrier> _pendingBufferAcquires;
+		std::vector<VkImageMemoryBarrier> _pendingImageAcquires;
+		std::deque<AcquireSubmission> _acquireSubmissions;
+
+		UploadToken _nextToken = 1;
+		std::atomic<UploadToken> _completedToken{0};
+
+		std::mutex _mutex;
+	};
+}
@@ -0,0 +1,270 @@
+#include "app_vertex_format.hpp"
+#include "app_pipline.hpp"
+#include "app_shader_reflection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace VulkanTest
+{
+	namespace
+	{
+		bool IsIntegerFormat(const VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_R32_SINT:
+			case VK_FORMAT_R32G32_SINT:
+			case VK_FORMAT_R32G32B32_SINT:
+			case VK_FORMAT_R32G32B32A32_SINT:
+			case VK_FORMAT_R32_UINT:
+			case VK_FORMAT_R32G32_UINT:
+			case VK_FORMAT_R32G32B32_UINT:
+			case VK_FORMAT_R32G32B32A32_UINT:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		float SignNotZero(const float value)
+		{
+			return value >= 0.0f ? 1.0f : -1.0f;
+		}
+	}
+
+	MeshFormat MeshFormat::Float32()
+	{
+		return {};
+	}
+
+	MeshFormat MeshFormat::Compact(const PositionEncoding position)
+	{
+		MeshFormat format;
+		format.position = position;
+		format.direction = DirectionEncoding::Oct16;
+		format.texCoord = TexCoordEncoding::Unorm16;
+		return format;
+	}
+
+	MeshFormat MeshFormat::FromName(const std::string& name)
+	{
+		if (name == "float")
+			return Float32();
+		if (name == "half")
+			return Compact(PositionEncoding::Float16);
+		if (name == "snorm")
+			return Compact(PositionEncoding::Snorm16);
+		throw std::runtime_error("unknown mesh format " + name + "!");
+	}
+
+	bool MeshFormat::Quantized() const
+	{
+		// the bitangent sign moves into the position's w with the octahedral tangent, so they go together
+		return direction == DirectionEncoding::Oct16;
+	}
+
+	VkFormat MeshFormat::Format(const MeshAttribute attribute) const
+	{
+		switch (attribute)
+		{
+		case ATTRIBUTE_POSITION:
+			// three component 16 bit formats are rarely supported for vertex input, w is used anyway
+			if (position == PositionEncoding::Float16)
+				return VK_FORMAT_R16G16B16A16_SFLOAT;
+			if (position == PositionEncoding::Snorm16)
+				return VK_FORMAT_R16G16B16A16_SNORM;
+			return VK_FORMAT_R32G32B32_SFLOAT;
+		case ATTRIBUTE_NORMAL:
+			return direction == DirectionEncoding::Oct16 ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+		case ATTRIBUTE_TANGENT:
+			return direction == DirectionEncoding::Oct16 ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+		case ATTRIBUTE_TEXCOORD:
+			return texCoord == TexCoordEncoding::Unorm16 ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R32G32_SFLOAT;
+		default:
+			throw std::runtime_error("unknown mesh attribute!");
+		}
+	}
+
+	uint32_t MeshFormat::Size(const MeshAttribute attribute) const
+	{
+		switch (Format(attribute))
+		{
+		case VK_FORMAT_R16G16_SNORM:
+		case VK_FORMAT_R16G16_UNORM:
+			return 4;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+		case VK_FORMAT_R16G16B16A16_SNORM:
+		case VK_FORMAT_R32G32_SFLOAT:
+			return 8;
+		case VK_FORMAT_R32G32B32_SFLOAT:
+			return 12;
+		default:
+			return 16;
+		}
+	}
+
+	uint32_t MeshFormat::VertexSize() const
+	{
+		uint32_t size = 0;
+		for (uint32_t attribute = 0; attribute < ATTRIBUTE_COUNT; attribute++)
+			size += Size(static_cast<MeshAttribute>(attribute));
+		return size;
+	}
+
+	const char* MeshFormat::Name() const
+	{
+		if (!Quantized())
+			return "float";
+		return position == PositionEncoding::Float16 ? "half" : "snorm";
+	}
+
+	VertexLayout VertexLayout::Create(const MeshFormat& format)
+	{
+		VertexLayout layout;
+		uint32_t offset = 0;
+		for (uint32_t location = 0; location < ATTRIBUTE_COUNT; location++)
+		{
+			const auto attribute = static_cast<MeshAttribute>(location);
+			const uint32_t binding = format.splitStreams ? location : 0;
+			if (format.splitStreams)
+				offset = 0;
+
+			layout.attributes.push_back({location, binding, format.Format(attribute), offset});
+			offset += format.Size(attribute);
+			if (format.splitStreams)
+				layout.bindings.push_back({binding, offset, VK_VERTEX_INPUT_RATE_VERTEX});
+		}
+		if (!format.splitStreams)
+			layout.bindings.push_back({0, offset, VK_VERTEX_INPUT_RATE_VERTEX});
+		return layout;
+	}
+
+	void VertexLayout::Validate(const PipelineInterface& shaderInterface) const
+	{
+		// unread attributes are fine, the shader reading one that is not there is not. the component counts
+		// may differ, missing components read as 0, 0, 0, 1
+		for (const auto& input : shaderInterface.vertexAttributes)
+		{
+			const auto provided = std::find_if(attributes.begin(), attributes.end(),
+				[&](const VkVertexInputAttributeDescription& attribute) { return attribute.location == input.location; });
+			if (provided == attributes.end())
+				throw std::runtime_error("vertex shader reads location " + std::to_string(input.location) +
+				                         " which the mesh does not provide!");
+			if (IsIntegerFormat(input.format))
+				throw std::runtime_error("vertex shader reads location " + std::to_string(input.location) +
+				                         " as integers, mesh attributes are normalized or float!");
+		}
+	}
+
+	void VertexLayout::Apply(PipelineConfigInfo& configInfo) const
+	{
+		configInfo.vertexBindings = bindings;
+		configInfo.vertexAttributes = attributes;
+	}
+
+	uint16_t FloatToHalf(const float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+		const uint32_t exponent = (bits >> 23) & 0xffu;
+		uint32_t mantissa = bits & 0x7fffffu;
+
+		// infinity stays infinity, nan stays a quiet nan
+		if (exponent == 0xffu)
+			return static_cast<uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+
+		const int halfExponent = static_cast<int>(exponent) - 127 + 15;
+		if (halfExponent >= 31)
+			return static_cast<uint16_t>(sign | 0x7c00u);
+
+		if (halfExponent <= 0)
+		{
+			// subnormal, or zero once shifted past the last mantissa bit
+			if (halfExponent < -10)
+				return sign;
+			mantissa |= 0x800000u;
+			const auto shift = static_cast<uint32_t>(14 - halfExponent);
+			uint32_t half = mantissa >> shift;
+			const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+			const uint32_t halfway = 1u << (shift - 1u);
+			if (remainder > halfway || (remainder == halfway && (half & 1u) != 0))
+				half++;
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		// a carry out of the mantissa moves into the exponent, which is the correct rounding
+		uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+		const uint32_t remainder = mantissa & 0x1fffu;
+		if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u) != 0))
+			half++;
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	float HalfToFloat(const uint16_t value)
+	{
+		const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+		const uint32_t exponent = (value >> 10) & 0x1fu;
+		const uint32_t mantissa = value & 0x3ffu;
+
+		uint32_t bits;
+		if (exponent == 0x1fu)
+			bits = sign | 0x7f800000u | (mantissa << 13);
+		else if (exponent != 0)
+			bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+		else
+		{
+			// zero or subnormal, exact in float either way
+			const float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+			return sign != 0 ? -magnitude : magnitude;
+		}
+
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+
+	int16_t FloatToSnorm16(const float value)
+	{
+		return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	uint16_t FloatToUnorm16(const float value)
+	{
+		return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	std::array<float, 2> OctEncode(const std::array<float, 3>& direction)
+	{
+		const float length = std::fabs(direction[0]) + std::fabs(direction[1]) + std::fabs(direction[2]);
+		if (length == 0.0f)
+			return {0.0f, 0.0f};
+
+		const float x = direction[0] / length;
+		const float y = direction[1] / length;
+		// the lower half folds over the diagonals
+		if (direction[2] < 0.0f)
+			return {(1.0f - std::fabs(y)) * SignNotZero(x), (1.0f - std::fabs(x)) * SignNotZero(y)};
+		return {x, y};
+	}
+
+	std::array<float, 3> OctDecode(const std::array<float, 2>& encoded)
+	{
+		std::array<float, 3> direction = {
+			encoded[0], encoded[1], 1.0f - std::fabs(encoded[0]) - std::fabs(encoded[1])
+		};
+		const float fold = std::max(-direction[2], 0.0f);
+		direction[0] += direction[0] >= 0.0f ? -fold : fold;
+		direction[1] += direction[1] >= 0.0f ? -fold : fold;
+
+		const float length = std::sqrt(
+			direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+		for (float& component : direction)
+			component /= length;
+		return direction;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace VulkanTest
+{
+	struct PipelineConfigInfo;
+	struct PipelineInterface;
+
+	// shader input locations of the mesh attributes, mesh.vert declares the same
+	enum MeshAttribute : uint32_t
+	{
+		ATTRIBUTE_POSITION,
+		ATTRIBUTE_NORMAL,
+		ATTRIBUTE_TANGENT,
+		ATTRIBUTE_TEXCOORD,
+		ATTRIBUTE_COUNT
+	};
+
+	enum class PositionEncoding
+	{
+		Float32,
+		// relative to the mesh's center, the bitangent sign in w
+		Float16,
+		// normalized to the mesh's bounds, the bitangent sign in w
+		Snorm16
+	};
+
+	// normals and tangents
+	enum class DirectionEncoding
+	{
+		Float32,
+		// octahedral, two snorm16
+		Oct16
+	};
+
+	enum class TexCoordEncoding
+	{
+		Float32,
+		// normalized to the mesh's uv bounds
+		Unorm16
+	};
+
+	// How a mesh stores its vertices. The compact encodings are all decoded by the vertex input or with a
+	// per mesh scale and offset, so the vertex shader only needs to know whether any of them is used.
+	struct MeshFormat
+	{
+		PositionEncoding position = PositionEncoding::Float32;
+		DirectionEncoding direction = DirectionEncoding::Float32;
+		TexCoordEncoding texCoord = TexCoordEncoding::Float32;
+		// one binding per attribute instead of one interleaved binding, e.g. so a depth only pass can bind
+		// the positions alone
+		bool splitStreams = false;
+
+		// 48 bytes per vertex
+		static MeshFormat Float32();
+		// 20 bytes per vertex, snorm16 or half positions
+		static MeshFormat Compact(PositionEncoding position = PositionEncoding::Snorm16);
+		// "float", "half" or "snorm", throws for anything else
+		static MeshFormat FromName(const std::string& name);
+
+		// the vertex shader decodes octahedral directions and takes the bitangent sign from the position
+		[[nodiscard]] bool Quantized() const;
+		[[nodiscard]] VkFormat Format(MeshAttribute attribute) const;
+		[[nodiscard]] uint32_t Size(MeshAttribute attribute) const;
+		[[nodiscard]] uint32_t VertexSize() const;
+		[[nodiscard]] const char* Name() const;
+	};
+
+	// The vertex input state a mesh format needs, generated from the format instead of taken from
+	// reflection, which only knows the 32 bit types the shader declares.
+	struct VertexLayout
+	{
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+
+		static VertexLayout Create(const MeshFormat& format);
+
+		// throws if the vertex shader reads a location the layout does not provide, or as integers
+		void Validate(const PipelineInterface& shaderInterface) const;
+		// replaces the vertex input of the config
+		void Apply(PipelineConfigInfo& configInfo) const;
+
+		[[nodiscard]] const VkVertexInputAttributeDescription& Attribute(MeshAttribute attribute) const
+		{
+			return attributes[attribute];
+		}
+		[[nodiscard]] uint32_t Stride(MeshAttribute attribute) const
+		{
+			return bindings[attributes[attribute].binding].stride;
+		}
+	};
+
+	// round to nearest even, overflow goes to infinity
+	uint16_t FloatToHalf(float value);
+	float HalfToFloat(uint16_t value);
+	// clamped to [-1, 1] and [0, 1], rounded to nearest
+	int16_t FloatToSnorm16(float value);
+	uint16_t FloatToUnorm16(float value);
+	// a unit vector onto the octahedron, both components in [-1, 1]
+	std::array<float, 2> OctEncode(const std::array<float, 3>& direction);
+	std::array<float, 3> OctDecode(const std::array<float, 2>& encoded);
+}
@@ -1,119 +1,709 @@
 #include "first_app.hpp"
+#include "app_environment.hpp"
+#include "app_offscreen_target.hpp"
+#include "app_startup_profiler.hpp"
+#include "app_swap_chain.hpp"
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
 #include <stdexcept>
-#include "Init.hpp"
+#include <utility>
 
 namespace VulkanTest
 {
-	FirstApp::FirstApp()
+	namespace
 	{
-		CreatePipelineLayout();
-		CreatePipeline();
-		CreateCommandBuffers();
+		// the shader places the triangle itself, the objects only differ in their bounds. the grid spans
+		// twice the view in x and y, so about a quarter of it survives frustum culling
+		std::vector<GpuObject> ObjectGrid(const uint32_t count)
+		{
+			const auto side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+			std::vector<GpuObject> objects(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				GpuObject& object = objects[i];
+				object.center = {
+					-2.0f + 4.0f * (static_cast<float>(i % side) + 0.5f) / static_cast<float>(side),
+					-2.0f + 4.0f * (static_cast<float>(i / side) + 0.5f) / static_cast<float>(side),
+					0.5f
+				};
+				object.radius = 0.5f / static_cast<float>(side);
+				object.indexCount = 3;
+			}
+			return objects;
+		}
+	}
+
+	AppOptions AppOptions::FromCommandLine(const int argc, char** argv)
+	{
+		AppOptions options;
+
+		if (const std::string headless = ReadEnvironment("VULKANTEST_HEADLESS"); !headless.empty())
+			options.headless = headless != "0";
+
+		for (int i = 1; i < argc; i++)
+		{
+			if (std::strcmp(argv[i], "--headless") == 0)
+				options.headless = true;
+			else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+				options.frameCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+				options.outputPath = argv[++i];
+			else if (std::strcmp(argv[i], "--placeholder-pipeline") == 0)
+				options.placeholderPipeline = true;
+			else if (std::strcmp(argv[i], "--draws") == 0 && i + 1 < argc)
+				options.drawCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--static-draws") == 0 && i + 1 < argc)
+				options.staticDrawCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--gpu-cull") == 0 && i + 1 < argc)
+				options.gpuCullObjects = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--occlusion") == 0 && i + 1 < argc)
+				options.occlusionObjects = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--cpu-cull") == 0 && i + 1 < argc)
+				options.cpuCullObjects = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--cull-benchmark") == 0 && i + 1 < argc)
+				options.cullBenchmarkObjects = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--soft-occlusion") == 0 && i + 1 < argc)
+				options.softOcclusionObjects = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			else if (std::strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+				options.meshFormat = argv[++i];
+			else if (std::strcmp(argv[i], "--split-streams") == 0)
+				options.splitStreams = true;
+		}
+
+		return options;
 	}
 
-	FirstApp::~FirstApp() { vkDestroyPipelineLayout(_appDevice.Device(), _pipelineLayout, nullptr); }
+	FirstApp::FirstApp(AppOptions options) : _options{std::move(options)}
+	{
+		_jobPool = std::make_unique<AppJobPool>();
+
+		// the pipeline needs the render pass, so only the file reads can run alongside instance,
+		// device and swap chain creation
+		auto shaderCode = _jobPool->Submit([]
+		{
+			AppStartupProfiler::Scope scope("shader_load");
+			return std::make_pair(AppPipeline::ReadFile(VERT_SHADER_PATH), AppPipeline::ReadFile(FRAG_SHADER_PATH));
+		});
+
+		if (_options.headless)
+		{
+			{
+				AppStartupProfiler::Scope scope("device");
+				_appDevice = std::make_unique<AppDevice>();
+			}
+			AppStartupProfiler::Scope scope("render_target");
+			_renderTarget = std::make_unique<AppOffscreenTarget>(
+				*_appDevice, VkExtent2D{static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT)});
+		}
+		else
+		{
+			{
+				AppStartupProfiler::Scope scope("window");
+				_windowMain = std::make_unique<MainWindow>(WIDTH, HEIGHT, "Hello world");
+			}
+			{
+				AppStartupProfiler::Scope scope("device");
+				_appDevice = std::make_unique<AppDevice>(*_windowMain);
+			}
+			AppStartupProfiler::Scope scope("render_target");
+			_renderTarget = std::make_unique<AppSwapChain>(*_appDevice, _windowMain->GetExtent());
+		}
+
+		_pipelineCompiler = std::make_unique<AppPipelineCompiler>(*_appDevice, *_jobPool);
+		_pipelineRegistry = std::make_unique<AppPipelineRegistry>(*_pipelineCompiler);
+		_pipelineLibrary = std::make_unique<AppPipelineLibrary>(*_appDevice, *_jobPool, *_pipelineRegistry);
+		_layoutCache = std::make_unique<AppPipelineLayoutCache>(*_appDevice);
+
+		{
+			auto [vertCode, fragCode] = shaderCode.get();
+			{
+				AppStartupProfiler::Scope scope("pipeline_layout");
+				CreatePipelineLayout(vertCode, fragCode);
+			}
+			AppStartupProfiler::Scope scope("pipeline");
+			CreateShaderPermutations(std::move(vertCode), std::move(fragCode));
+			CreatePipeline();
+		}
+		AppStartupProfiler::Scope scope("command_buffers");
+		_frameRecorder = std::make_unique<AppFrameRecorder>(*_appDevice, *_jobPool, AppRenderTarget::MAX_FRAMES_IN_FLIGHT);
+		_renderQueue = std::make_unique<AppRenderQueue>();
+		_commandCache = std::make_unique<AppCommandCache>(
+			*_appDevice, *_jobPool, AppRenderTarget::MAX_FRAMES_IN_FLIGHT, &_encoderStats);
+		CreateStaticBuckets();
+		if (_options.gpuCullObjects > 0)
+			CreateGpuCulling();
+		if (_options.occlusionObjects > 0)
+			CreateOcclusionCulling();
+		if (_options.cpuCullObjects > 0)
+			CreateCpuCulling();
+		if (_options.softOcclusionObjects > 0)
+			CreateSoftwareOcclusion();
+		if (!_options.meshFormat.empty())
+			CreateMesh();
+		if (_gpuCulling || _occlusionCulling)
+			CreateTriangleIndexBuffer();
+	}
+
+	FirstApp::~FirstApp()
+	{
+		// everything below hangs off the device, which has to outlive it
+		_pipelineCompiler->PrintStats(std::cout);
+		_pipelineRegistry->PrintStats(std::cout);
+		_pipelineLibrary->PrintStats(std::cout);
+		std::cout << "pipeline_placeholder_draws count=" << _placeholderDraws << std::endl;
+		_simpleShader->PrintStats(std::cout);
+		_layoutCache->PrintStats(std::cout);
+		_frameRecorder->PrintStats(std::cout);
+		_renderQueue->PrintStats(std::cout);
+		_commandCache->PrintStats(std::cout);
+		_encoderStats.PrintStats(std::cout);
+		if (_gpuCulling)
+		{
+			// the device is idle after Run, the last frame's count has landed
+			_gpuCulling->PrintStats(std::cout);
+			std::cout << "gpu_culling_readback visible=" << _gpuCulling->ReadVisibleCount(_lastFrame)
+				<< " expected=" << _expectedVisible << std::endl;
+			_gpuCulling.reset();
+		}
+		if (_occlusionCulling)
+		{
+			// every slot's last frame has landed, the one recorded last is collected last
+			for (uint32_t i = 1; i <= AppRenderTarget::MAX_FRAMES_IN_FLIGHT; i++)
+				_occlusionCulling->CollectStats((_lastFrame + i) % AppRenderTarget::MAX_FRAMES_IN_FLIGHT);
+			_occlusionCulling->PrintStats(std::cout);
+			std::cout << "occlusion_culling_readback frustum_culled="
+				<< _occlusionCulling->LastFrameStats().frustumCulled << " expected=" << _expectedFrustumCulled << std::endl;
+			_occlusionCulling.reset();
+		}
+		if (_cpuCulling)
+		{
+			_cpuCulling->PrintStats(std::cout);
+			std::cout << "cpu_culling_visible last=" << _cpuVisible.size() << " expected=" << _expectedCpuVisible
+				<< std::endl;
+		}
+		if (_softOcclusion)
+		{
+			_softOcclusion->PrintStats(std::cout);
+			std::cout << "software_occlusion_visible last=" << _softVisible.size() << " objects="
+				<< _softOcclusionBoxes.size() << std::endl;
+		}
+		if (_mesh)
+		{
+			_mesh->PrintStats(std::cout);
+			_meshShader->PrintStats(std::cout);
+			_meshPipeline.reset();
+			_meshShader.reset();
+			_mesh.reset();
+		}
+		if (_triangleIndexBuffer != VK_NULL_HANDLE)
+			_appDevice->DestroyBuffer(_triangleIndexBuffer, _triangleIndexMemory);
+		_commandCache.reset();
+		_frameRecorder.reset();
+		_pipelineCompiler.reset();
+		_pipelineHandle.reset();
+		_simpleShader.reset();
+		_pipelineLibrary.reset();
+		_pipelineRegistry.reset();
+		_layoutCache.reset();
+		_renderTarget.reset();
+		_appDevice.reset();
+	}
 
 	void FirstApp::Run()
 	{
-		while (!_windowMain.ShouldClose())
+		if (!_options.headless)
 		{
-			glfwPollEvents();
-			DrawFrame();
+			while (!_windowMain->ShouldClose())
+			{
+				glfwPollEvents();
+
+				uint32_t imageIndex;
+				if (DrawFrame(imageIndex))
+					AppStartupProfiler::Instance().FirstFrame(std::cout);
+			}
+
+			vkDeviceWaitIdle(_appDevice->Device());
+			return;
 		}
 
-		vkDeviceWaitIdle(_appDevice.Device());
+		const auto start = std::chrono::steady_clock::now();
+
+		uint32_t lastImage = 0;
+		for (uint32_t frame = 0; frame < _options.frameCount; frame++)
+		{
+			if (DrawFrame(lastImage))
+				AppStartupProfiler::Instance().FirstFrame(std::cout);
+		}
+
+		vkDeviceWaitIdle(_appDevice->Device());
+
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << "headless frames=" << _options.frameCount << " total_ms=" << elapsed.count()
+			<< " avg_ms=" << (_options.frameCount > 0 ? elapsed.count() / _options.frameCount : 0.0) << std::endl;
+
+		if (!_options.outputPath.empty() && _options.frameCount > 0)
+			static_cast<AppOffscreenTarget&>(*_renderTarget).WriteImage(lastImage, _options.outputPath);
 	}
 
-	void FirstApp::CreatePipelineLayout()
+	void FirstApp::AddComputePass(ComputePass pass)
 	{
-		initializers::CreatePipelineLayoutCreateInfo(nullptr, 0);
-		const auto layoutInfo = initializers::vulkanInfoStore.pipelineLayoutCreateInfo;
-		if (vkCreatePipelineLayout(_appDevice.Device(), &layoutInfo, nullptr, &_pipelineLayout) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create pipeline layout!");
+		if (!pass.record)
+			throw std::runtime_error("compute pass " + pass.name + " records nothing!");
+
+		_computePasses.push_back(std::move(pass));
+	}
+
+	void FirstApp::CreatePipelineLayout(const std::vector<char>& vertCode, const std::vector<char>& fragCode)
+	{
+		_shaderInterface = PipelineInterface::Merge({
+			ShaderReflection::Reflect(vertCode), ShaderReflection::Reflect(fragCode)
+		});
+		_pipelineLayout = _layoutCache->GetPipelineLayout(_shaderInterface);
+	}
+
+	void FirstApp::CreateShaderPermutations(std::vector<char> vertCode, std::vector<char> fragCode)
+	{
+		// matches the constant_id declarations in simple_shader.frag
+		std::vector<ShaderFeature> features = {
+			{"color_mode", 0, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 2},
+		};
+
+		_simpleShader = std::make_unique<AppShaderPermutations>(
+			"simple_shader", *_pipelineLibrary, std::move(vertCode), std::move(fragCode), std::move(features),
+			[this](PipelineConfigInfo& pipelineConfig)
+			{
+				AppPipeline::DefaultPipelineConfigInfo(pipelineConfig);
+				pipelineConfig.renderPass = _renderTarget->GetRenderPass();
+				pipelineConfig.pipelineLayout = _pipelineLayout;
+				_shaderInterface.ApplyVertexInput(pipelineConfig);
+			});
 	}
 
 	void FirstApp::CreatePipeline()
 	{
-		// auto pipelineConfig = AppPipeline::defaultPipelineConfigInfo(appSwapChain.width(), appSwapChain.height());
-		PipelineConfigInfo pipelineConfig{};
+		if (_options.placeholderPipeline)
+		{
+			// compiles like any other permutation, once per render pass. until it is ready the handles standing
+			// in with it skip their draws, nothing waits for it. the old one is dropped first, it was built for
+			// the previous render pass
+			PermutationValues flat = _simpleShader->Defaults();
+			_simpleShader->Set(flat, "color_mode", 2);
+			_pipelineLibrary->SetFallback(nullptr);
+			_pipelineLibrary->SetFallback(_simpleShader->Get(flat));
+		}
+
+		// never waits, frames draw with the linked pipeline or the placeholder, or skip the draw, until the
+		// compile finished. headless waits so the written image always shows the real pipeline
+		_pipelineHandle = _simpleShader->Get(_simpleShader->Defaults());
+		if (_options.headless)
+			_pipelineHandle->Wait();
+	}
+
+	void FirstApp::CreateStaticBuckets()
+	{
+		for (uint32_t first = 0; first < _options.staticDrawCount; first += STATIC_BUCKET_DRAWS)
+		{
+			const uint32_t count = std::min(STATIC_BUCKET_DRAWS, _options.staticDrawCount - first);
+			_staticBuckets.push_back(_commandCache->AddBucket(
+				"static_" + std::to_string(_staticBuckets.size()), count,
+				[count](AppCommandEncoder& encoder, const AppPipeline&)
+				{
+					for (uint32_t draw = 0; draw < count; draw++)
+						encoder.Draw(3, 1, 0, 0);
+				}));
+		}
+	}
+
+	void FirstApp::CreateGpuCulling()
+	{
+		_gpuCulling = std::make_unique<AppGpuCulling>(
+			*_appDevice, *_layoutCache, _options.gpuCullObjects, AppRenderTarget::MAX_FRAMES_IN_FLIGHT);
+
+		const Frustum frustum = Frustum::FromBox({-1.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 1.0f});
+		const std::vector<GpuObject> objects = ObjectGrid(_options.gpuCullObjects);
+		_expectedVisible = static_cast<uint32_t>(std::count_if(objects.begin(), objects.end(),
+			[&](const GpuObject& object) { return frustum.IntersectsSphere(object.center, object.radius); }));
+		_gpuCulling->SetFrustum(frustum);
+		_gpuCulling->SetObjects(objects);
+		AddComputePass(_gpuCulling->CreateComputePass());
+	}
+
+	void FirstApp::CreateOcclusionCulling()
+	{
+		_occlusionCulling = std::make_unique<AppOcclusionCulling>(
+			*_appDevice, *_layoutCache, _options.occlusionObjects, AppRenderTarget::MAX_FRAMES_IN_FLIGHT);
+
+		// identity view projection, the grid is already in clip space. the dynamic draws' triangle at depth 0
+		// hides whatever of the grid lies fully behind it
+		const Frustum frustum = Frustum::FromBox({-1.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 1.0f});
+		const std::vector<GpuObject> objects = ObjectGrid(_options.occlusionObjects);
+		_expectedFrustumCulled = static_cast<uint32_t>(std::count_if(objects.begin(), objects.end(),
+			[&](const GpuObject& object) { return !frustum.IntersectsSphere(object.center, object.radius); }));
+		_occlusionCulling->SetObjects(objects);
+	}
+
+	void FirstApp::CreateCpuCulling()
+	{
+		_cpuCulling = std::make_unique<AppCpuCulling>(*_jobPool);
 
-		AppPipeline::DefaultPipelineConfigInfo(
-			pipelineConfig,
-			_appSwapChain.Width(),
-			_appSwapChain.Height());
+		// clip space like the gpu grid, Frustum::IntersectsSphere is the reference the kernels must match
+		_cpuCullFrustum = Frustum::FromBox({-1.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 1.0f});
+		for (const GpuObject& object : ObjectGrid(_options.cpuCullObjects))
+		{
+			_cpuCulling->AddSphere(object.center, object.radius);
+			if (_cpuCullFrustum.IntersectsSphere(object.center, object.radius))
+				_expectedCpuVisible++;
+		}
+	}
 
-		pipelineConfig.renderPass = _appSwapChain.GetRenderPass();
-		pipelineConfig.pipelineLayout = _pipelineLayout;
+	void FirstApp::CreateSoftwareOcclusion()
+	{
+		// a quarter of the framebuffer in each direction is plenty to find what a large occluder hides
+		_softOcclusion = std::make_unique<AppSoftwareOcclusion>(
+			*_jobPool, _renderTarget->Width() / 4, _renderTarget->Height() / 4);
 
-		_appPipeline = std::make_unique<AppPipeline>(_appDevice,
-		                                            "Shaders/simple_shader.vert.spv",
-		                                            "Shaders/simple_shader.frag.spv",
-		                                            pipelineConfig);
+		// identity view projection like the gpu grids. the occluder is what simple_shader.vert draws, and only
+		// when it is drawn
+		if (_options.drawCount > 0)
+			_softOcclusion->AddOccluder({{0.0f, -0.5f, 0.0f}, {0.5f, 0.5f, 0.0f}, {-0.5f, -0.5f, 0.0f}}, {0, 1, 2});
+		for (const GpuObject& object : ObjectGrid(_options.softOcclusionObjects))
+		{
+			OccludeeBox box;
+			for (size_t i = 0; i < 3; i++)
+			{
+				box.min[i] = object.center[i] - object.radius;
+				box.max[i] = object.center[i] + object.radius;
+			}
+			_softOcclusionBoxes.push_back(box);
+		}
 	}
 
-	void FirstApp::CreateCommandBuffers()
+	void FirstApp::CreateMesh()
 	{
-		_commandBuffers.resize(_appSwapChain.ImageCount());
+		MeshFormat format = MeshFormat::FromName(_options.meshFormat);
+		format.splitStreams = _options.splitStreams;
+		_mesh = std::make_unique<AppMesh>(*_appDevice, MeshData::Torus(96, 48, 0.5f, 0.2f), format);
+
+		std::vector<char> vertCode = AppPipeline::ReadFile(MESH_VERT_SHADER_PATH);
+		std::vector<char> fragCode = AppPipeline::ReadFile(MESH_FRAG_SHADER_PATH);
+		const PipelineInterface meshInterface = PipelineInterface::Merge({
+			ShaderReflection::Reflect(vertCode), ShaderReflection::Reflect(fragCode)
+		});
+		_mesh->Layout().Validate(meshInterface);
+		_meshPipelineLayout = _layoutCache->GetPipelineLayout(meshInterface);
 
-		VkCommandBufferAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = _appDevice.GetCommandPool();
-		allocInfo.commandBufferCount = static_cast<uint32_t>(_commandBuffers.size());
+		// matches the constant_id declarations in mesh.vert
+		std::vector<ShaderFeature> features = {
+			{"quantized", 0, VK_SHADER_STAGE_VERTEX_BIT, 0, 1},
+		};
 
-		if (vkAllocateCommandBuffers(_appDevice.Device(), &allocInfo, _commandBuffers.data()) !=
-			VK_SUCCESS)
-			throw std::runtime_error("failed to allocate command buffers!");
+		_meshShader = std::make_unique<AppShaderPermutations>(
+			"mesh", *_pipelineLibrary, std::move(vertCode), std::move(fragCode), std::move(features),
+			[this](PipelineConfigInfo& pipelineConfig)
+			{
+				AppPipeline::DefaultPipelineConfigInfo(pipelineConfig);
+				pipelineConfig.renderPass = _renderTarget->GetRenderPass();
+				pipelineConfig.pipelineLayout = _meshPipelineLayout;
+				// the mesh's formats, reflection only sees the 32 bit types the shader declares
+				_mesh->Layout().Apply(pipelineConfig);
+			});
 
-		for (size_t i = 0; i < _commandBuffers.size(); i++)
+		// tilted toward the viewer and pushed into [0, 1] depth, the torus is already about clip space sized
+		constexpr float tilt = 1.0f;
+		const float c = std::cos(tilt);
+		const float s = std::sin(tilt);
+		_meshConstants.transform = {
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, c, 0.5f * s, 0.0f,
+			0.0f, -s, 0.5f * c, 0.0f,
+			0.0f, 0.0f, 0.5f, 1.0f
+		};
+		_mesh->FillConstants(_meshConstants);
+		CreateMeshPipeline();
+	}
+
+	void FirstApp::CreateMeshPipeline()
+	{
+		PermutationValues values = _meshShader->Defaults();
+		_meshShader->Set(values, "quantized", _mesh->Format().Quantized() ? 1 : 0);
+		_meshPipeline = _meshShader->Get(values);
+		if (_options.headless)
+			_meshPipeline->Wait();
+	}
+
+	void FirstApp::CreateTriangleIndexBuffer()
+	{
+		constexpr std::array<uint16_t, 4> indices = {0, 1, 2, 0};
+		_appDevice->CreateBuffer(sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                         MemoryUsage::GpuOnly, _triangleIndexBuffer, _triangleIndexMemory);
+		_appDevice->UploadQueue().Wait(
+			_appDevice->UploadQueue().UploadBuffer(_triangleIndexBuffer, 0, indices.data(), sizeof(indices)));
+	}
+
+	VkCommandBuffer FirstApp::RecordCommandBuffer(const uint32_t frame, const uint32_t imageIndex)
+	{
+		// decided before anything is recorded, the occluded objects never become draws
+		if (_softOcclusion)
 		{
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			_softOcclusion->RenderOccluders();
+			_softOcclusion->CullBoxes(_softOcclusionBoxes, _softVisible);
+		}
+
+		// the frame slot's fence was waited on in AcquireNextImage, so its pools are free to reset
+		const VkCommandBuffer commandBuffer = _frameRecorder->BeginFrame(frame);
+
+		RecordComputePasses(commandBuffer, _computePasses, ComputeStage::BeforeRenderPass);
+		if (_occlusionCulling)
+		{
+			_occlusionCulling->CollectStats(frame);
+			_occlusionCulling->RecordEarlyCull(commandBuffer, frame, _renderTarget->GetExtent());
+		}
 
-			if (vkBeginCommandBuffer(_commandBuffers[i], &beginInfo) != VK_SUCCESS)
-				throw std::runtime_error("failed to begin recording command buffer!");
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = _renderTarget->GetRenderPass();
+		renderPassInfo.framebuffer = _renderTarget->GetFrameBuffer(imageIndex);
 
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = _appSwapChain.GetRenderPass();
-			renderPassInfo.framebuffer = _appSwapChain.GetFrameBuffer(i);
+		renderPassInfo.renderArea.offset = {0, 0};
+		renderPassInfo.renderArea.extent = _renderTarget->GetExtent();
 
-			renderPassInfo.renderArea.offset = {0, 0};
-			renderPassInfo.renderArea.extent = _appSwapChain.GetSwapChainExtent();
+		std::array<VkClearValue, 2> clearValues{};
 
-			std::array<VkClearValue, 2> clearValues{};
+		// todo background color:
+		clearValues[0].color = {0.2f, 0.2f, 0.2f, 1.0f}; // assigned color attachement
+		clearValues[1].depthStencil = {1.0f, 0}; // assigned depth attachement
 
-			// todo background color:
-			clearValues[0].color = {0.2f, 0.2f, 0.2f, 1.0f}; // assigned color attachement
-			clearValues[1].depthStencil = {1.0f, 0}; // assigned depth attachement
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassInfo.pClearValues = clearValues.data();
 
-			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-			renderPassInfo.pClearValues = clearValues.data();
 
+		// draws are recorded into secondaries on the job pool
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-			// For using secondary, pass below to vkCmdBeginRenderPass as third argument:
-			//VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
-			vkCmdBeginRenderPass(_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-			_appPipeline->Bind(_commandBuffers[i]);
+		// dynamic state, follows the target size without touching the pipeline
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(_renderTarget->Width());
+		viewport.height = static_cast<float>(_renderTarget->Height());
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		const VkRect2D scissor{{0, 0}, _renderTarget->GetExtent()};
 
-			vkCmdDraw(_commandBuffers[i], 3, 1, 0, 0);
+		if (_pipelineHandle->IsPlaceholder())
+			_placeholderDraws += _options.drawCount + _options.staticDrawCount;
 
-			vkCmdEndRenderPass(_commandBuffers[i]);
-			if (vkEndCommandBuffer(_commandBuffers[i]) != VK_SUCCESS)
-				throw std::runtime_error("Failed to record buffer");
+		// resolved once here, workers only read it
+		const std::shared_ptr<AppPipeline> pipeline = _pipelineHandle->Get();
+
+		// a recreated swap chain or a promoted pipeline re-records the buckets, otherwise they are replayed
+		_commandCache->SetTarget(renderPassInfo.renderPass, 0, renderPassInfo.renderArea.extent);
+		for (const auto bucket : _staticBuckets)
+			_commandCache->SetPipeline(bucket, pipeline);
+		_commandCache->Execute(commandBuffer, frame);
+
+		if (pipeline)
+		{
+			DrawPacket packet{};
+			packet.sortKey = SortKey::Opaque(0, _renderQueue->PipelineId(pipeline.get()), 0, 0, 0.0f);
+			packet.pipeline = pipeline.get();
+			packet.count = 3;
+			for (uint32_t draw = 0; draw < _options.drawCount; draw++)
+				_renderQueue->Push(packet);
+		}
+		if (_cpuCulling)
+		{
+			// one draw per visible object, sorted and split across the recording threads with the rest
+			_cpuCulling->Cull(_cpuCullFrustum, AppCpuCulling::Volume::Sphere, _cpuVisible);
+			if (_pipelineHandle->IsPlaceholder())
+				_placeholderDraws += _cpuVisible.size();
+			if (pipeline)
+			{
+				DrawPacket packet{};
+				packet.sortKey = SortKey::Opaque(0, _renderQueue->PipelineId(pipeline.get()), 0, 0, 0.0f);
+				packet.pipeline = pipeline.get();
+				packet.count = 3;
+				for (size_t i = 0; i < _cpuVisible.size(); i++)
+					_renderQueue->Push(packet);
+			}
+		}
+		// skipped until the mesh pipeline is linked, the placeholder has no vertex input
+		if (_meshPipeline && !_meshPipeline->IsPlaceholder())
+		{
+			const std::shared_ptr<AppPipeline> meshPipeline = _meshPipeline->Get();
+			const MeshBinding& mesh = _mesh->Binding();
+			DrawPacket packet{};
+			packet.sortKey = SortKey::Opaque(0, _renderQueue->PipelineId(meshPipeline.get()), 0,
+			                                 _renderQueue->MeshId(&mesh), 0.0f);
+			packet.pipeline = meshPipeline.get();
+			packet.layout = _meshPipelineLayout;
+			packet.mesh = &mesh;
+			packet.count = _mesh->IndexCount();
+			packet.pushConstants = &_meshConstants;
+			packet.pushConstantSize = sizeof(_meshConstants);
+			packet.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+			_renderQueue->Push(packet);
+		}
+		if (_softOcclusion)
+		{
+			if (_pipelineHandle->IsPlaceholder())
+				_placeholderDraws += _softVisible.size();
+			if (pipeline)
+			{
+				DrawPacket packet{};
+				packet.sortKey = SortKey::Opaque(0, _renderQueue->PipelineId(pipeline.get()), 0, 0, 0.0f);
+				packet.pipeline = pipeline.get();
+				packet.count = 3;
+				for (size_t i = 0; i < _softVisible.size(); i++)
+					_renderQueue->Push(packet);
+			}
+		}
+		_renderQueue->Sort();
+
+		_frameRecorder->RecordDraws(
+			renderPassInfo.renderPass, 0, renderPassInfo.framebuffer, _renderQueue->Size(),
+			[&](const VkCommandBuffer secondary, const size_t begin, const size_t end)
+			{
+				// secondaries inherit no dynamic state
+				AppCommandEncoder encoder(secondary, &_encoderStats);
+				encoder.SetViewport(viewport);
+				encoder.SetScissor(scissor);
+				_renderQueue->Record(encoder, begin, end);
+			});
+		_renderQueue->Clear();
+
+		// a handful of commands however many objects there are, the counts come from the cull passes
+		const auto recordIndirect = [&](const VkRenderPass renderPass,
+		                                const std::function<void(AppCommandEncoder&)>& draws)
+		{
+			_frameRecorder->RecordSecondary(
+				renderPass, 0, renderPassInfo.framebuffer,
+				[&](const VkCommandBuffer secondary)
+				{
+					AppCommandEncoder encoder(secondary, &_encoderStats);
+					encoder.SetViewport(viewport);
+					encoder.SetScissor(scissor);
+					encoder.BindPipeline(*pipeline);
+					encoder.BindIndexBuffer(_triangleIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+					draws(encoder);
+				});
+		};
+
+		if (_gpuCulling && pipeline)
+		{
+			recordIndirect(renderPassInfo.renderPass,
+			               [&](AppCommandEncoder& encoder) { _gpuCulling->RecordDraws(encoder); });
+		}
+		if (_occlusionCulling && pipeline)
+		{
+			recordIndirect(renderPassInfo.renderPass,
+			               [&](AppCommandEncoder& encoder) { _occlusionCulling->RecordEarlyDraws(encoder); });
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		if (_occlusionCulling)
+		{
+			// the first pass stored its depth, what it hides is culled and the rest drawn on top of it
+			_occlusionCulling->RecordLateCull(commandBuffer, frame, *_renderTarget, imageIndex);
+
+			VkRenderPassBeginInfo loadPassInfo = renderPassInfo;
+			loadPassInfo.renderPass = _renderTarget->GetLoadRenderPass();
+			loadPassInfo.clearValueCount = 0;
+			loadPassInfo.pClearValues = nullptr;
+			vkCmdBeginRenderPass(commandBuffer, &loadPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			if (pipeline)
+			{
+				recordIndirect(loadPassInfo.renderPass,
+				               [&](AppCommandEncoder& encoder) { _occlusionCulling->RecordLateDraws(encoder); });
+			}
+			vkCmdEndRenderPass(commandBuffer);
+		}
+
+		RecordComputePasses(commandBuffer, _computePasses, ComputeStage::AfterRenderPass);
+
+		if (_gpuCulling)
+			_gpuCulling->RecordReadback(commandBuffer, frame);
+		if (_occlusionCulling)
+			_occlusionCulling->RecordReadback(commandBuffer, frame);
+		_lastFrame = frame;
+
+		_encoderStats.EndFrame();
+		return _frameRecorder->EndFrame();
+	}
+
+	void FirstApp::RecreateRenderTarget()
+	{
+		if (!_windowMain)
+			return;
+
+		// minimized, there is nothing to present into until the window has a size again
+		VkExtent2D extent = _windowMain->GetExtent();
+		while ((extent.width == 0 || extent.height == 0) && !_windowMain->ShouldClose())
+		{
+			glfwWaitEvents();
+			extent = _windowMain->GetExtent();
+		}
+
+		if (extent.width == 0 || extent.height == 0)
+			return;
+
+		_windowMain->ResetWindowResizedFlag();
+
+		// frames in flight keep draining, the target retires its old resources behind them
+		if (_renderTarget->Recreate(extent))
+		{
+			// permutations were built against the old render pass
+			_simpleShader->Clear();
+			CreatePipeline();
+			if (_meshShader)
+			{
+				_meshShader->Clear();
+				CreateMeshPipeline();
+			}
 		}
 	}
 
-	void FirstApp::DrawFrame()
+	bool FirstApp::DrawFrame(uint32_t& imageIndex)
 	{
-		uint32_t imageIndex;
-		auto result = _appSwapChain.AcquireNextImage(&imageIndex);
+		// anything streamed in since the last frame goes out in one submission ahead of the frame
+		_appDevice->UploadQueue().Flush();
+		// the one budget query per frame, allocations in between extrapolate from it
+		_appDevice->MemoryBudget().Update();
+
+		auto result = _renderTarget->AcquireNextImage(&imageIndex);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			RecreateRenderTarget();
+			return false;
+		}
+
 		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
 			throw std::runtime_error("Failed to aquire swap chain image");
 
-		result = _appSwapChain.SubmitCommandBuffers(&_commandBuffers[imageIndex], &imageIndex);
+		// pipelines that finished compiling since the last frame are swapped in here, never mid-recording
+		_pipelineLibrary->BeginFrame();
+
+		const auto frame = static_cast<uint32_t>(_renderTarget->CurrentFrame());
+		const VkCommandBuffer commandBuffer = RecordCommandBuffer(frame, imageIndex);
+
+		result = _renderTarget->SubmitCommandBuffers(&commandBuffer, &imageIndex);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+			(_windowMain && _windowMain->WasWindowResized()))
+		{
+			RecreateRenderTarget();
+			return true;
+		}
+
 		if (result != VK_SUCCESS)
 			throw std::runtime_error("failed to present swap chain image");
+
+		return true;
 	}
 }
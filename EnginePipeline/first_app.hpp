@@ -1,20 +1,80 @@
 #pragma once
 #include "MainWindow.hpp"
 #include "app_pipline.hpp"
+#include "app_command_cache.hpp"
+#include "app_command_encoder.hpp"
+#include "app_compute_pipeline.hpp"
+#include "app_cpu_culling.hpp"
 #include "app_device.hpp"
-#include "app_swap_chain.hpp"
+#include "app_frame_recorder.hpp"
+#include "app_gpu_culling.hpp"
+#include "app_job_pool.hpp"
+#include "app_mesh.hpp"
+#include "app_occlusion_culling.hpp"
+#include "app_pipeline_compiler.hpp"
+#include "app_pipeline_layout_cache.hpp"
+#include "app_pipeline_library.hpp"
+#include "app_pipeline_registry.hpp"
+#include "app_render_queue.hpp"
+#include "app_render_target.hpp"
+#include "app_shader_permutations.hpp"
+#include "app_software_occlusion.hpp"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace VulkanTest
 {
+	struct AppOptions
+	{
+		// no window or swap chain, renders frameCount frames into offscreen images and exits
+		bool headless = false;
+		uint32_t frameCount = 300;
+		// headless only, the last frame is written here as a PPM when set
+		std::string outputPath;
+		// draws whose pipeline is still compiling use a flat placeholder pipeline instead of being skipped
+		bool placeholderPipeline = false;
+		// the triangle drawn this many times per frame, for measuring how recording scales
+		uint32_t drawCount = 1;
+		// drawn on top of drawCount from cached secondaries, recorded once instead of every frame
+		uint32_t staticDrawCount = 0;
+		// objects culled on the gpu and drawn indirectly, half of them off screen
+		uint32_t gpuCullObjects = 0;
+		// objects culled in two phases against last frame's visible set and a hi-z pyramid, laid out like
+		// gpuCullObjects behind the dynamic draws
+		uint32_t occlusionObjects = 0;
+		// objects frustum culled on the cpu every frame, the visible ones join the dynamic draws
+		uint32_t cpuCullObjects = 0;
+		// runs the cpu culling kernels against each other on this many objects instead of the app
+		uint32_t cullBenchmarkObjects = 0;
+		// objects occlusion culled on the cpu against the dynamic draws' triangle, the visible ones join the
+		// dynamic draws
+		uint32_t softOcclusionObjects = 0;
+		// a torus drawn with mesh.vert in this vertex format, "float", "half" or "snorm". none when empty
+		std::string meshFormat;
+		// the mesh's attributes in one vertex buffer binding each
+		bool splitStreams = false;
+
+		// --headless, --frames N, --output path, --placeholder-pipeline, --draws N, --static-draws N,
+		// --gpu-cull N, --occlusion N, --cpu-cull N, --cull-benchmark N, --soft-occlusion N,
+		// --mesh format, --split-streams;
+		// VULKANTEST_HEADLESS=1 also selects headless
+		static AppOptions FromCommandLine(int argc, char** argv);
+	};
+
 	class FirstApp
 	{
 	public:
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
-		FirstApp();
+		static constexpr const char* VERT_SHADER_PATH = "Shaders/simple_shader.vert.spv";
+		static constexpr const char* FRAG_SHADER_PATH = "Shaders/simple_shader.frag.spv";
+		static constexpr const char* MESH_VERT_SHADER_PATH = "Shaders/mesh.vert.spv";
+		static constexpr const char* MESH_FRAG_SHADER_PATH = "Shaders/mesh.frag.spv";
+		// static draws per cached secondary
+		static constexpr uint32_t STATIC_BUCKET_DRAWS = 256;
+		explicit FirstApp(AppOptions options = {});
 		~FirstApp();
 
 		FirstApp(const FirstApp&) = delete;
@@ -22,20 +82,101 @@ namespace VulkanTest
 
 		void Run();
 
+		// recorded every frame before or after the render pass, in the order added
+		void AddComputePass(ComputePass pass);
+		[[nodiscard]] AppDevice& Device() const { return *_appDevice; }
+		[[nodiscard]] AppPipelineLayoutCache& LayoutCache() const { return *_layoutCache; }
+
 	private:
-		void CreatePipelineLayout();
+		// reflects the shaders, the layout and the vertex input follow from what they declare
+		void CreatePipelineLayout(const std::vector<char>& vertCode, const std::vector<char>& fragCode);
+		void CreateShaderPermutations(std::vector<char> vertCode, std::vector<char> fragCode);
 		void CreatePipeline();
-		void CreateCommandBuffers();
-		void DrawFrame();
-		MainWindow _windowMain{WIDTH, HEIGHT, "Hello world"};
+		void CreateStaticBuckets();
+		// a grid of gpuCullObjects triangles around the view
+		void CreateGpuCulling();
+		// the same grid with occlusionObjects triangles, occluded by the dynamic draws
+		void CreateOcclusionCulling();
+		// the same grid with cpuCullObjects spheres, culled before the render queue is sorted
+		void CreateCpuCulling();
+		// the same grid with softOcclusionObjects boxes, rasterized against before recording starts
+		void CreateSoftwareOcclusion();
+		// uploads the torus and sets up mesh.vert's permutations with the mesh's vertex layout
+		void CreateMesh();
+		// the mesh pipeline for the mesh's format against the current render pass
+		void CreateMeshPipeline();
+		// the index buffer every indirect draw shares
+		void CreateTriangleIndexBuffer();
+		// returns the frame's primary, ready to submit
+		VkCommandBuffer RecordCommandBuffer(uint32_t frame, uint32_t imageIndex);
+		// swap chain out of date or window resized, waits while the window is minimized
+		void RecreateRenderTarget();
+		// imageIndex is the image the frame rendered into, false if nothing was submitted
+		bool DrawFrame(uint32_t& imageIndex);
+
+		AppOptions _options;
 
-		AppDevice _appDevice{_windowMain};
+		std::unique_ptr<AppJobPool> _jobPool;
 
-		AppSwapChain _appSwapChain{_appDevice, _windowMain.GetExtent()};
+		// null when headless
+		std::unique_ptr<MainWindow> _windowMain;
+		std::unique_ptr<AppDevice> _appDevice;
+		std::unique_ptr<AppRenderTarget> _renderTarget;
 
-		std::unique_ptr<AppPipeline> _appPipeline;
+		std::unique_ptr<AppPipelineCompiler> _pipelineCompiler;
+		std::unique_ptr<AppPipelineRegistry> _pipelineRegistry;
+		std::unique_ptr<AppPipelineLibrary> _pipelineLibrary;
+		// fast-linked at first, the optimized pipeline once it finished compiling
+		std::shared_ptr<PipelineHandle> _pipelineHandle;
+		// draws made without their real pipeline, skipped or with the placeholder
+		uint64_t _placeholderDraws = 0;
+		std::unique_ptr<AppPipelineLayoutCache> _layoutCache;
+		PipelineInterface _shaderInterface;
+		// owned by the layout cache
 		VkPipelineLayout _pipelineLayout{};
+		// simple_shader with its feature switches, rebuilt from here if the render pass is replaced
+		std::unique_ptr<AppShaderPermutations> _simpleShader;
+
+		std::vector<ComputePass> _computePasses;
+
+		// per frame in flight and recording thread command pools, re-recorded every frame against the acquired image
+		std::unique_ptr<AppFrameRecorder> _frameRecorder;
+		// every encoder of the frame reports here, closed once per recorded frame
+		CommandEncoderStats _encoderStats;
+		// the frame's dynamic draws, sorted by state before they are split across the recording threads
+		std::unique_ptr<AppRenderQueue> _renderQueue;
+		// static geometry, re-recorded only when a bucket's pipeline or the render target changes
+		std::unique_ptr<AppCommandCache> _commandCache;
+		std::vector<AppCommandCache::BucketId> _staticBuckets;
 
-		std::vector<VkCommandBuffer> _commandBuffers;
+		// null unless --gpu-cull
+		std::unique_ptr<AppGpuCulling> _gpuCulling;
+		// null unless --occlusion
+		std::unique_ptr<AppOcclusionCulling> _occlusionCulling;
+		// null unless --cpu-cull
+		std::unique_ptr<AppCpuCulling> _cpuCulling;
+		// the cpu culling's frustum and the frame's result, kept to reuse the allocation
+		Frustum _cpuCullFrustum{};
+		std::vector<uint32_t> _cpuVisible;
+		uint32_t _expectedCpuVisible = 0;
+		// null unless --mesh
+		std::unique_ptr<AppMesh> _mesh;
+		std::unique_ptr<AppShaderPermutations> _meshShader;
+		std::shared_ptr<PipelineHandle> _meshPipeline;
+		// owned by the layout cache
+		VkPipelineLayout _meshPipelineLayout{};
+		// pushed with every mesh draw, the packets point at it
+		MeshDrawConstants _meshConstants;
+		// null unless --soft-occlusion
+		std::unique_ptr<AppSoftwareOcclusion> _softOcclusion;
+		std::vector<OccludeeBox> _softOcclusionBoxes;
+		std::vector<uint32_t> _softVisible;
+		// objects of the occlusion grid outside the view, the gpu should report the same
+		uint32_t _expectedFrustumCulled = 0;
+		VkBuffer _triangleIndexBuffer = VK_NULL_HANDLE;
+		MemoryAllocation _triangleIndexMemory{};
+		// what the cpu expects the gpu to find visible, compared against the read back count
+		uint32_t _expectedVisible = 0;
+		uint32_t _lastFrame = 0;
 	};
 }
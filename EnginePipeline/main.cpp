@@ -1,14 +1,25 @@
 #include "../EnginePipeline/first_app.hpp"
+#include "../EnginePipeline/app_startup_profiler.hpp"
 
 #include <cstdlib>
 #include <iostream>
 
-int main() {
-	VulkanTest::FirstApp app{};
-	
+int main(int argc, char** argv) {
+	// pins the startup clock origin as close to process start as we can get
+	VulkanTest::AppStartupProfiler::Instance();
+
 	try {
+		const VulkanTest::AppOptions options = VulkanTest::AppOptions::FromCommandLine(argc, argv);
+		if (options.cullBenchmarkObjects > 0) {
+			// no window or device, only the job pool the kernels run on
+			VulkanTest::AppJobPool jobPool;
+			VulkanTest::AppCpuCulling::RunBenchmark(jobPool, options.cullBenchmarkObjects, std::cout);
+			return EXIT_SUCCESS;
+		}
+
+		VulkanTest::FirstApp app{options};
 		app.Run();
-		
+
 	}
 	catch (const std::exception &e) {
 		std::cerr << e.what() << '\n';
@@ -0,0 +1,16 @@
+#version 450
+
+layout(location = 0) in vec3 inNormal;
+layout(location = 1) in vec4 inTangent;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main(){
+	// a checker over the uvs, lit from the viewer, shows precision loss in either
+	vec3 normal = normalize(inNormal);
+	float checker = mod(floor(inTexCoord.x * 16.0) + floor(inTexCoord.y * 8.0), 2.0);
+	vec3 albedo = mix(vec3(0.9, 0.6, 0.2), vec3(0.3, 0.5, 0.9), checker);
+	float light = 0.2 + 0.8 * abs(normal.z);
+	outColor = vec4(albedo * light, 1.0);
+}
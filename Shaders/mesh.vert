@@ -0,0 +1,47 @@
+#version 450
+
+// feature switch, set per pipeline through a specialization constant
+// 1 = the compact encoding: octahedral normal and tangent, bitangent sign in the position's w
+layout(constant_id = 0) const int QUANTIZED = 0;
+
+// formats come from the mesh, normalized and half inputs arrive as floats already
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inNormal;
+layout(location = 2) in vec4 inTangent;
+layout(location = 3) in vec2 inTexCoord;
+
+// matches MeshDrawConstants
+layout(push_constant) uniform MeshConstants {
+	mat4 transform;
+	vec4 positionScale;
+	vec4 positionOffset;
+	// xy scale, zw offset
+	vec4 texCoordTransform;
+} mesh;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec4 outTangent;
+layout(location = 2) out vec2 outTexCoord;
+
+vec3 OctDecode(vec2 encoded) {
+	vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-direction.z, 0.0);
+	direction.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(direction.xy, vec2(0.0)));
+	return normalize(direction);
+}
+
+void main() {
+	vec3 position = mesh.positionOffset.xyz + mesh.positionScale.xyz * inPosition.xyz;
+
+	vec3 normal = inNormal.xyz;
+	vec4 tangent = inTangent;
+	if (QUANTIZED == 1) {
+		normal = OctDecode(inNormal.xy);
+		tangent = vec4(OctDecode(inTangent.xy), inPosition.w < 0.0 ? -1.0 : 1.0);
+	}
+
+	gl_Position = mesh.transform * vec4(position, 1.0);
+	outNormal = mat3(mesh.transform) * normal;
+	outTangent = vec4(mat3(mesh.transform) * tangent.xyz, tangent.w);
+	outTexCoord = inTexCoord * mesh.texCoordTransform.xy + mesh.texCoordTransform.zw;
+}
@@ -11,9 +11,19 @@ float colorData[] = {
 0.0, 1.0, 0.0, 
 0.0, 0.0, 1.0
 };
+
+// feature switches, set per pipeline through specialization constants
+// 0 = flat yellow, 1 = gradient across the screen, 2 = white
+layout(constant_id = 0) const int COLOR_MODE = 0;
+
 layout(location = 0) out  vec4 outColor;
 
 void main(){
-	outColor = vec4(1.0,1.0,0.0,1.0);
+	if (COLOR_MODE == 1)
+		outColor = vec4(fract(gl_FragCoord.x / 256.0), fract(gl_FragCoord.y / 256.0), 0.0, 1.0);
+	else if (COLOR_MODE == 2)
+		outColor = vec4(1.0, 1.0, 1.0, 1.0);
+	else
+		outColor = vec4(1.0,1.0,0.0,1.0);
 
-}
\ No newline at end of file
+}